@@ -48,6 +48,25 @@ bool ::AsstExtAPI::set_static_option(StaticOptionKey key, const std::string& val
         CharOcr::get_instance().use_gpu(device_id);
         return true;
     } break;
+    case StaticOptionKey::AsyncLog: {
+        if (value != "0" && value != "1") {
+            break;
+        }
+        Log.set_async(value == "1");
+        return true;
+    } break;
+    case StaticOptionKey::LogLevel: {
+        static const std::unordered_map<std::string, Logger::level> LevelMap = {
+            { "debug", Logger::level::debug }, { "trace", Logger::level::trace }, { "info", Logger::level::info },
+            { "warn", Logger::level::warn },   { "error", Logger::level::error },
+        };
+        auto iter = LevelMap.find(value);
+        if (iter == LevelMap.end()) {
+            break;
+        }
+        Log.set_min_level(iter->second);
+        return true;
+    } break;
     default:
         Log.error(__FUNCTION__, "| unknown key:", static_cast<int>(key));
         break;
@@ -72,9 +91,7 @@ Assistant::~Assistant()
 {
     LogTraceFunction;
 
-    // dirty stuff preventing Logger from being destructed before ResourceLoader::load_thread_func exits,
-    // which creates empty files with random name on Linux. I have no idea how this could work
-    ResourceLoader::get_instance().cancel();
+    // 不在这里取消资源加载：ResourceLoader 是所有实例共用的，正在加载的可能是别的实例发起的
 
     m_thread_exit = true;
     m_thread_idle = true;
@@ -420,8 +437,12 @@ void Assistant::working_proc()
         };
         append_callback(AsstMsg::TaskChainStart, callback_json);
 
+        auto start = std::chrono::steady_clock::now();
         bool ret = task_ptr->run();
         finished_tasks.emplace_back(id);
+        auto chain_cost =
+            std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        append_ocr_stats(callback_json, chain_cost);
 
         lock.lock();
         if (!m_tasks_list.empty()) {
@@ -589,6 +610,30 @@ void asst::Assistant::call_proc()
     }
 }
 
+void Assistant::append_ocr_stats(const json::value& taskchain_json, long long taskchain_cost_ms)
+{
+    // OCR 服务是所有实例共用的，这里汇报本实例在这个任务链里的排队和推理情况
+    auto stats = WordOcr::get_instance().take_stats(this);
+    stats += CharOcr::get_instance().take_stats(this);
+    if (stats.calls == 0) {
+        return;
+    }
+
+    const auto calls = static_cast<long long>(stats.calls);
+    json::value info = taskchain_json;
+    info["what"] = "OcrStats";
+    info["details"] = json::object {
+        { "calls", calls },
+        { "batched_calls", static_cast<long long>(stats.batched_calls) },
+        { "queue_avg_ms", stats.queue_us / calls / 1000.0 },
+        { "queue_max_ms", stats.max_queue_us / 1000.0 },
+        { "infer_avg_ms", stats.infer_us / calls / 1000.0 },
+        { "total_avg_ms", stats.total_us / calls / 1000.0 },
+        { "calls_per_sec", taskchain_cost_ms > 0 ? calls * 1000.0 / taskchain_cost_ms : 0.0 },
+    };
+    append_callback(AsstMsg::TaskChainExtraInfo, info);
+}
+
 void Assistant::append_callback(AsstMsg msg, const json::value& detail)
 {
     json::value more_detail = detail;
@@ -144,6 +144,7 @@ namespace asst
     private:
         void clear_cache();
         bool inited() const noexcept;
+        void append_ocr_stats(const json::value& taskchain_json, long long taskchain_cost_ms);
 
         bool ctrl_connect(const std::string& adb_path, const std::string& address, const std::string& config);
         bool ctrl_click(int x, int y);
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
+
 #include "AsstTypes.h"
 #include "Utils/NoWarningCVMat.h"
 
@@ -64,7 +67,7 @@ namespace asst::infrast
 {
     struct Oper
     {
-        std::string face_hash; // 有些干员的技能是完全一样的，做个hash区分一下不同干员
+        std::array<uint64_t, 4> face_hash {}; // 有些干员的技能是完全一样的，做个hash区分一下不同干员（Hasher::HashValue）
         Smiley smiley;
         double mood_ratio = 0; // 心情进度条的百分比
         Doing doing = Doing::Invalid;
@@ -30,6 +30,9 @@ namespace asst
         CpuOCR = 1, // use CPU to OCR, no value. It does not support switching after the resource is loaded.
         GpuOCR = 2, // use GPU to OCR, value is gpu_id int to string. It does not support switching after the resource
                     // is loaded.
+        AsyncLog = 3, // write log file in a background thread, "1" | "0". Default "0" (always sync in debug build).
+        LogLevel = 4, // drop log lines below this level before formatting, "debug" | "trace" | "info" | "warn" |
+                      // "error". Default "debug" (no filtering).
     };
 
     enum class InstanceOptionKey
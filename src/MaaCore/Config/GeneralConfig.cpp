@@ -23,7 +23,13 @@ bool asst::GeneralConfig::parse(const json::value& json)
         m_options.minitouch_extra_swipe_duration = options_json.get("minitouchExtraSwipeDuration", -1);
         m_options.minitouch_swipe_default_duration = options_json.get("minitouchSwipeDefaultDuration", 200);
         m_options.minitouch_swipe_extra_end_delay = options_json.get("minitouchSwipeExtraEndDelay", 150);
+        m_options.minitouch_async_gesture = options_json.get("minitouchAsyncGesture", false);
         m_options.swipe_with_pause_required_distance = options_json.get("swipeWithPauseRequiredDistance", 50);
+        m_options.parallel_pipeline_analyze = options_json.get("parallelPipelineAnalyze", false);
+        m_options.parallel_battle_analyze = options_json.get("parallelBattleAnalyze", false);
+        m_options.prefetch_screencap = options_json.get("prefetchScreencap", false);
+        m_options.frame_recognition_cache = options_json.get("frameRecognitionCache", false);
+        m_options.ocr_session_count = options_json.get("ocrSessionCount", 1);
         if (auto order = options_json.find<json::array>("minitouchProgramsOrder")) {
             m_options.minitouch_programs_order.clear();
             for (const auto& type : *order) {
@@ -78,6 +84,7 @@ bool asst::GeneralConfig::parse(const json::value& json)
         adb.screencap_raw_by_nc = cfg_json.get("screencapRawByNC", base_cfg.screencap_raw_by_nc);
         adb.nc_address = cfg_json.get("ncAddress", base_cfg.nc_address);
         adb.screencap_encode = cfg_json.get("screencapEncode", base_cfg.screencap_encode);
+        adb.screencap_raw_by_stream = cfg_json.get("screencapRawByStream", base_cfg.screencap_raw_by_stream);
         adb.release = cfg_json.get("release", base_cfg.release);
         adb.start = cfg_json.get("start", base_cfg.start);
         adb.stop = cfg_json.get("stop", base_cfg.stop);
@@ -50,7 +50,13 @@ namespace asst
         int minitouch_extra_swipe_duration = -1;
         int minitouch_swipe_default_duration = 0;
         int minitouch_swipe_extra_end_delay = 0;
+        bool minitouch_async_gesture = false; // 点击、滑动写入后不等设备执行完就返回，下次截图前再等
         int swipe_with_pause_required_distance = 0;
+        bool parallel_pipeline_analyze = false; // 同一帧上的多个模板匹配任务并行识别
+        bool parallel_battle_analyze = false;   // 战斗中同一帧上的各项识别并行进行
+        bool prefetch_screencap = false;        // 流程任务在 task_delay 等待期间就开始截下一张图
+        bool frame_recognition_cache = false;   // 同一张截图上相同参数的模板匹配、OCR 只识别一次
+        int ocr_session_count = 1;              // OCR 推理会话数，多开实例时可适当调大
         std::vector<std::string> minitouch_programs_order;
         RequestInfo penguin_report; // 企鹅物流汇报：
         // 每次到结算界面，汇报掉落数据至企鹅物流 https://penguin-stats.cn/
@@ -73,6 +79,7 @@ namespace asst
         std::string screencap_raw_by_nc;
         std::string nc_address;
         std::string screencap_encode;
+        std::string screencap_raw_by_stream;
         std::string release;
         std::string start;
         std::string stop;
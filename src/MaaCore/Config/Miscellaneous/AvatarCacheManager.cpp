@@ -44,6 +44,23 @@ const asst::AvatarCacheManager::AvatarsMap& asst::AvatarCacheManager::get_avatar
     return m_avatars[role];
 }
 
+std::shared_ptr<const asst::AvatarIndex> asst::AvatarCacheManager::get_avatar_index(battle::Role role)
+{
+    std::unique_lock<std::mutex> lock(m_index_mutex);
+    auto& index = m_indexes[role];
+    if (!index) {
+        index = std::make_shared<AvatarIndex>(m_avatars[role]);
+        Log.trace(__FUNCTION__, "rebuild index, role:", static_cast<int>(role), ", size:", index->size());
+    }
+    return index;
+}
+
+void asst::AvatarCacheManager::invalidate_index(battle::Role role)
+{
+    std::unique_lock<std::mutex> lock(m_index_mutex);
+    m_indexes.erase(role);
+}
+
 void asst::AvatarCacheManager::set_avatar(const std::string& name, battle::Role role, const cv::Mat& avatar,
                                           bool overlay)
 {
@@ -52,9 +69,12 @@ void asst::AvatarCacheManager::set_avatar(const std::string& name, battle::Role
 
     if (overlay) {
         m_avatars[role].insert_or_assign(name, avatar);
+        invalidate_index(role);
     }
     else {
-        m_avatars[role].try_emplace(name, avatar);
+        if (m_avatars[role].try_emplace(name, avatar).second) {
+            invalidate_index(role);
+        }
         return;
     }
 
@@ -99,5 +119,6 @@ void asst::AvatarCacheManager::_load(LoadItem waiting_to_load)
 
             m_avatars[role].insert_or_assign(name, std::move(avatar));
         }
+        invalidate_index(role);
     }
 }
@@ -4,12 +4,14 @@
 #include "Config/AbstractResource.h"
 
 #include <future>
+#include <memory>
 #include <unordered_map>
 
 #include "Utils/NoWarningCVMat.h"
 
 #include "Common/AsstBattleDef.h"
 #include "Common/AsstTypes.h"
+#include "Vision/Battle/AvatarIndex.h"
 
 namespace asst
 {
@@ -25,17 +27,23 @@ namespace asst
         virtual bool load(const std::filesystem::path& path) override;
 
         const AvatarsMap& get_avatars(battle::Role role);
+        // 按职业预处理好的头像索引，头像有变化时会在下次获取时重建
+        std::shared_ptr<const AvatarIndex> get_avatar_index(battle::Role role);
         void set_avatar(const std::string& name, battle::Role role, const cv::Mat& avatar, bool overlay = true);
 
     private:
         using LoadItem = std::unordered_map<battle::Role, std::unordered_map<std::string, std::filesystem::path>>;
         void _load(LoadItem waiting_to_load);
+        void invalidate_index(battle::Role role);
 
         std::filesystem::path m_save_path;
         std::future<void> m_load_future;
         std::mutex m_load_mutex;
 
         std::unordered_map<battle::Role, std::unordered_map<std::string, cv::Mat>> m_avatars;
+
+        std::mutex m_index_mutex;
+        std::unordered_map<battle::Role, std::shared_ptr<const AvatarIndex>> m_indexes;
     };
     inline static auto& AvatarCache = AvatarCacheManager::get_instance();
 }
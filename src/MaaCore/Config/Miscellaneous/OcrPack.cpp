@@ -1,5 +1,7 @@
 #include "OcrPack.h"
 
+#include <algorithm>
+#include <chrono>
 #include <filesystem>
 
 #include "Utils/NoWarningCV.h"
@@ -9,6 +11,7 @@ ASST_SUPPRESS_CV_WARNINGS_START
 #include "fastdeploy/vision/ocr/ppocr/recognizer.h"
 ASST_SUPPRESS_CV_WARNINGS_END
 
+#include "Config/GeneralConfig.h"
 #include "Utils/Demangle.hpp"
 #include "Utils/File.hpp"
 #include "Utils/Logger.hpp"
@@ -16,7 +19,26 @@ ASST_SUPPRESS_CV_WARNINGS_END
 #include "Utils/Ranges.hpp"
 #include "Utils/StringMisc.hpp"
 
-asst::OcrPack::OcrPack() : m_det(nullptr), m_rec(nullptr), m_ocr(nullptr)
+struct asst::OcrPack::Session
+{
+    std::unique_ptr<fastdeploy::vision::ocr::DBDetector> det;
+    std::unique_ptr<fastdeploy::vision::ocr::Recognizer> rec;
+    std::unique_ptr<fastdeploy::pipeline::PPOCRv3> ocr;
+    size_t generation = 0;
+};
+
+asst::OcrPack::Stats& asst::OcrPack::Stats::operator+=(const Stats& rhs) noexcept
+{
+    calls += rhs.calls;
+    batched_calls += rhs.batched_calls;
+    queue_us += rhs.queue_us;
+    max_queue_us = (std::max)(max_queue_us, rhs.max_queue_us);
+    infer_us += rhs.infer_us;
+    total_us += rhs.total_us;
+    return *this;
+}
+
+asst::OcrPack::OcrPack()
 {
     LogTraceFunction;
 }
@@ -35,9 +57,10 @@ bool asst::OcrPack::load(const std::filesystem::path& path)
     const auto det_dir = path / "det"_p;
     const auto det_model_file = det_dir / "inference.onnx"_p;
 
+    bool changed = false;
     if (std::filesystem::exists(det_model_file) && m_det_model_path != det_model_file) {
         m_det_model_path = det_model_file;
-        m_det = nullptr;
+        changed = true;
     }
 
     const auto rec_dir = path / "rec"_p;
@@ -46,52 +69,168 @@ bool asst::OcrPack::load(const std::filesystem::path& path)
 
     if (std::filesystem::exists(rec_model_file) && m_rec_model_path != rec_model_file) {
         m_rec_model_path = rec_model_file;
-        m_rec = nullptr;
+        changed = true;
     }
     if (std::filesystem::exists(rec_label_file) && m_rec_model_path != rec_label_file) {
         m_rec_label_path = rec_label_file;
-        m_rec = nullptr;
+        changed = true;
     }
 
-    if (m_det && m_rec) {
-        m_ocr = std::make_unique<fastdeploy::pipeline::PPOCRv3>(m_det.get(), m_rec.get());
+    if (changed) {
+        // 正在使用中的会话归还时会因为 generation 不一致被丢弃
+        std::unique_lock<std::mutex> lock(m_session_mutex);
+        m_idle_sessions.clear();
+        m_session_count = 0;
+        ++m_generation;
     }
 
     return !m_det_model_path.empty() && !m_rec_model_path.empty() && !m_rec_label_path.empty();
 }
 
-asst::OcrPack::ResultsVec asst::OcrPack::recognize(const cv::Mat& image, bool without_det)
+asst::OcrPack::ResultsVec asst::OcrPack::recognize(const cv::Mat& image, bool without_det,
+                                                   const Assistant* requester)
 {
     if (!check_and_load()) {
         Log.error(__FUNCTION__, "check_and_load failed");
         return {};
     }
 
-    fastdeploy::vision::OCRResult ocr_result;
-
     auto start_time = std::chrono::steady_clock::now();
+    long long queue_us = 0;
+    long long infer_us = 0;
+    bool batched = false;
+
+    ResultsVec raw_results;
     if (!without_det) {
-        m_ocr->Predict(image, &ocr_result);
+        raw_results = predict_with_det(image, queue_us, infer_us);
     }
     else {
-        std::string rec_text;
-        float rec_score = 0;
-        m_rec->Predict(image, &rec_text, &rec_score);
-        ocr_result.text.emplace_back(std::move(rec_text));
-        ocr_result.rec_scores.emplace_back(rec_score);
+        auto request = std::move(predict_without_det({ image }, queue_us).front());
+        infer_us = request->infer_us;
+        batched = request->batched;
+        raw_results.emplace_back(Result {
+            .rect = Rect(0, 0, image.cols, image.rows),
+            .score = request->score,
+            .text = std::move(request->text),
+        });
     }
 
 #ifdef ASST_DEBUG
     cv::Mat draw = image.clone();
+    for (const auto& result : raw_results) {
+        cv::rectangle(draw, make_rect<cv::Rect>(result.rect), cv::Scalar(0, 0, 255), 2);
+    }
 #endif
 
+    auto total_us =
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+    Stats stats {
+        .calls = 1,
+        .batched_calls = batched ? 1u : 0u,
+        .queue_us = queue_us,
+        .max_queue_us = queue_us,
+        .infer_us = infer_us,
+        .total_us = total_us,
+    };
+    record_stats(requester, stats);
+
+    auto costs = total_us / 1000;
+    std::string class_type = utils::demangle(typeid(*this).name());
+    Log.trace(class_type, raw_results, without_det ? "by OCR Rec" : "by OCR Pipeline", ", cost", costs, "ms",
+              ", queue", queue_us, "us", batched ? ", batched" : "");
+    return raw_results;
+}
+
+asst::OcrPack::ResultsVec asst::OcrPack::recognize_batch(const std::vector<cv::Mat>& images,
+                                                         const Assistant* requester)
+{
+    if (images.empty()) {
+        return {};
+    }
+    if (!check_and_load()) {
+        Log.error(__FUNCTION__, "check_and_load failed");
+        return {};
+    }
+
+    auto start_time = std::chrono::steady_clock::now();
+    long long queue_us = 0;
+    auto requests = predict_without_det(images, queue_us);
+
+    ResultsVec raw_results;
+    raw_results.reserve(requests.size());
+    Stats stats { .calls = requests.size(), .queue_us = queue_us, .max_queue_us = queue_us };
+    for (size_t i = 0; i < requests.size(); ++i) {
+        auto& request = *requests.at(i);
+        raw_results.emplace_back(Result {
+            .rect = Rect(0, 0, images.at(i).cols, images.at(i).rows),
+            .score = request.score,
+            .text = std::move(request.text),
+        });
+        stats.batched_calls += request.batched ? 1 : 0;
+        stats.infer_us = (std::max)(stats.infer_us, request.infer_us);
+    }
+
+    stats.total_us =
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+    record_stats(requester, stats);
+
+    std::string class_type = utils::demangle(typeid(*this).name());
+    Log.trace(class_type, raw_results, "by OCR Rec batch, size", raw_results.size(), ", cost", stats.total_us / 1000,
+              "ms, queue", queue_us, "us");
+    return raw_results;
+}
+
+void asst::OcrPack::record_stats(const Assistant* requester, const Stats& stats)
+{
+    std::unique_lock<std::mutex> lock(m_stats_mutex);
+    m_stats[requester] += stats;
+}
+
+asst::OcrPack::Stats asst::OcrPack::take_stats(const Assistant* requester)
+{
+    std::unique_lock<std::mutex> lock(m_stats_mutex);
+    auto node = m_stats.extract(requester);
+    return node.empty() ? Stats {} : node.mapped();
+}
+
+asst::OcrPack::ResultsVec asst::OcrPack::predict_with_det(const cv::Mat& image, long long& queue_us,
+                                                          long long& infer_us)
+{
+    using namespace std::chrono;
+
+    auto queue_start = steady_clock::now();
+    SessionPtr session;
+    {
+        std::unique_lock<std::mutex> lock(m_session_mutex);
+        while (!(session = try_acquire_session(lock))) {
+            if (m_session_count == 0) {
+                // 一个会话都开不起来，没有可等的了
+                Log.error(__FUNCTION__, "no available session");
+                return {};
+            }
+            m_session_cv.wait(lock);
+        }
+    }
+    auto infer_start = steady_clock::now();
+    queue_us = duration_cast<microseconds>(infer_start - queue_start).count();
+
+    fastdeploy::vision::OCRResult ocr_result;
+    session->ocr->Predict(image, &ocr_result);
+    infer_us = duration_cast<microseconds>(steady_clock::now() - infer_start).count();
+
+    {
+        std::unique_lock<std::mutex> lock(m_session_mutex);
+        release_session(std::move(session));
+    }
+    m_session_cv.notify_all();
+
     ResultsVec raw_results;
     for (size_t i = 0; i != ocr_result.text.size(); ++i) {
         // the box rect like ↓
         // 0 - 1
         // 3 - 2
         Rect det_rect;
-        if (!without_det && i < ocr_result.boxes.size()) {
+        if (i < ocr_result.boxes.size()) {
             const auto& box = ocr_result.boxes.at(i);
             int x_collect[] = { box[0], box[2], box[4], box[6] };
             int y_collect[] = { box[1], box[3], box[5], box[7] };
@@ -103,9 +242,6 @@ asst::OcrPack::ResultsVec asst::OcrPack::recognize(const cv::Mat& image, bool wi
             det_rect = Rect(0, 0, image.cols, image.rows);
         }
 
-#ifdef ASST_DEBUG
-        cv::rectangle(draw, make_rect<cv::Rect>(det_rect), cv::Scalar(0, 0, 255), 2);
-#endif
         Result result {
             .rect = det_rect,
             .score = ocr_result.rec_scores.at(i),
@@ -113,48 +249,230 @@ asst::OcrPack::ResultsVec asst::OcrPack::recognize(const cv::Mat& image, bool wi
         };
         raw_results.emplace_back(std::move(result));
     }
-
-    auto costs =
-        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time).count();
-    std::string class_type = utils::demangle(typeid(*this).name());
-    Log.trace(class_type, raw_results, without_det ? "by OCR Rec" : "by OCR Pipeline", ", cost", costs, "ms");
     return raw_results;
 }
 
+std::vector<asst::OcrPack::RecRequestPtr> asst::OcrPack::predict_without_det(const std::vector<cv::Mat>& images,
+                                                                             long long& queue_us)
+{
+    using namespace std::chrono;
+
+    std::vector<RecRequestPtr> requests;
+    requests.reserve(images.size());
+    for (const cv::Mat& image : images) {
+        auto request = std::make_shared<RecRequest>();
+        request->image = image;
+        requests.emplace_back(std::move(request));
+    }
+    auto all_done = [&]() { return ranges::all_of(requests, [](const RecRequestPtr& req) { return req->done; }); };
+    auto is_mine = [&](const RecRequestPtr& req) { return ranges::find(requests, req) != requests.end(); };
+
+    auto queue_start = steady_clock::now();
+    bool queue_measured = false;
+
+    std::unique_lock<std::mutex> lock(m_session_mutex);
+    m_rec_queue.insert(m_rec_queue.end(), requests.begin(), requests.end());
+
+    while (!all_done()) {
+        // 队列空了说明自己的请求都已经被别的线程打包带走了，等它们算完就行
+        if (m_rec_queue.empty()) {
+            m_session_cv.wait(lock);
+            continue;
+        }
+        SessionPtr session = try_acquire_session(lock);
+        if (!session && m_session_count == 0) {
+            // 一个会话都开不起来，把还没被取走的请求都结束掉，免得一直等
+            Log.error(__FUNCTION__, "no available session");
+            for (const auto& pending : m_rec_queue) {
+                pending->done = true;
+            }
+            m_rec_queue.clear();
+            m_session_cv.notify_all();
+            break;
+        }
+        if (!session) {
+            m_session_cv.wait(lock);
+            continue;
+        }
+        if (all_done()) {
+            // 创建会话时临时解过锁，这期间可能已经被别人算完了
+            release_session(std::move(session));
+            m_session_cv.notify_all();
+            break;
+        }
+
+        std::vector<RecRequestPtr> batch;
+        while (!m_rec_queue.empty() && batch.size() < MaxRecBatchSize) {
+            batch.emplace_back(std::move(m_rec_queue.front()));
+            m_rec_queue.pop_front();
+        }
+        if (!queue_measured && ranges::any_of(batch, is_mine)) {
+            queue_us = duration_cast<microseconds>(steady_clock::now() - queue_start).count();
+            queue_measured = true;
+        }
+
+        lock.unlock();
+        predict_rec_batch(*session, batch);
+        lock.lock();
+
+        for (const auto& finished : batch) {
+            finished->done = true;
+        }
+        release_session(std::move(session));
+        m_session_cv.notify_all();
+    }
+
+    if (!queue_measured) {
+        // 由别的线程代为推理，排队时长按总等待时长减去推理时长计
+        long long infer_us = 0;
+        for (const auto& request : requests) {
+            infer_us = (std::max)(infer_us, request->infer_us);
+        }
+        queue_us =
+            (std::max)(0LL, duration_cast<microseconds>(steady_clock::now() - queue_start).count() - infer_us);
+    }
+    return requests;
+}
+
+void asst::OcrPack::predict_rec_batch(Session& session, const std::vector<RecRequestPtr>& batch)
+{
+    if (batch.empty()) {
+        return;
+    }
+
+    auto start_time = std::chrono::steady_clock::now();
+    if (batch.size() == 1) {
+        auto& request = *batch.front();
+        session.rec->Predict(request.image, &request.text, &request.score);
+    }
+    else {
+        std::vector<cv::Mat> images;
+        images.reserve(batch.size());
+        for (const auto& request : batch) {
+            images.emplace_back(request->image);
+        }
+        std::vector<std::string> texts;
+        std::vector<float> scores;
+        session.rec->BatchPredict(images, &texts, &scores);
+        for (size_t i = 0; i < batch.size(); ++i) {
+            auto& request = *batch.at(i);
+            if (i < texts.size() && i < scores.size()) {
+                request.text = std::move(texts.at(i));
+                request.score = scores.at(i);
+            }
+            request.batched = true;
+        }
+    }
+    auto infer_us =
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+    for (const auto& request : batch) {
+        request->infer_us = infer_us;
+    }
+}
+
 bool asst::OcrPack::check_and_load()
 {
-    if (m_det && m_rec) {
+    std::unique_lock<std::mutex> lock(m_session_mutex);
+    if (m_session_count > 0) {
         return true;
     }
 
     LogTraceFunction;
 
+    // 第一个会话在这里同步创建，顺便检查模型能否正常加载
+    auto session = create_session();
+    if (!session) {
+        return false;
+    }
+    session->generation = m_generation;
+    m_session_count = 1;
+    m_idle_sessions.emplace_back(std::move(session));
+    return true;
+}
+
+asst::OcrPack::SessionPtr asst::OcrPack::create_session()
+{
+    LogTraceFunction;
+
     fastdeploy::RuntimeOption option;
     option.UseOrtBackend();
     if (m_gpu_id) {
         option.UseGpu(*m_gpu_id);
     }
 
+    auto session = std::make_shared<Session>();
+
     auto det_model = asst::utils::read_file<std::string>(m_det_model_path);
     option.SetModelBuffer(det_model.data(), det_model.size(), nullptr, 0, fastdeploy::ModelFormat::ONNX);
-    m_det = std::make_unique<fastdeploy::vision::ocr::DBDetector>("dummy.onnx", std::string(), option,
-                                                                  fastdeploy::ModelFormat::ONNX);
+    session->det = std::make_unique<fastdeploy::vision::ocr::DBDetector>("dummy.onnx", std::string(), option,
+                                                                         fastdeploy::ModelFormat::ONNX);
 
     auto rec_model = asst::utils::read_file<std::string>(m_rec_model_path);
     std::string rec_label = asst::utils::read_file<std::string>(m_rec_label_path);
     option.SetModelBuffer(rec_model.data(), rec_model.size(), nullptr, 0, fastdeploy::ModelFormat::ONNX);
-    m_rec = std::make_unique<fastdeploy::vision::ocr::Recognizer>("dummy.onnx", std::string(), rec_label, option,
-                                                                  fastdeploy::ModelFormat::ONNX);
+    session->rec = std::make_unique<fastdeploy::vision::ocr::Recognizer>("dummy.onnx", std::string(), rec_label,
+                                                                         option, fastdeploy::ModelFormat::ONNX);
 
-    if (m_det && m_rec) {
-        m_ocr = std::make_unique<fastdeploy::pipeline::PPOCRv3>(m_det.get(), m_rec.get());
+    if (session->det && session->rec) {
+        session->ocr = std::make_unique<fastdeploy::pipeline::PPOCRv3>(session->det.get(), session->rec.get());
     }
 
-    bool det_inited = m_det && m_det->Initialized();
-    bool rec_inited = m_rec && m_rec->Initialized();
-    bool ocr_inited = m_ocr && m_ocr->Initialized();
+    bool det_inited = session->det && session->det->Initialized();
+    bool rec_inited = session->rec && session->rec->Initialized();
+    bool ocr_inited = session->ocr && session->ocr->Initialized();
 
     Log.info("det", det_inited, "rec", rec_inited, "ocr", ocr_inited);
 
-    return det_inited && rec_inited && ocr_inited;
+    if (!det_inited || !rec_inited || !ocr_inited) {
+        return nullptr;
+    }
+    return session;
+}
+
+asst::OcrPack::SessionPtr asst::OcrPack::try_acquire_session(std::unique_lock<std::mutex>& lock)
+{
+    while (true) {
+        if (!m_idle_sessions.empty()) {
+            SessionPtr session = std::move(m_idle_sessions.back());
+            m_idle_sessions.pop_back();
+            return session;
+        }
+
+        if (m_session_limit == 0) {
+            m_session_limit = static_cast<size_t>((std::max)(1, Config.get_options().ocr_session_count));
+        }
+        if (m_session_count >= m_session_limit) {
+            return nullptr;
+        }
+
+        // 会话都在忙，且还没到上限，再开一个
+        ++m_session_count;
+        const size_t generation = m_generation;
+        lock.unlock();
+        SessionPtr session = create_session();
+        lock.lock();
+
+        if (generation != m_generation) {
+            // 创建期间模型变了，计数已经被重置，这个会话是旧模型的，按新模型重新来一次
+            continue;
+        }
+        if (!session) {
+            --m_session_count;
+            if (m_session_count > 0) {
+                Log.warn(__FUNCTION__, "failed to create extra session, limit to", m_session_count);
+                m_session_limit = m_session_count;
+            }
+            return nullptr;
+        }
+        session->generation = generation;
+        return session;
+    }
+}
+
+void asst::OcrPack::release_session(SessionPtr session)
+{
+    if (!session || session->generation != m_generation) {
+        return;
+    }
+    m_idle_sessions.emplace_back(std::move(session));
 }
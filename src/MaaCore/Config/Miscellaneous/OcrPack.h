@@ -3,13 +3,15 @@
 #include "Common/AsstTypes.h"
 #include "Config/AbstractResource.h"
 
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <unordered_map>
 #include <vector>
 
-namespace cv
-{
-    class Mat;
-}
+#include "Utils/NoWarningCVMat.h"
 
 namespace fastdeploy
 {
@@ -29,12 +31,30 @@ namespace fastdeploy
 
 namespace asst
 {
+    class Assistant;
+
+    // 多个 Assistant 实例共用的 OCR 服务。
+    // 内部维护一个推理会话池（数量由 ocrSessionCount 配置），调用方排队获取会话；
+    // 无检测的识别请求会被拿到会话的线程打包成一批，一次推理完成
     class OcrPack : public AbstractResource
     {
     public:
         using Result = TextRect;
         using ResultsVec = std::vector<Result>;
 
+        // 按调用方实例分别累计的统计信息
+        struct Stats
+        {
+            size_t calls = 0;         // 识别次数
+            size_t batched_calls = 0; // 与其他请求合并成一批推理的次数
+            long long queue_us = 0;   // 排队等待会话的总时长
+            long long max_queue_us = 0;
+            long long infer_us = 0; // 推理总时长
+            long long total_us = 0; // 从发起请求到拿到结果的总时长
+
+            Stats& operator+=(const Stats& rhs) noexcept;
+        };
+
     public:
         virtual ~OcrPack() override;
 
@@ -42,22 +62,60 @@ namespace asst
         void use_cpu() { m_gpu_id = std::nullopt; }
         void use_gpu(int gpu_id) { m_gpu_id = gpu_id; }
 
-        ResultsVec recognize(const cv::Mat& image, bool without_det = false);
+        ResultsVec recognize(const cv::Mat& image, bool without_det = false, const Assistant* requester = nullptr);
+        // 批量识别多个已经裁好的文字区域（无检测），结果与 images 一一对应
+        // 多张图会被打包成尽量少的几次推理，比逐个调用 recognize(image, true) 快得多
+        ResultsVec recognize_batch(const std::vector<cv::Mat>& images, const Assistant* requester = nullptr);
+        // 取出并清空某个实例的统计
+        Stats take_stats(const Assistant* requester);
 
     protected:
+        struct Session;
+        using SessionPtr = std::shared_ptr<Session>;
+
+        struct RecRequest
+        {
+            cv::Mat image;
+            std::string text;
+            float score = 0;
+            bool done = false;
+            bool batched = false;
+            long long infer_us = 0;
+        };
+        using RecRequestPtr = std::shared_ptr<RecRequest>;
+
+        static constexpr size_t MaxRecBatchSize = 8;
+
         OcrPack();
 
         bool check_and_load();
+        SessionPtr create_session();
+        // 以下两个函数需持有 m_session_mutex，try_acquire_session 创建新会话时会临时解锁
+        // try_acquire_session 只在会话数已达上限或创建失败时返回 nullptr，期间模型变更会自动重试
+        SessionPtr try_acquire_session(std::unique_lock<std::mutex>& lock);
+        void release_session(SessionPtr session);
 
-        std::unique_ptr<fastdeploy::vision::ocr::DBDetector> m_det;
-        std::unique_ptr<fastdeploy::vision::ocr::Recognizer> m_rec;
-        std::unique_ptr<fastdeploy::pipeline::PPOCRv3> m_ocr;
+        ResultsVec predict_with_det(const cv::Mat& image, long long& queue_us, long long& infer_us);
+        std::vector<RecRequestPtr> predict_without_det(const std::vector<cv::Mat>& images, long long& queue_us);
+        static void predict_rec_batch(Session& session, const std::vector<RecRequestPtr>& batch);
+        void record_stats(const Assistant* requester, const Stats& stats);
 
         std::filesystem::path m_det_model_path;
         std::filesystem::path m_rec_model_path;
         std::filesystem::path m_rec_label_path;
 
         std::optional<int> m_gpu_id = std::nullopt;
+
+        std::mutex m_session_mutex;
+        std::condition_variable m_session_cv;
+        std::vector<SessionPtr> m_idle_sessions;
+        size_t m_session_count = 0;
+        size_t m_session_limit = 0; // 0 为未知，首次使用时从配置读取
+        size_t m_generation = 0;    // 模型变更后递增，旧会话用完即丢弃
+        std::deque<RecRequestPtr> m_rec_queue;
+
+        std::mutex m_stats_mutex;
+        std::unordered_map<const Assistant*, Stats> m_stats;
     };
 
     class WordOcr final : public SingletonHolder<WordOcr>, public OcrPack
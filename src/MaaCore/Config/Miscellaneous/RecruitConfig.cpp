@@ -15,6 +15,18 @@ std::string asst::RecruitConfig::get_tag_name(const TagId& id) const noexcept
     return iter->second;
 }
 
+asst::RecruitConfig::TagMask asst::RecruitConfig::get_tag_mask(const TagId& id) const noexcept
+{
+    auto iter = m_tag_masks.find(id);
+    return iter == m_tag_masks.cend() ? 0 : iter->second;
+}
+
+const asst::RecruitConfig::TagComb* asst::RecruitConfig::find_tag_comb(TagMask tags) const noexcept
+{
+    auto iter = m_tag_combs.find(tags);
+    return iter == m_tag_combs.cend() ? nullptr : &iter->second;
+}
+
 bool asst::RecruitConfig::parse(const json::value& json)
 {
     LogTraceFunction;
@@ -41,6 +53,83 @@ bool asst::RecruitConfig::parse(const json::value& json)
     // 按干员等级排个序
     ranges::sort(m_all_opers, std::greater {}, std::mem_fn(&Recruitment::level));
 
+    return build_tag_combs();
+}
+
+bool asst::RecruitConfig::build_tag_combs()
+{
+    LogTraceFunction;
+
+    std::vector<TagId> tags(m_all_tags.begin(), m_all_tags.end());
+    ranges::sort(tags);
+    if (tags.size() > sizeof(TagMask) * 8 || m_all_opers.size() > MaxCombOpers) {
+        Log.error(__FUNCTION__, "too many tags or operators", tags.size(), m_all_opers.size());
+        return false;
+    }
+
+    // 和 RecruitCombs 里的顺序一致：等级升序，同等级按名字降序
+    m_comb_opers = m_all_opers;
+    ranges::sort(m_comb_opers);
+
+    std::vector<OperSet> tag_opers(tags.size());
+    OperSet six_star_opers;
+    for (size_t i = 0; i < m_comb_opers.size(); ++i) {
+        const Recruitment& oper = m_comb_opers[i];
+        for (size_t t = 0; t < tags.size(); ++t) {
+            tag_opers[t][i] = oper.has_tag(tags[t]);
+        }
+        six_star_opers[i] = oper.level >= 6;
+    }
+
+    size_t senior_index = tags.size();
+    for (size_t t = 0; t < tags.size(); ++t) {
+        m_tag_masks.emplace(tags[t], TagMask(1) << t);
+        if (tags[t] == SeniorOperTag) {
+            senior_index = t;
+        }
+    }
+
+    auto emplace_comb = [&](TagMask mask, OperSet opers) {
+        if (senior_index == tags.size() || !(mask & (TagMask(1) << senior_index))) {
+            opers &= ~six_star_opers;
+        }
+        if (opers.none()) {
+            return;
+        }
+        TagComb comb { .opers = opers, .min_level = 7, .max_level = 0 };
+        int level_sum = 0;
+        for (size_t i = 0; i < m_comb_opers.size(); ++i) {
+            if (!opers[i]) {
+                continue;
+            }
+            const int level = m_comb_opers[i].level;
+            comb.min_level = (std::min)(comb.min_level, level);
+            comb.max_level = (std::max)(comb.max_level, level);
+            level_sum += level;
+        }
+        comb.avg_level = level_sum / static_cast<double>(opers.count());
+        m_tag_combs.emplace(mask, std::move(comb));
+    };
+
+    static_assert(MaxCombTags == 3);
+    for (size_t i = 0; i < tags.size(); ++i) {
+        const TagMask mask1 = TagMask(1) << i;
+        emplace_comb(mask1, tag_opers[i]);
+        for (size_t j = i + 1; j < tags.size(); ++j) {
+            const TagMask mask2 = mask1 | (TagMask(1) << j);
+            // 两个 tag 的交集就已经为空时，再加 tag 也不会有干员
+            const OperSet opers2 = tag_opers[i] & tag_opers[j];
+            emplace_comb(mask2, opers2);
+            if (opers2.none()) {
+                continue;
+            }
+            for (size_t k = j + 1; k < tags.size(); ++k) {
+                emplace_comb(mask2 | (TagMask(1) << k), opers2 & tag_opers[k]);
+            }
+        }
+    }
+    Log.info(__FUNCTION__, "tags:", tags.size(), "opers:", m_comb_opers.size(), "combs:", m_tag_combs.size());
+
     return true;
 }
 
@@ -51,4 +140,7 @@ void asst::RecruitConfig::clear()
     m_all_opers.clear();
     m_all_tags.clear();
     m_all_tags_name.clear();
+    m_tag_masks.clear();
+    m_comb_opers.clear();
+    m_tag_combs.clear();
 }
@@ -4,8 +4,11 @@
 
 #include "Utils/Ranges.hpp"
 #include <algorithm>
+#include <bitset>
+#include <cstdint>
 #include <numeric>
 #include <string>
+#include <string_view>
 #include <unordered_set>
 #include <vector>
 
@@ -93,23 +96,52 @@ namespace asst
     {
     public:
         using TagId = std::string;
+        using TagMask = uint64_t;
+
+        static constexpr size_t MaxCombOpers = 512;
+        // 第 i 位对应 get_comb_opers()[i]
+        using OperSet = std::bitset<MaxCombOpers>;
+
+        // 一组 tag（最多 3 个）同时选上时可能出现的干员
+        struct TagComb
+        {
+            OperSet opers; // 组合里没有“高级资深干员”时已经排除了 6 星
+            int min_level = 0;
+            int max_level = 0;
+            double avg_level = 0;
+        };
 
     public:
         virtual ~RecruitConfig() override = default;
         static constexpr int CorrectNumberOfTags = 5;
+        static constexpr size_t MaxCombTags = 3;
+        static constexpr std::string_view SeniorOperTag = "高级资深干员";
 
         const std::unordered_set<std::string>& get_all_tags() const noexcept { return m_all_tags; }
         const std::vector<Recruitment>& get_all_opers() const noexcept { return m_all_opers; }
         std::string get_tag_name(const TagId& id) const noexcept;
 
+        // 未知的 tag 返回 0
+        TagMask get_tag_mask(const TagId& id) const noexcept;
+        // 组合里没有任何干员时返回 nullptr
+        const TagComb* find_tag_comb(TagMask tags) const noexcept;
+        // 按等级升序排好的干员，和 OperSet 的位一一对应
+        const std::vector<Recruitment>& get_comb_opers() const noexcept { return m_comb_opers; }
+
     protected:
         virtual bool parse(const json::value& json) override;
 
         void clear();
+        // 加载时把所有不超过 MaxCombTags 个 tag 的组合都算好，识别时只剩查表
+        bool build_tag_combs();
 
         std::unordered_set<std::string> m_all_tags;
         std::vector<Recruitment> m_all_opers;
         std::unordered_map<TagId, std::string> m_all_tags_name;
+
+        std::unordered_map<TagId, TagMask> m_tag_masks;
+        std::vector<Recruitment> m_comb_opers;
+        std::unordered_map<TagMask, TagComb> m_tag_combs;
     };
     inline static auto& RecruitData = RecruitConfig::get_instance();
 } // namespace asst
@@ -1,25 +1,135 @@
 #include "TilePack.h"
 
 #include "Common/AsstConf.h"
+#include "Common/AsstVersion.h"
 #include "meojson/json.hpp"
 
 #include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
+#include <cstring>
 #include <filesystem>
+#include <fstream>
 #include <future>
 #include <list>
 #include <mutex>
 #include <numeric>
 #include <optional>
 #include <queue>
+#include <set>
 
 ASST_SUPPRESS_CV_WARNINGS_START
 #include <Arknights-Tile-Pos/TileCalc.hpp>
 ASST_SUPPRESS_CV_WARNINGS_END
 
+#include "Utils/File.hpp"
+#include "Utils/FileCache.hpp"
 #include "Utils/Logger.hpp"
+#include "Utils/Ranges.hpp"
+#include "Utils/WorkerPool.hpp"
+
+namespace
+{
+    constexpr char PackMagic[8] = { 'M', 'A', 'A', 'T', 'I', 'L', 'E', 'S' };
+    constexpr uint32_t PackVersion = 2;
+    constexpr uint32_t PackEndianTag = 0x01020304;
+    constexpr int32_t MaxPackedSide = 1024;
+    constexpr size_t MaxCachedResults = 64;
+
+    // pack 格式版本和程序版本也算进去，任何一个变了都要重新生成
+    uint64_t hash_summary(uint64_t seed, std::string_view content) noexcept
+    {
+        uint64_t hash = asst::utils::fnv1a(seed, PackVersion);
+        hash = asst::utils::fnv1a(hash, std::string_view(asst::Version));
+        return asst::utils::fnv1a(hash, content);
+    }
+
+    // 关卡 json 的大小和修改时间，和 pack 里记录的对比
+    bool stat_level_file(const std::filesystem::path& path, uint64_t& file_size, int64_t& write_time)
+    {
+        std::error_code ec;
+        file_size = std::filesystem::file_size(path, ec);
+        if (ec) {
+            return false;
+        }
+        write_time = static_cast<int64_t>(std::filesystem::last_write_time(path, ec).time_since_epoch().count());
+        return !ec;
+    }
+
+    // pack 文件的顺序读取，越界时 ok 置为 false，之后读到的都是 0
+    struct PackReader
+    {
+        const std::vector<char>& data;
+        size_t offset = 0;
+        bool ok = true;
+
+        bool read(void* dst, size_t size)
+        {
+            if (!ok || size > data.size() - offset) {
+                ok = false;
+                std::memset(dst, 0, size);
+                return false;
+            }
+            std::memcpy(dst, data.data() + offset, size);
+            offset += size;
+            return true;
+        }
+
+        template <typename T>
+        T read()
+        {
+            static_assert(std::is_trivially_copyable_v<T>);
+            T value {};
+            read(&value, sizeof(T));
+            return value;
+        }
+
+        std::string read_string()
+        {
+            auto size = read<uint32_t>();
+            if (!ok || size > data.size() - offset) {
+                ok = false;
+                return {};
+            }
+            std::string str(data.data() + offset, size);
+            offset += size;
+            return str;
+        }
+    };
+
+    struct PackWriter
+    {
+        std::string data;
+
+        void write(const void* src, size_t size) { data.append(reinterpret_cast<const char*>(src), size); }
+
+        template <typename T>
+        void write(const T& value)
+        {
+            static_assert(std::is_trivially_copyable_v<T>);
+            write(&value, sizeof(T));
+        }
+
+        void write_string(std::string_view str)
+        {
+            write(static_cast<uint32_t>(str.size()));
+            write(str.data(), str.size());
+        }
+    };
+}
+
+asst::TilePack::~TilePack()
+{
+    if (!m_pack_job.valid()) {
+        return;
+    }
+    // 生成 pack 的任务会写日志和文件，要等它停下。这里只等 future 不 join 线程，不会和 loader lock 死锁；
+    // 但进程退出时工作线程可能已经被系统结束了，所以不无限等
+    using namespace std::chrono_literals;
+    *m_pack_stop = true;
+    m_pack_job.wait_for(5s);
+}
 
 bool asst::TilePack::parse(const json::value& json)
 {
@@ -40,6 +150,228 @@ bool asst::TilePack::parse(const json::value& json)
         // }
         m_summarize.emplace_back(std::move(level_key), std::move(filepath));
     }
+
+    {
+        // 资源可能被 OTA 更新过，之前的结果都不能再用了
+        std::unique_lock lock(m_cache_mutex);
+        m_pack_keys.clear();
+        m_packed.clear();
+        m_pack_file.clear();
+        m_pack_outdated = false;
+        m_levels.clear();
+        m_results.clear();
+    }
+
+    m_summary_hash = hash_summary(m_summary_hash, utils::read_file<std::string>(m_path));
+    const auto pack_file = utils::file_cache::path("tiles", m_summary_hash);
+    if (load_pack(pack_file)) {
+        utils::file_cache::touch(pack_file);
+    }
+    else {
+        start_build_pack(pack_file);
+    }
+    return true;
+}
+
+bool asst::TilePack::load_pack(const std::filesystem::path& path)
+{
+    LogTraceFunction;
+
+    if (!std::filesystem::exists(path)) {
+        return false;
+    }
+
+    const auto data = utils::read_file<std::vector<char>>(path);
+    PackReader reader { data };
+
+    char magic[sizeof(PackMagic)] = {};
+    reader.read(magic, sizeof(magic));
+    if (std::memcmp(magic, PackMagic, sizeof(PackMagic)) != 0 || reader.read<uint32_t>() != PackVersion ||
+        reader.read<uint32_t>() != PackEndianTag || reader.read<uint64_t>() != m_summary_hash) {
+        Log.warn(__FUNCTION__, "invalid pack", path);
+        return false;
+    }
+
+    std::vector<std::string> keys(reader.read<uint32_t>());
+    for (auto& key : keys) {
+        key = reader.read_string();
+    }
+
+    const auto dir = m_path.parent_path();
+    std::map<std::filesystem::path, PackedLevel> packed;
+    const auto level_count = reader.read<uint32_t>();
+    for (uint32_t i = 0; i < level_count && reader.ok; ++i) {
+        auto filepath = dir / utils::path(reader.read_string());
+        PackedLevel level;
+        level.file_size = reader.read<uint64_t>();
+        level.write_time = reader.read<int64_t>();
+        level.height = reader.read<int32_t>();
+        level.width = reader.read<int32_t>();
+        reader.read(level.view, sizeof(level.view));
+        if (level.height < 0 || level.height > MaxPackedSide || level.width < 0 || level.width > MaxPackedSide) {
+            reader.ok = false;
+            break;
+        }
+        level.tiles.resize(static_cast<size_t>(level.height) * level.width);
+        reader.read(level.tiles.data(), level.tiles.size() * sizeof(PackedTile));
+        if (ranges::any_of(level.tiles, [&](const PackedTile& tile) { return tile.tile_key >= keys.size(); })) {
+            reader.ok = false;
+            break;
+        }
+        packed.insert_or_assign(std::move(filepath), std::move(level));
+    }
+    if (!reader.ok || reader.offset != data.size()) {
+        Log.warn(__FUNCTION__, "invalid pack", path);
+        return false;
+    }
+
+    Log.info(__FUNCTION__, path, "levels:", packed.size());
+    std::unique_lock lock(m_cache_mutex);
+    m_pack_keys = std::move(keys);
+    m_packed = std::move(packed);
+    m_pack_file = path;
+    return true;
+}
+
+void asst::TilePack::start_build_pack(const std::filesystem::path& path)
+{
+    // 又加载了一份 overview，之前那个 pack 已经不完整了
+    stop_build_pack();
+    m_pack_stop = std::make_shared<std::atomic_bool>(false);
+
+    m_pack_job = WorkerPool::get_instance().submit(
+        [path, summary_hash = m_summary_hash, dir = m_path.parent_path(), levels = m_summarize,
+         stop = m_pack_stop]() { return build_pack(path, summary_hash, dir, levels, *stop); });
+}
+
+void asst::TilePack::stop_build_pack()
+{
+    if (!m_pack_job.valid()) {
+        return;
+    }
+    *m_pack_stop = true;
+    // 每读完一个关卡文件就会检查停止标志，很快就能等到
+    WorkerPool::get_instance().wait(m_pack_job);
+}
+
+bool asst::TilePack::build_pack(const std::filesystem::path& path, uint64_t summary_hash,
+                                const std::filesystem::path& dir, const LazyMap& levels, const std::atomic_bool& stop)
+{
+    PackWriter keys_writer;
+    PackWriter levels_writer;
+    std::unordered_map<std::string, uint16_t> key_ids;
+    std::set<std::filesystem::path> visited;
+    uint32_t level_count = 0;
+
+    for (const auto& filepath : levels | views::values) {
+        if (stop) {
+            return false;
+        }
+        if (!visited.emplace(filepath).second) {
+            continue;
+        }
+        uint64_t file_size = 0;
+        int64_t write_time = 0;
+        if (!stat_level_file(filepath, file_size, write_time)) {
+            continue;
+        }
+        auto json_opt = json::open(filepath);
+        if (!json_opt) {
+            continue;
+        }
+
+        try {
+            const auto& level_json = *json_opt;
+            PackedLevel level;
+            level.file_size = file_size;
+            level.write_time = write_time;
+            level.height = level_json.at("height").as_integer();
+            level.width = level_json.at("width").as_integer();
+            const auto& view = level_json.at("view").as_array();
+            if (view.size() < 2 || level.height < 0 || level.height > MaxPackedSide || level.width < 0 ||
+                level.width > MaxPackedSide) {
+                continue;
+            }
+            for (size_t i = 0; i < 2; ++i) {
+                for (size_t j = 0; j < 3; ++j) {
+                    level.view[i][j] = view[i].as_array()[j].as_double();
+                }
+            }
+            const auto& rows = level_json.at("tiles").as_array();
+            if (rows.size() != static_cast<size_t>(level.height)) {
+                continue;
+            }
+            bool shape_ok = true;
+            for (const auto& row : rows) {
+                const auto& row_array = row.as_array();
+                if (row_array.size() != static_cast<size_t>(level.width)) {
+                    shape_ok = false;
+                    break;
+                }
+                for (const auto& tile : row_array) {
+                    auto [iter, inserted] =
+                        key_ids.try_emplace(tile.get("tileKey", std::string()), static_cast<uint16_t>(key_ids.size()));
+                    if (inserted) {
+                        keys_writer.write_string(iter->first);
+                    }
+                    level.tiles.emplace_back(PackedTile { static_cast<int16_t>(tile.at("heightType").as_integer()),
+                                                          static_cast<int16_t>(tile.at("buildableType").as_integer()),
+                                                          iter->second });
+                }
+            }
+            if (!shape_ok) {
+                continue;
+            }
+
+            levels_writer.write_string(
+                utils::path_to_utf8_string(filepath.lexically_relative(dir)));
+            levels_writer.write(level.file_size);
+            levels_writer.write(level.write_time);
+            levels_writer.write(level.height);
+            levels_writer.write(level.width);
+            levels_writer.write(level.view, sizeof(level.view));
+            levels_writer.write(level.tiles.data(), level.tiles.size() * sizeof(PackedTile));
+            ++level_count;
+        }
+        catch (const json::exception&) {
+            continue;
+        }
+    }
+    if (stop) {
+        return false;
+    }
+
+    PackWriter writer;
+    writer.write(PackMagic, sizeof(PackMagic));
+    writer.write(PackVersion);
+    writer.write(PackEndianTag);
+    writer.write(summary_hash);
+    writer.write(static_cast<uint32_t>(key_ids.size()));
+    writer.data += keys_writer.data;
+    writer.write(level_count);
+    writer.data += levels_writer.data;
+
+    // 先写临时文件再改名，避免别的进程读到写了一半的 pack
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+    auto temp_path = path;
+    temp_path += ".tmp";
+    {
+        std::ofstream ofs(temp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!ofs || !ofs.write(writer.data.data(), static_cast<std::streamsize>(writer.data.size()))) {
+            Log.error(__FUNCTION__, "failed to write", temp_path);
+            return false;
+        }
+    }
+    std::filesystem::rename(temp_path, path, ec);
+    if (ec) {
+        Log.error(__FUNCTION__, "failed to rename", temp_path, ec.message());
+        std::filesystem::remove(temp_path, ec);
+        return false;
+    }
+    Log.info(__FUNCTION__, path, "levels:", level_count, "size:", writer.data.size());
+
+    utils::file_cache::remove_expired(path);
     return true;
 }
 
@@ -88,30 +420,108 @@ std::unordered_map<asst::Point, asst::TilePack::TileInfo> proc_data(const std::v
     return dst;
 }
 
-std::unordered_map<asst::Point, asst::TilePack::TileInfo> asst::TilePack::calc_(const std::filesystem::path& filepath,
-                                                                                bool side, double shift_x,
-                                                                                double shift_y) const
+asst::TilePack::TileMap asst::TilePack::calc_(const std::filesystem::path& filepath, bool side, double shift_x,
+                                              double shift_y) const
 {
     LogTraceFunction;
 
-    auto json_opt = json::open(filepath);
-    if (!json_opt) {
-        Log.info("failed to open", filepath);
+    auto result_key = std::make_tuple(filepath, side, shift_x, shift_y);
+    {
+        std::unique_lock lock(m_cache_mutex);
+        if (auto iter = m_results.find(result_key); iter != m_results.cend()) {
+            return iter->second;
+        }
+    }
+
+    auto level = get_level(filepath);
+    if (!level) {
         return {};
     }
 
     std::vector<std::vector<cv::Point2d>> pos;
     std::vector<std::vector<Map::Tile>> tiles;
 
-    Map::Level level(*json_opt);
     Map::TileCalc calcer(WindowWidthDefault, WindowHeightDefault);
 
-    bool ret = calcer.run(level, side, pos, tiles, shift_x, shift_y);
+    bool ret = calcer.run(*level, side, pos, tiles, shift_x, shift_y);
 
     if (!ret) {
         Log.info("Tiles calc error!");
         return {};
     }
 
-    return proc_data(pos, tiles);
+    auto result = proc_data(pos, tiles);
+
+    std::unique_lock lock(m_cache_mutex);
+    if (m_results.size() >= MaxCachedResults) {
+        m_results.clear();
+    }
+    m_results.insert_or_assign(std::move(result_key), result);
+    return result;
+}
+
+std::shared_ptr<const Map::Level> asst::TilePack::get_level(const std::filesystem::path& filepath) const
+{
+    {
+        std::unique_lock lock(m_cache_mutex);
+        if (auto iter = m_levels.find(filepath); iter != m_levels.cend()) {
+            return iter->second;
+        }
+        if (auto iter = m_packed.find(filepath); iter != m_packed.cend()) {
+            uint64_t file_size = 0;
+            int64_t write_time = 0;
+            if (stat_level_file(filepath, file_size, write_time) && file_size == iter->second.file_size &&
+                write_time == iter->second.write_time) {
+                auto level = unpack_level(iter->second);
+                m_levels.emplace(filepath, level);
+                return level;
+            }
+            Log.info("level file changed, ignore pack", filepath);
+            if (!m_pack_outdated) {
+                // pack 的文件名只和 overview 有关，关卡文件单独更新时名字不变，删掉让下次启动重新生成
+                m_pack_outdated = true;
+                std::error_code ec;
+                std::filesystem::remove(m_pack_file, ec);
+            }
+        }
+    }
+
+    auto json_opt = json::open(filepath);
+    if (!json_opt) {
+        Log.info("failed to open", filepath);
+        return nullptr;
+    }
+    auto level = std::make_shared<const Map::Level>(*json_opt);
+
+    std::unique_lock lock(m_cache_mutex);
+    m_levels.insert_or_assign(filepath, level);
+    return level;
+}
+
+std::shared_ptr<const Map::Level> asst::TilePack::unpack_level(const PackedLevel& packed) const
+{
+    // Map::Level 只能从 json 构造，这里拼一个只有必要字段的小 json，比读原文件快得多
+    json::array view;
+    for (const auto& point : packed.view) {
+        view.emplace_back(json::array { point[0], point[1], point[2] });
+    }
+    json::array rows;
+    for (int32_t y = 0; y < packed.height; ++y) {
+        json::array row;
+        for (int32_t x = 0; x < packed.width; ++x) {
+            const auto& tile = packed.tiles[static_cast<size_t>(y) * packed.width + x];
+            row.emplace_back(json::object {
+                { "heightType", static_cast<int>(tile.height_type) },
+                { "buildableType", static_cast<int>(tile.buildable_type) },
+                { "tileKey", m_pack_keys[tile.tile_key] },
+            });
+        }
+        rows.emplace_back(std::move(row));
+    }
+    json::value level_json = json::object {
+        { "stageId", std::string() }, { "code", std::string() },   { "levelId", std::string() },
+        { "height", packed.height },  { "width", packed.width },   { "view", std::move(view) },
+        { "tiles", std::move(rows) },
+    };
+    return std::make_shared<const Map::Level>(level_json);
 }
@@ -4,8 +4,20 @@
 #include "Common/AsstTypes.h"
 #include "Config/AbstractConfig.h"
 
+#include <atomic>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+
 #include <Arknights-Tile-Pos/TileDef.hpp>
 
+namespace Map
+{
+    class Level;
+}
+
 namespace asst
 {
     class TilePack final : public SingletonHolder<TilePack>, public AbstractConfig
@@ -52,7 +64,7 @@ namespace asst
         };
 
     public:
-        virtual ~TilePack() override = default;
+        virtual ~TilePack() override;
 
         template <typename KeyT>
         std::optional<LazyMap::value_type> find(const KeyT& key) const
@@ -65,6 +77,7 @@ namespace asst
             return std::nullopt;
         }
 
+        // 结果按 (关卡, 是否侧视, 偏移) 缓存，同一关卡再次计算时直接返回
         template <typename KeyT>
         std::unordered_map<Point, TileInfo> calc(const KeyT& key, bool side, double shift_x = 0,
                                                  double shift_y = 0) const
@@ -80,9 +93,54 @@ namespace asst
         virtual bool parse(const json::value& json) override;
 
     private:
-        std::unordered_map<Point, TileInfo> calc_(const std::filesystem::path& filepath, bool side, double shift_x,
-                                                  double shift_y) const;
+        using TileMap = std::unordered_map<Point, TileInfo>;
+
+        // pack 里的一个格子，tile_key 是 m_pack_keys 的下标
+        struct PackedTile
+        {
+            int16_t height_type = 0;
+            int16_t buildable_type = 0;
+            uint16_t tile_key = 0;
+        };
+
+        // pack 里的一个关卡，只保留计算坐标需要的数据
+        struct PackedLevel
+        {
+            // 对应 json 文件的大小和修改时间，任何一个对不上说明文件被改过，不用 pack 里的数据
+            uint64_t file_size = 0;
+            int64_t write_time = 0;
+            int32_t height = 0;
+            int32_t width = 0;
+            double view[2][3] = {};
+            std::vector<PackedTile> tiles; // height * width 个，按行存放
+        };
+
+        TileMap calc_(const std::filesystem::path& filepath, bool side, double shift_x, double shift_y) const;
+        std::shared_ptr<const Map::Level> get_level(const std::filesystem::path& filepath) const;
+        std::shared_ptr<const Map::Level> unpack_level(const PackedLevel& packed) const;
+
+        bool load_pack(const std::filesystem::path& path);
+        // 在线程池里把所有关卡的 json 读一遍写成 pack，下次启动时使用
+        void start_build_pack(const std::filesystem::path& path);
+        // 让正在生成的 pack 停下并等它结束
+        void stop_build_pack();
+        static bool build_pack(const std::filesystem::path& path, uint64_t summary_hash,
+                               const std::filesystem::path& dir, const LazyMap& levels, const std::atomic_bool& stop);
+
         LazyMap m_summarize;
+        uint64_t m_summary_hash = 0; // 已加载的所有 overview.json 叠加的哈希
+
+        std::vector<std::string> m_pack_keys;                  // 地块类型的字符串表
+        std::map<std::filesystem::path, PackedLevel> m_packed; // key: 关卡 json 的路径
+        std::filesystem::path m_pack_file;                     // 已加载的 pack，发现过时后删掉，下次启动重新生成
+        mutable bool m_pack_outdated = false;
+
+        mutable std::mutex m_cache_mutex;
+        mutable std::map<std::filesystem::path, std::shared_ptr<const Map::Level>> m_levels;
+        mutable std::map<std::tuple<std::filesystem::path, bool, double, double>, TileMap> m_results;
+
+        std::shared_ptr<std::atomic_bool> m_pack_stop; // 正在生成 pack 的任务的停止标志
+        std::future<bool> m_pack_job;
     };
 
     inline static auto& Tile = TilePack::get_instance();
@@ -1,7 +1,11 @@
 #include "OnnxSessions.h"
 
+#include <algorithm>
 #include <array>
+#include <chrono>
 #include <filesystem>
+#include <functional>
+#include <numeric>
 #include <string_view>
 
 #include "Utils/Logger.hpp"
@@ -13,8 +17,11 @@ bool asst::OnnxSessions::load(const std::filesystem::path& path)
 
     std::string name = utils::path_to_utf8_string(path.stem());
 
+    std::unique_lock lock(m_mutex);
     if (auto iter = m_model_paths.find(name); iter == m_model_paths.end() || iter->second != path) {
+        // 正在使用的上下文还持有旧会话，用完放回时会被丢弃
         m_sessions.erase(name);
+        m_idle_contexts.erase(name);
         m_model_paths.insert_or_assign(name, path);
     }
 
@@ -23,10 +30,126 @@ bool asst::OnnxSessions::load(const std::filesystem::path& path)
 
 Ort::Session& asst::OnnxSessions::get(const std::string& name)
 {
-    if (m_sessions.find(name) == m_sessions.end()) {
+    return *get_session(name);
+}
+
+std::shared_ptr<Ort::Session> asst::OnnxSessions::get_session(const std::string& name)
+{
+    std::unique_lock lock(m_mutex);
+    auto iter = m_sessions.find(name);
+    if (iter == m_sessions.end()) {
         Log.info(__FUNCTION__, "lazy load", name);
-        Ort::Session session(m_env, m_model_paths.at(name).c_str(), m_options);
-        m_sessions.emplace(name, std::move(session));
+        auto session = std::make_shared<Ort::Session>(m_env, m_model_paths.at(name).c_str(), m_options);
+        iter = m_sessions.emplace(name, std::move(session)).first;
+    }
+    return iter->second;
+}
+
+asst::OnnxSessions::ContextPtr asst::OnnxSessions::acquire(const std::string& name)
+{
+    {
+        std::unique_lock lock(m_mutex);
+        if (auto& idle = m_idle_contexts[name]; !idle.empty()) {
+            ContextPtr context(idle.back().release());
+            idle.pop_back();
+            return context;
+        }
+    }
+    Log.info(__FUNCTION__, "new context", name);
+    return ContextPtr(new Context(name, get_session(name)));
+}
+
+void asst::OnnxSessions::release(Context* context)
+{
+    std::unique_ptr<Context> holder(context);
+
+    std::unique_lock lock(m_mutex);
+    if (auto iter = m_sessions.find(context->m_name); iter != m_sessions.end() && iter->second == context->m_session) {
+        m_idle_contexts[context->m_name].emplace_back(std::move(holder));
+    }
+}
+
+void asst::OnnxSessions::ContextReleaser::operator()(Context* context) const
+{
+    if (context) {
+        OnnxSessions::get_instance().release(context);
+    }
+}
+
+asst::OnnxSessions::Context::Context(std::string name, std::shared_ptr<Ort::Session> session)
+    : m_name(std::move(name)),
+      m_session(std::move(session)),
+      m_memory_info(Ort::MemoryInfo::CreateCpu(OrtDeviceAllocator, OrtMemTypeCPU)),
+      m_binding(*m_session)
+{
+    Ort::AllocatorWithDefaultOptions allocator;
+    m_input_name = m_session->GetInputNameAllocated(0, allocator).get();
+    m_output_name = m_session->GetOutputNameAllocated(0, allocator).get();
+    m_model_input_shape = m_session->GetInputTypeInfo(0).GetTensorTypeAndShapeInfo().GetShape();
+    m_model_output_shape = m_session->GetOutputTypeInfo(0).GetTensorTypeAndShapeInfo().GetShape();
+}
+
+size_t asst::OnnxSessions::Context::batch_limit() const noexcept
+{
+    if (m_model_input_shape.empty() || m_model_input_shape.front() <= 0) {
+        return 0;
+    }
+    return static_cast<size_t>(m_model_input_shape.front());
+}
+
+float* asst::OnnxSessions::Context::input(const Shape& shape)
+{
+    if (m_input_tensor && shape == m_input_shape) {
+        return m_input.data();
+    }
+
+    auto element_count = [](const auto& dims) {
+        return static_cast<size_t>(std::accumulate(dims.begin(), dims.end(), int64_t(1), std::multiplies<>()));
+    };
+
+    m_input_shape = shape;
+    m_input.resize(element_count(shape));
+    m_input_tensor = Ort::Value::CreateTensor<float>(m_memory_info, m_input.data(), m_input.size(),
+                                                     m_input_shape.data(), m_input_shape.size());
+    m_binding.ClearBoundInputs();
+    m_binding.BindInput(m_input_name.c_str(), *m_input_tensor);
+
+    // batch 维度跟着输入走，其余维度都固定时才能预先分配输出
+    m_output_shape = m_model_output_shape;
+    if (!m_output_shape.empty() && m_output_shape.front() < 0) {
+        m_output_shape.front() = shape.front();
+    }
+    m_output_preallocated = std::all_of(m_output_shape.begin(), m_output_shape.end(), [](int64_t d) { return d > 0; });
+
+    m_binding.ClearBoundOutputs();
+    if (m_output_preallocated) {
+        m_output.resize(element_count(m_output_shape));
+        m_output_tensor = Ort::Value::CreateTensor<float>(m_memory_info, m_output.data(), m_output.size(),
+                                                          m_output_shape.data(), m_output_shape.size());
+        m_binding.BindOutput(m_output_name.c_str(), *m_output_tensor);
+    }
+    else {
+        m_output.clear();
+        m_output_tensor.reset();
+        m_binding.BindOutput(m_output_name.c_str(), m_memory_info);
+    }
+    return m_input.data();
+}
+
+std::span<const float> asst::OnnxSessions::Context::run()
+{
+    auto start_time = std::chrono::steady_clock::now();
+    m_session->Run(m_run_options, m_binding);
+    auto cost =
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+    Log.trace(__FUNCTION__, "shape:", m_input_shape, "cost", cost, "us");
+
+    if (m_output_preallocated) {
+        return m_output;
     }
-    return m_sessions.at(name);
+    auto outputs = m_binding.GetOutputValues();
+    m_output_tensor = std::move(outputs.front());
+    auto info = m_output_tensor->GetTensorTypeAndShapeInfo();
+    m_output_shape = info.GetShape();
+    return { m_output_tensor->GetTensorData<float>(), info.GetElementCount() };
 }
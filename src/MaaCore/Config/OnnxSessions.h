@@ -2,24 +2,88 @@
 
 #include "AbstractResource.h"
 
+#include <array>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
 #include <unordered_map>
+#include <vector>
 
 #include <onnxruntime/core/session/onnxruntime_cxx_api.h>
 
+#include "Utils/NoWarningCVMat.h"
+
 namespace asst
 {
     class OnnxSessions final : public SingletonHolder<OnnxSessions>, public AbstractResource
     {
+    public:
+        // 单输入单输出模型的推理上下文。
+        // 输入输出名只查一次，输入输出缓冲区和 IoBinding 在形状不变时跨调用复用，推理时不再分配内存
+        class Context
+        {
+        public:
+            using Shape = std::array<int64_t, 4>;
+
+            Context(std::string name, std::shared_ptr<Ort::Session> session);
+
+            // 返回 shape 对应大小的输入缓冲区，调用方直接往里写
+            float* input(const Shape& shape);
+            // 输出形状里有动态维度时由 ort 分配输出，返回的数据在下一次 run 之前有效
+            std::span<const float> run();
+            const std::vector<int64_t>& output_shape() const noexcept { return m_output_shape; }
+            // 模型固定了 batch 大小时返回该值，动态 batch 返回 0
+            size_t batch_limit() const noexcept;
+
+            cv::Mat image_buffer; // 调用方做预处理（如缩放）时可复用的图像缓冲区
+
+        private:
+            friend class OnnxSessions;
+
+            std::string m_name;
+            std::shared_ptr<Ort::Session> m_session;
+            std::string m_input_name;
+            std::string m_output_name;
+            std::vector<int64_t> m_model_input_shape;  // 模型里声明的，动态维度为 -1
+            std::vector<int64_t> m_model_output_shape;
+
+            Ort::MemoryInfo m_memory_info;
+            Ort::RunOptions m_run_options;
+            Ort::IoBinding m_binding;
+            Shape m_input_shape {};
+            std::vector<float> m_input;
+            std::vector<float> m_output;
+            std::vector<int64_t> m_output_shape;
+            std::optional<Ort::Value> m_input_tensor;
+            std::optional<Ort::Value> m_output_tensor;
+            bool m_output_preallocated = false;
+        };
+
+        struct ContextReleaser
+        {
+            void operator()(Context* context) const;
+        };
+        using ContextPtr = std::unique_ptr<Context, ContextReleaser>;
+
     public:
         virtual ~OnnxSessions() override = default;
         virtual bool load(const std::filesystem::path& path) override;
 
         Ort::Session& get(const std::string& name);
+        // 取一个空闲的推理上下文，没有就新建一个；析构时放回池子
+        ContextPtr acquire(const std::string& name);
 
     private:
+        std::shared_ptr<Ort::Session> get_session(const std::string& name);
+        void release(Context* context);
+
         Ort::Env m_env;
         Ort::SessionOptions m_options;
-        std::unordered_map<std::string, Ort::Session> m_sessions;
+
+        std::mutex m_mutex;
+        std::unordered_map<std::string, std::shared_ptr<Ort::Session>> m_sessions;
         std::unordered_map<std::string, std::filesystem::path> m_model_paths;
+        std::unordered_map<std::string, std::vector<std::unique_ptr<Context>>> m_idle_contexts;
     };
 }
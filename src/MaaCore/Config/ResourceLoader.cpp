@@ -1,7 +1,7 @@
 #include "ResourceLoader.h"
 
+#include <chrono>
 #include <filesystem>
-#include <future>
 
 #include "GeneralConfig.h"
 #include "Miscellaneous/AvatarCacheManager.h"
@@ -23,53 +23,11 @@
 #include "TaskData.h"
 #include "TemplResource.h"
 #include "Utils/Logger.hpp"
-
-asst::ResourceLoader::ResourceLoader()
-{
-    m_load_thread = std::thread(&ResourceLoader::load_thread_func, this);
-}
-
-void asst::ResourceLoader::load_thread_func()
-{
-    while (!m_load_thread_exit) {
-        std::unique_lock<std::mutex> lock(m_load_mutex);
-
-        if (m_load_queue.empty()) {
-            m_load_cv.wait(lock);
-            continue;
-        }
-
-        auto [res_ptr, path] = std::move(m_load_queue.front());
-        m_load_queue.pop_front();
-        lock.unlock();
-
-        res_ptr->load(path);
-    }
-}
-
-void asst::ResourceLoader::add_load_queue(AbstractResource& res, const std::filesystem::path& path)
-{
-    if (!std::filesystem::exists(path)) {
-        return;
-    }
-
-    std::unique_lock<std::mutex> lock(m_load_mutex);
-    m_load_queue.emplace_back(&res, path);
-    m_load_cv.notify_all();
-}
+#include "Utils/WorkerPool.hpp"
 
 void asst::ResourceLoader::cancel()
 {
-    m_load_thread_exit = true;
-
-    {
-        std::unique_lock<std::mutex> lock(m_load_mutex);
-        m_load_cv.notify_all();
-    }
-
-    if (m_load_thread.joinable()) {
-        m_load_thread.join();
-    }
+    m_canceled = true;
 }
 
 asst::ResourceLoader::~ResourceLoader()
@@ -79,6 +37,9 @@ asst::ResourceLoader::~ResourceLoader()
 
 bool asst::ResourceLoader::load(const std::filesystem::path& path)
 {
+    // 只在发起新的加载时清掉取消标记，等待 m_entry_mutex 期间收到的取消依然有效
+    m_canceled = false;
+
     if (!std::filesystem::exists(path)) {
         Log.error("Resource path not exists, path:", path);
         return false;
@@ -86,45 +47,35 @@ bool asst::ResourceLoader::load(const std::filesystem::path& path)
 
     std::unique_lock<std::mutex> lock(m_entry_mutex);
 
-#define LoadResourceAndCheckRet(Config, Filename)                 \
-    {                                                             \
-        auto full_path = path / Filename;                         \
-        bool ret = load_resource<Config>(full_path);              \
-        if (!ret) {                                               \
-            Log.error(#Config, " load failed, path:", full_path); \
-            return false;                                         \
-        }                                                         \
-    }
-
-#ifdef ASST_DEBUG
-// DEBUG 模式下这里同步加载，并检查返回值的，方便排查问题
-#define AsyncLoadConfig(Config, Filename) LoadResourceAndCheckRet(Config, Filename)
-#else
-#define AsyncLoadConfig(Config, Filename)                                         \
-    {                                                                             \
-        add_load_queue(SingletonHolder<Config>::get_instance(), path / Filename); \
-    }
-#endif // ASST_DEBUG
-
-#define LoadResourceWithTemplAndCheckRet(Config, Filename, TemplDir)                             \
-    {                                                                                            \
-        auto full_path = path / Filename;                                                        \
-        auto full_templ_dir = path / TemplDir;                                                   \
-        bool ret = load_resource_with_templ<Config>(full_path, full_templ_dir);                  \
-        if (!ret) {                                                                              \
-            Log.error(#Config, "load failed, path:", full_path, ", templ dir:", full_templ_dir); \
-            return false;                                                                        \
-        }                                                                                        \
-    }
-
-#define LoadCacheWithoutRet(Config, Dir)                         \
-    {                                                            \
-        auto full_path = UserDir.get() / "cache"_p / Dir;        \
-        if (!std::filesystem::exists(full_path)) {               \
-            std::filesystem::create_directories(full_path);      \
-        }                                                        \
-        SingletonHolder<Config>::get_instance().load(full_path); \
-    }
+// 同一个资源的多次加载按顺序串行，其余的并行；最后一个参数起是依赖的资源
+#define LoadResourceAndCheckRet(Config, Filename, ...)                                      \
+    add_load_job(#Config, #Config, { __VA_ARGS__ }, [this, full_path = path / Filename]() { \
+        bool ret = load_resource<Config>(full_path);                                        \
+        if (!ret) {                                                                         \
+            Log.error(#Config, " load failed, path:", full_path);                           \
+        }                                                                                   \
+        return ret;                                                                         \
+    })
+
+// 模板都加载到同一个 TemplResource 里，这一步互相之间要串行
+#define LoadResourceWithTemplAndCheckRet(Config, Filename, TemplDir)                                        \
+    LoadResourceAndCheckRet(Config, Filename);                                                              \
+    add_load_job(#Config " templ", "TemplResource", { #Config }, [this, full_templ_dir = path / TemplDir]() { \
+        bool ret = load_templ_required<Config>(full_templ_dir);                                             \
+        if (!ret) {                                                                                         \
+            Log.error(#Config, "load failed, templ dir:", full_templ_dir);                                  \
+        }                                                                                                   \
+        return ret;                                                                                         \
+    })
+
+#define LoadCacheWithoutRet(Config, Dir, ...)                                                         \
+    add_load_job(#Config, #Config, { __VA_ARGS__ }, [full_path = UserDir.get() / "cache"_p / Dir]() { \
+        if (!std::filesystem::exists(full_path)) {                                                    \
+            std::filesystem::create_directories(full_path);                                           \
+        }                                                                                             \
+        SingletonHolder<Config>::get_instance().load(full_path);                                      \
+        return true;                                                                                  \
+    })
 
     LogTraceFunction;
     using namespace asst::utils::path_literals;
@@ -149,8 +100,7 @@ bool asst::ResourceLoader::load(const std::filesystem::path& path)
     LoadResourceAndCheckRet(OcrConfig, "ocr_config.json"_p);
 
     /* load cache */
-    // 这个任务依赖 BattleDataConfig
-    LoadCacheWithoutRet(AvatarCacheManager, "avatars"_p);
+    LoadCacheWithoutRet(AvatarCacheManager, "avatars"_p, "BattleDataConfig");
 
     // 重要的资源，实时加载（图片还是惰性的）
     LoadResourceWithTemplAndCheckRet(TaskData, "tasks.json"_p, "template"_p);
@@ -161,17 +111,18 @@ bool asst::ResourceLoader::load(const std::filesystem::path& path)
     LoadResourceAndCheckRet(TilePack, "Arknights-Tile-Pos"_p / "overview.json"_p);
 
     // fix #6188 https://github.com/MaaAssistantArknights/MaaAssistantArknights/issues/6188#issuecomment-1703705568
-    // 没什么头绪，但凑合修掉了
-    // 原来这后面是用 AsyncLoadConfig 的，以下是原来的注释：
-    //// 不太重要又加载的慢的资源，但不怎么占内存的，实时异步加载
-    //// DEBUG 模式下这里还是检查返回值的，方便排查问题
+    // 原来这些是在 load 返回后继续异步加载的，会和下一次 load（如 OTA 资源）同时改同一个资源对象。
+    // 现在 load 返回前会等所有任务完成，同一资源的任务也是串行的
     LoadResourceAndCheckRet(RoguelikeCopilotConfig, "roguelike"_p / "Phantom"_p / "autopilot"_p);
     LoadResourceAndCheckRet(RoguelikeCopilotConfig, "roguelike"_p / "Mizuki"_p / "autopilot"_p);
     LoadResourceAndCheckRet(RoguelikeCopilotConfig, "roguelike"_p / "Sami"_p / "autopilot"_p);
 
-    LoadResourceAndCheckRet(RoguelikeRecruitConfig, "roguelike"_p / "Phantom"_p / "recruitment.json"_p);
-    LoadResourceAndCheckRet(RoguelikeRecruitConfig, "roguelike"_p / "Mizuki"_p / "recruitment.json"_p);
-    LoadResourceAndCheckRet(RoguelikeRecruitConfig, "roguelike"_p / "Sami"_p / "recruitment.json"_p);
+    LoadResourceAndCheckRet(RoguelikeRecruitConfig, "roguelike"_p / "Phantom"_p / "recruitment.json"_p,
+                            "BattleDataConfig");
+    LoadResourceAndCheckRet(RoguelikeRecruitConfig, "roguelike"_p / "Mizuki"_p / "recruitment.json"_p,
+                            "BattleDataConfig");
+    LoadResourceAndCheckRet(RoguelikeRecruitConfig, "roguelike"_p / "Sami"_p / "recruitment.json"_p,
+                            "BattleDataConfig");
 
     LoadResourceAndCheckRet(RoguelikeShoppingConfig, "roguelike"_p / "Phantom"_p / "shopping.json"_p);
     LoadResourceAndCheckRet(RoguelikeShoppingConfig, "roguelike"_p / "Mizuki"_p / "shopping.json"_p);
@@ -187,16 +138,127 @@ bool asst::ResourceLoader::load(const std::filesystem::path& path)
 
     LoadResourceAndCheckRet(RoguelikeFoldartalConfig, "roguelike"_p / "Sami"_p / "foldartal.json"_p);
 
-#undef LoadTemplByConfigAndCheckRet
+#undef LoadResourceWithTemplAndCheckRet
 #undef LoadResourceAndCheckRet
 #undef LoadCacheWithoutRet
 
-    m_loaded = true;
+    m_loaded = run_load_jobs();
 
     Log.info(__FUNCTION__, "ret", m_loaded);
     return m_loaded;
 }
 
+void asst::ResourceLoader::add_load_job(std::string name, const std::string& key,
+                                        const std::vector<std::string>& depends, LoadFunc func)
+{
+    const size_t index = m_jobs.size();
+    LoadJob& job = m_jobs.emplace_back();
+    job.name = std::move(name);
+    job.func = std::move(func);
+
+    auto add_dependency = [&](const std::string& dep_key) {
+        auto iter = m_jobs_by_key.find(dep_key);
+        if (iter == m_jobs_by_key.end()) {
+            return;
+        }
+        for (size_t dep : iter->second) {
+            m_jobs[dep].dependents.emplace_back(index);
+            ++m_jobs[index].pending_deps;
+        }
+    };
+    // 同一个 key 的任务串成一条链，依赖上一个就够了
+    if (auto iter = m_jobs_by_key.find(key); iter != m_jobs_by_key.end() && !iter->second.empty()) {
+        m_jobs[iter->second.back()].dependents.emplace_back(index);
+        ++m_jobs[index].pending_deps;
+    }
+    for (const std::string& dep_key : depends) {
+        add_dependency(dep_key);
+    }
+    m_jobs_by_key[key].emplace_back(index);
+}
+
+bool asst::ResourceLoader::run_load_jobs()
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<size_t> ready;
+    {
+        std::unique_lock<std::mutex> lock(m_jobs_mutex);
+        m_jobs_failed = false;
+        m_unfinished_jobs = m_jobs.size();
+        for (size_t i = 0; i < m_jobs.size(); ++i) {
+            if (m_jobs[i].pending_deps == 0) {
+                ready.emplace_back(i);
+            }
+        }
+    }
+    for (size_t index : ready) {
+        submit_load_job(index);
+    }
+
+    bool ret = false;
+    {
+        std::unique_lock<std::mutex> lock(m_jobs_mutex);
+        m_jobs_cv.wait(lock, [&]() { return m_unfinished_jobs == 0; });
+        ret = !m_jobs_failed && !m_canceled;
+    }
+
+    const auto cost = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    Log.info(__FUNCTION__, "jobs:", m_jobs.size(), "cost:", cost.count(), "ms");
+
+    m_jobs.clear();
+    m_jobs_by_key.clear();
+    return ret;
+}
+
+void asst::ResourceLoader::submit_load_job(size_t index)
+{
+    std::ignore = WorkerPool::get_instance().submit([this, index]() {
+        LoadJob& job = m_jobs[index];
+
+        bool skip = false;
+        {
+            std::unique_lock<std::mutex> lock(m_jobs_mutex);
+            skip = m_jobs_failed || m_canceled;
+        }
+
+        bool ret = true;
+        if (!skip) {
+            const auto start = std::chrono::steady_clock::now();
+            try {
+                ret = job.func();
+            }
+            catch (const std::exception& e) {
+                Log.error("load", job.name, "exception:", e.what());
+                ret = false;
+            }
+            const auto cost =
+                std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+            Log.info("load", job.name, "ret:", ret, "cost:", cost.count(), "ms");
+        }
+
+        std::vector<size_t> ready;
+        {
+            std::unique_lock<std::mutex> lock(m_jobs_mutex);
+            if (!ret) {
+                m_jobs_failed = true;
+            }
+            // 跳过的任务也照常推进依赖它的任务，它们会因为 m_jobs_failed 一并跳过
+            for (size_t dependent : job.dependents) {
+                if (--m_jobs[dependent].pending_deps == 0) {
+                    ready.emplace_back(dependent);
+                }
+            }
+            if (--m_unfinished_jobs == 0) {
+                m_jobs_cv.notify_all();
+            }
+        }
+        for (size_t dependent : ready) {
+            submit_load_job(dependent);
+        }
+    });
+}
+
 bool asst::ResourceLoader::loaded() const noexcept
 {
     return m_loaded;
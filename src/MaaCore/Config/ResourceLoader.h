@@ -2,9 +2,15 @@
 
 #include "AbstractResource.h"
 
-#include <deque>
+#include <atomic>
+#include <condition_variable>
 #include <filesystem>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "AbstractConfigWithTempl.h"
 #include "TemplResource.h"
@@ -21,12 +27,29 @@ namespace asst
         bool loaded() const noexcept;
 
     public:
-        ResourceLoader();
+        ResourceLoader() = default;
 
+        // 取消还没开始的加载任务，正在加载的会继续跑完。所有实例共用，只在析构时使用
         void cancel();
 
     private:
-        void load_thread_func();
+        using LoadFunc = std::function<bool()>;
+
+        struct LoadJob
+        {
+            std::string name;
+            LoadFunc func;
+            std::vector<size_t> dependents; // 等待本任务完成的任务
+            size_t pending_deps = 0;
+        };
+
+        // 添加一个加载任务。key 相同的任务（同一个资源对象）按添加顺序串行；
+        // 还会等 depends 里的资源此前添加的任务全部完成后才开始
+        void add_load_job(std::string name, const std::string& key, const std::vector<std::string>& depends,
+                          LoadFunc func);
+        // 在线程池上并行执行所有任务，任一失败则不再启动新的任务，等已经开始的结束后返回
+        bool run_load_jobs();
+        void submit_load_job(size_t index);
 
         template <Singleton T>
         requires std::is_base_of_v<AbstractResource, T>
@@ -40,11 +63,8 @@ namespace asst
 
         template <Singleton T>
         requires std::is_base_of_v<AbstractConfigWithTempl, T>
-        bool load_resource_with_templ(const std::filesystem::path& path, const std::filesystem::path& templ_dir)
+        bool load_templ_required(const std::filesystem::path& templ_dir)
         {
-            if (!load_resource<T>(path)) {
-                return false;
-            }
             static auto& templ_ins = SingletonHolder<TemplResource>::get_instance();
             const auto& required = SingletonHolder<T>::get_instance().get_templ_required();
             templ_ins.set_load_required(required);
@@ -52,17 +72,17 @@ namespace asst
             return load_resource<TemplResource>(templ_dir);
         }
 
-        void add_load_queue(AbstractResource& res, const std::filesystem::path& path);
-
     private:
         bool m_loaded = false;
         std::mutex m_entry_mutex;
+        std::atomic<bool> m_canceled = false;
 
-        // only for async load
-        bool m_load_thread_exit = false;
-        std::deque<std::pair<AbstractResource*, std::filesystem::path>> m_load_queue;
-        std::mutex m_load_mutex;
-        std::condition_variable m_load_cv;
-        std::thread m_load_thread;
+        // 以下仅在 load 期间使用
+        std::vector<LoadJob> m_jobs;
+        std::unordered_map<std::string, std::vector<size_t>> m_jobs_by_key;
+        std::mutex m_jobs_mutex;
+        std::condition_variable m_jobs_cv;
+        size_t m_unfinished_jobs = 0;
+        bool m_jobs_failed = false;
     };
 } // namespace asst
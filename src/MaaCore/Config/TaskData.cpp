@@ -2,16 +2,15 @@
 
 #include <algorithm>
 #include <meojson/json.hpp>
-
-#ifdef ASST_DEBUG
 #include <queue>
-#endif
 
 #include "Common/AsstTypes.h"
 #include "GeneralConfig.h"
 #include "TaskData/TaskDataSymbolStream.h"
 #include "TaskData/TaskDataTypes.h"
 #include "TemplResource.h"
+#include "Utils/File.hpp"
+#include "Utils/FileCache.hpp"
 #include "Utils/JsonMisc.hpp"
 #include "Utils/Logger.hpp"
 #include "Utils/Ranges.hpp"
@@ -44,11 +43,25 @@ asst::TaskPtr asst::TaskData::get(std::string_view name)
 {
     // 普通任务 或 已经生成过的高级任务
     if (auto it = m_all_tasks_info.find(name); it != m_all_tasks_info.cend()) {
+        add_task_deps(name);
         return it->second;
     }
+    if (m_missing_tasks.contains(name)) {
+        add_task_deps(name);
+        return nullptr;
+    }
+
+    if (m_snapshot && !m_stale_tasks.contains(name)) {
+        if (auto task = m_snapshot->find(name)) {
+            add_task_deps(name);
+            return insert_or_assign_task(name, task).first->second;
+        }
+        // 运行期拼出来的、快照里没有的任务，按需读入用到的那几个任务的 json 来生成
+    }
 
     auto task = generate_task_info(name);
     if (!task) [[unlikely]] {
+        m_missing_tasks.emplace(task_name_view(name));
         return nullptr;
     }
 
@@ -73,8 +86,19 @@ bool asst::TaskData::lazy_parse(const json::value& json)
         return false;
     }
 
+    // 快照模式下只读入涉及到的任务原来的 json，改完之后只让依赖它们的任务失效
+    const bool selective = m_snapshot.has_value();
+    std::vector<std::string_view> changed_names;
+
     for (const auto& [name, task_json] : json.as_object()) {
         std::string_view name_view = task_name_view(name);
+        if (selective) {
+            if (!m_json_all_tasks_info.contains(name_view)) {
+                load_source(name_view);
+            }
+            m_modified_json.emplace(name_view);
+            changed_names.emplace_back(name_view);
+        }
         if (task_json.contains("baseTask")) {
             // 直接声明 baseTask 的任务不继承同名任务参数而是直接覆盖
             m_json_all_tasks_info[name_view] = task_json.as_object();
@@ -98,6 +122,13 @@ bool asst::TaskData::lazy_parse(const json::value& json)
         }
     }
 
+    if (selective) {
+        for (std::string_view name : changed_names) {
+            invalidate(name);
+        }
+        return true;
+    }
+
     clear_tasks();
 
 #ifdef ASST_DEBUG
@@ -201,12 +232,128 @@ bool asst::TaskData::parse(const json::value& json)
     return true;
 }
 
+bool asst::TaskData::load(const std::filesystem::path& path)
+{
+#ifdef ASST_DEBUG
+    // Debug 下每次都解析 json，顺便做语法检查
+    return AbstractConfig::load(path);
+#else
+    if (!std::filesystem::is_regular_file(path)) {
+        return AbstractConfig::load(path);
+    }
+
+    const uint64_t input_hash = TaskDataSnapshot::hash_input(m_input_hash, utils::read_file<std::string>(path));
+    const auto snapshot_file = utils::file_cache::path("tasks", input_hash);
+    if (auto snapshot = TaskDataSnapshot::open(snapshot_file, input_hash)) {
+        Log.info("TaskData load snapshot", snapshot_file, "tasks:", snapshot->size());
+        m_path = path;
+        m_input_hash = input_hash;
+        m_input_paths.emplace_back(path);
+        m_templ_required = snapshot->templ_required();
+        m_snapshot = std::move(snapshot);
+        // 快照里已经包含了之前所有输入的结果
+        m_json_all_tasks_info.clear();
+        m_modified_json.clear();
+        m_stale_tasks.clear();
+        clear_tasks();
+        utils::file_cache::touch(snapshot_file);
+        return true;
+    }
+
+    materialize_json();
+    if (!AbstractConfig::load(path)) {
+        return false;
+    }
+    m_input_hash = input_hash;
+    m_input_paths.emplace_back(path);
+    save_snapshot(snapshot_file, input_hash);
+    return true;
+#endif
+}
+
+void asst::TaskData::save_snapshot(const std::filesystem::path& path, uint64_t input_hash)
+{
+    LogTraceFunction;
+
+    // 沿着各个任务列表把能走到的任务（包括 A@B 这种隐式生成的）都展开，启动后的 get 基本都能命中快照
+    std::queue<std::string_view> task_queue;
+    std::unordered_set<std::string_view> visited;
+    for (std::string_view name : m_json_all_tasks_info | views::keys) {
+        task_queue.push(name);
+        visited.emplace(name);
+    }
+    constexpr size_t MaxSnapshotTasks = 10000;
+    while (!task_queue.empty() && visited.size() <= MaxSnapshotTasks) {
+        auto task = get(task_queue.front());
+        task_queue.pop();
+        if (!task) [[unlikely]] {
+            continue;
+        }
+        for (const TaskList* list :
+             { &task->next, &task->sub, &task->exceeded_next, &task->on_error_next, &task->reduce_other_times }) {
+            for (const std::string& name : *list) {
+                if (std::string_view name_view = task_name_view(name); visited.emplace(name_view).second) {
+                    task_queue.push(name_view);
+                }
+            }
+        }
+    }
+    if (visited.size() > MaxSnapshotTasks) {
+        Log.warn("Generating exceeded limit when saving snapshot.");
+    }
+
+    // 每个任务自己的 json 也存下来，运行期修改任务时只需解析用到的那几个
+    std::unordered_map<std::string_view, std::string> sources;
+    sources.reserve(m_json_all_tasks_info.size());
+    for (const auto& [name, task_json] : m_json_all_tasks_info) {
+        sources.emplace(name, task_json.to_string());
+    }
+    if (!TaskDataSnapshot::save(path, input_hash, m_all_tasks_info, m_task_deps, sources, m_templ_required)) {
+        return;
+    }
+
+    if (size_t removed = utils::file_cache::remove_expired(path)) {
+        Log.info("removed expired snapshots:", removed);
+    }
+}
+
+void asst::TaskData::materialize_json()
+{
+    if (!m_snapshot) {
+        return;
+    }
+    LogTraceFunction;
+
+    m_snapshot.reset();
+    // 运行期修改过的 json 要保留，和一直在 json 模式下的结果一样
+    std::vector<std::pair<std::string_view, json::object>> modified;
+    for (std::string_view name : m_modified_json) {
+        if (auto it = m_json_all_tasks_info.find(name); it != m_json_all_tasks_info.end()) {
+            modified.emplace_back(name, std::move(it->second));
+        }
+    }
+    m_modified_json.clear();
+    m_stale_tasks.clear();
+    m_json_all_tasks_info.clear();
+    for (const auto& path : m_input_paths) {
+        AbstractConfig::load(path);
+    }
+    for (auto& [name, task_json] : modified) {
+        m_json_all_tasks_info[name] = std::move(task_json);
+    }
+    clear_tasks();
+}
+
 void asst::TaskData::clear_tasks()
 {
     // 注意：这会导致已经通过 get 获取的任务指针内容不会更新
     // 即运行期修改对已经获取的任务指针无效，但是不会导致崩溃；要想更新，需要重新获取任务指针
     m_all_tasks_info.clear();
     m_raw_all_tasks_info.clear();
+    m_raw_deps.clear();
+    m_task_deps.clear();
+    m_missing_tasks.clear();
+    m_task_status.clear();
     for (std::string_view name : m_json_all_tasks_info | views::keys) {
         m_task_status[task_name_view(name)] = ToBeGenerate;
     }
@@ -214,8 +361,132 @@ void asst::TaskData::clear_tasks()
 
 void asst::TaskData::set_task_base(const std::string_view task_name, std::string base_task_name)
 {
-    m_json_all_tasks_info[task_name_view(task_name)]["baseTask"] = std::move(base_task_name);
-    clear_tasks();
+    std::string_view name = task_name_view(task_name);
+    if (!m_json_all_tasks_info.contains(name)) {
+        load_source(name);
+    }
+    auto& task_json = m_json_all_tasks_info[name];
+    if (task_json.contains("baseTask") && task_json.get("baseTask", std::string()) == base_task_name) {
+        // 每次开始肉鸽都会重设一遍，大多数时候并没有变
+        return;
+    }
+    task_json["baseTask"] = std::move(base_task_name);
+    if (m_snapshot) {
+        m_modified_json.emplace(name);
+    }
+    invalidate(name);
+}
+
+asst::TaskData::DepsScope::DepsScope(TaskData& data, std::unordered_map<std::string_view, TaskDeps>& store,
+                                     std::string_view name)
+    : m_data(data), m_store(store), m_name(task_name_view(name))
+{
+    m_data.m_deps_stack.emplace_back();
+}
+
+asst::TaskData::DepsScope::~DepsScope()
+{
+    TaskDeps deps = std::move(m_data.m_deps_stack.back());
+    m_data.m_deps_stack.pop_back();
+    deps.emplace(m_name);
+    m_data.add_deps(deps);
+    m_store.insert_or_assign(m_name, std::move(deps));
+}
+
+void asst::TaskData::add_dep(std::string_view name)
+{
+    if (!m_deps_stack.empty()) {
+        m_deps_stack.back().emplace(task_name_view(name));
+    }
+}
+
+void asst::TaskData::add_deps(const TaskDeps& deps)
+{
+    if (!m_deps_stack.empty()) {
+        m_deps_stack.back().insert(deps.begin(), deps.end());
+    }
+}
+
+void asst::TaskData::add_task_deps(std::string_view name)
+{
+    if (m_deps_stack.empty()) {
+        return;
+    }
+    if (auto it = m_task_deps.find(name); it != m_task_deps.end()) {
+        add_deps(it->second);
+    }
+    else if (m_snapshot) {
+        for (std::string_view dep : m_snapshot->deps(name)) {
+            add_dep(dep);
+        }
+    }
+    add_dep(name);
+}
+
+asst::TaskData::TaskStatus asst::TaskData::task_status(std::string_view name)
+{
+    if (auto it = m_task_status.find(name); it != m_task_status.end()) {
+        return it->second;
+    }
+    // 快照模式下任务的 json 在这里按需读入；失效过的任务也在这里重新判断
+    const TaskStatus status =
+        m_json_all_tasks_info.contains(name) || load_source(name) ? ToBeGenerate : NotToBeGenerate;
+    m_task_status.emplace(task_name_view(name), status);
+    return status;
+}
+
+bool asst::TaskData::load_source(std::string_view name)
+{
+    if (!m_snapshot) {
+        return false;
+    }
+    auto text = m_snapshot->source(name);
+    if (!text) {
+        return false;
+    }
+    auto task_json = json::parse(*text);
+    if (!task_json || !task_json->is_object()) [[unlikely]] {
+        Log.error("Task", name, "has invalid json in snapshot");
+        return false;
+    }
+    m_json_all_tasks_info.insert_or_assign(task_name_view(name), std::move(task_json->as_object()));
+    return true;
+}
+
+void asst::TaskData::invalidate(std::string_view name)
+{
+    std::vector<std::string_view> tasks;
+    for (const auto& [task_name, deps] : m_task_deps) {
+        if (deps.contains(name)) {
+            tasks.emplace_back(task_name);
+        }
+    }
+    if (m_snapshot) {
+        for (std::string_view task_name : m_snapshot->dependents(name)) {
+            std::string_view task_name_interned = task_name_view(task_name);
+            m_stale_tasks.emplace(task_name_interned);
+            tasks.emplace_back(task_name_interned);
+        }
+    }
+    for (std::string_view task_name : tasks) {
+        m_all_tasks_info.erase(task_name);
+        m_task_deps.erase(task_name);
+    }
+
+    std::vector<std::string_view> raw_tasks;
+    for (const auto& [raw_name, deps] : m_raw_deps) {
+        if (deps.contains(name)) {
+            raw_tasks.emplace_back(raw_name);
+        }
+    }
+    for (std::string_view raw_name : raw_tasks) {
+        m_raw_all_tasks_info.erase(raw_name);
+        m_raw_deps.erase(raw_name);
+        m_task_status.erase(raw_name);
+    }
+    m_task_status.erase(name);
+    // 之前不存在的任务现在可能存在了
+    m_missing_tasks.clear();
 }
 
 bool asst::TaskData::generate_raw_task_info(std::string_view name, std::string_view prefix, std::string_view base,
@@ -252,10 +523,15 @@ bool asst::TaskData::generate_raw_task_info(std::string_view name, std::string_v
 // allow_implicit: 允许隐式生成（解决 A@B@LoadingText 时 B 不存在的问题）
 bool asst::TaskData::generate_raw_task_and_base(std::string_view name, bool must_true, bool allow_implicit)
 {
-    switch (m_task_status[task_name_view(name)]) {
+    // 记下生成过程中查过的任务名（包括不存在的），运行期修改任务时据此让结果失效
+    add_dep(name);
+    switch (task_status(name)) {
     case NotToBeGenerate:
         // 已经显式生成
         if (m_raw_all_tasks_info.contains(name)) {
+            if (auto it = m_raw_deps.find(name); it != m_raw_deps.end()) {
+                add_deps(it->second);
+            }
             return true;
         }
 
@@ -264,17 +540,23 @@ bool asst::TaskData::generate_raw_task_and_base(std::string_view name, bool must
         }
 
         // 隐式生成的资源
-        for (size_t p = name.find('@'); p != std::string::npos; p = name.find('@', p + 1)) {
-            if (generate_raw_task_and_base(name.substr(p + 1), false, false)) {
-                // 隐式 TemplateTask
-                generate_raw_task_info(name, name.substr(0, p), name.substr(p + 1), {}, TaskDerivedType::Implicit);
-                return true;
+        {
+            DepsScope scope(*this, m_raw_deps, name);
+            for (size_t p = name.find('@'); p != std::string::npos; p = name.find('@', p + 1)) {
+                if (generate_raw_task_and_base(name.substr(p + 1), false, false)) {
+                    // 隐式 TemplateTask
+                    generate_raw_task_info(name, name.substr(0, p), name.substr(p + 1), {}, TaskDerivedType::Implicit);
+                    return true;
+                }
             }
         }
-        m_task_status[name] = NotExists;
+        m_task_status[task_name_view(name)] = NotExists;
 
         [[fallthrough]];
     case NotExists:
+        if (auto it = m_raw_deps.find(name); it != m_raw_deps.end()) {
+            add_deps(it->second);
+        }
         if (must_true) {
             Log.error("Unknown task:", name);
         }
@@ -288,6 +570,7 @@ bool asst::TaskData::generate_raw_task_and_base(std::string_view name, bool must
         }
 
         m_task_status[name] = Generating;
+        DepsScope scope(*this, m_raw_deps, name);
 
         const json::value& task_json = m_json_all_tasks_info.at(name);
 
@@ -318,6 +601,7 @@ bool asst::TaskData::generate_raw_task_and_base(std::string_view name, bool must
 
 asst::TaskPtr asst::TaskData::generate_task_info(std::string_view name)
 {
+    DepsScope scope(*this, m_task_deps, name);
     auto raw = get_raw(name);
     if (!raw) [[unlikely]] {
         Log.error("Task", name, "not found");
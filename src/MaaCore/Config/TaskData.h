@@ -2,10 +2,12 @@
 
 #include "AbstractConfigWithTempl.h"
 
+#include <optional>
 #include <unordered_map>
 #include <unordered_set>
 
 #include "Common/AsstTypes.h"
+#include "TaskData/TaskDataSnapshot.h"
 #include "TaskData/TaskDataSymbol.h"
 
 namespace asst
@@ -80,8 +82,13 @@ namespace asst
 #endif
         TaskDerivedConstPtr get_raw(std::string_view name);
 
+        void save_snapshot(const std::filesystem::path& path, uint64_t input_hash);
+        // 快照模式下，按顺序重新解析已加载过的 json，之后就和没有快照时一样了。只在加载新的 json 时使用
+        void materialize_json();
+
     public:
         virtual ~TaskData() override = default;
+        virtual bool load(const std::filesystem::path& path) override;
         virtual const std::unordered_set<std::string>& get_templ_required() const noexcept override;
         void clear_tasks();
         void set_task_base(const std::string_view task_name, std::string base_task_name);
@@ -119,6 +126,49 @@ namespace asst
         std::unordered_map<std::string_view, json::object> m_json_all_tasks_info;  // 原始的 json 信息
         std::unordered_map<std::string_view, TaskDerivedPtr> m_raw_all_tasks_info; // 未展开虚任务的任务信息
         std::unordered_map<std::string_view, TaskPtr> m_all_tasks_info;            // 已展开虚任务的任务信息
+
+        // 命中快照时不解析 json，任务在第一次 get 时才从快照里还原
+        std::optional<TaskDataSnapshot> m_snapshot;
+        uint64_t m_input_hash = 0;                        // 已加载的所有 tasks.json 的累计哈希
+        std::vector<std::filesystem::path> m_input_paths; // 已加载的 tasks.json，回退到 json 时要按顺序重新解析
+
+    private:
+        using TaskDeps = TaskDataSnapshot::TaskDeps;
+
+        // 生成任务期间收集它读到过的任务名（base、模板、虚任务引用的，以及探测过但不存在的），
+        // 析构时存到 store[name]，并合并到外层正在生成的任务上。运行期修改某个任务时，只让依赖它的任务失效
+        class DepsScope
+        {
+        public:
+            DepsScope(TaskData& data, std::unordered_map<std::string_view, TaskDeps>& store, std::string_view name);
+            ~DepsScope();
+            DepsScope(const DepsScope&) = delete;
+            DepsScope& operator=(const DepsScope&) = delete;
+
+        private:
+            TaskData& m_data;
+            std::unordered_map<std::string_view, TaskDeps>& m_store;
+            std::string_view m_name;
+        };
+
+        void add_dep(std::string_view name);
+        void add_deps(const TaskDeps& deps);
+        // 已经生成过的任务被再次用到时，把它的依赖并入正在生成的任务
+        void add_task_deps(std::string_view name);
+        TaskStatus task_status(std::string_view name);
+        // 快照模式下按需把单个任务的 json 读进来，json 里没有这个任务时返回 false
+        bool load_source(std::string_view name);
+        // name 的 json 变了，丢掉所有依赖它的任务，下次 get 时重新生成
+        void invalidate(std::string_view name);
+
+        std::unordered_map<std::string_view, TaskDeps> m_raw_deps;  // 生成未展开虚任务的任务时读到过的任务名
+        std::unordered_map<std::string_view, TaskDeps> m_task_deps; // 生成已展开虚任务的任务时读到过的任务名
+        std::vector<TaskDeps> m_deps_stack;                         // 正在生成的各个任务的依赖
+        std::unordered_set<std::string_view> m_missing_tasks;       // 生成失败的任务，避免反复生成、反复报错
+
+        // 以下仅在快照模式下使用
+        std::unordered_set<std::string_view> m_stale_tasks;   // 快照里的记录已经过时，要重新生成的任务
+        std::unordered_set<std::string_view> m_modified_json; // 运行期修改过 json 的任务，回退到 json 时要保留
     };
 
     inline static auto& Task = TaskData::get_instance();
@@ -0,0 +1,477 @@
+#include "TaskDataSnapshot.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fstream>
+
+#include "Common/AsstVersion.h"
+#include "Utils/File.hpp"
+#include "Utils/FileCache.hpp"
+#include "Utils/Logger.hpp"
+
+namespace
+{
+    constexpr uint64_t align8(uint64_t offset) noexcept
+    {
+        return (offset + 7) & ~uint64_t(7);
+    }
+}
+
+uint64_t asst::TaskDataSnapshot::hash_input(uint64_t seed, std::string_view content) noexcept
+{
+    // 格式版本、程序版本和记录大小也算进去，任何一个变了都要重新生成
+    const uint32_t layout[] = { FormatVersion, static_cast<uint32_t>(sizeof(TaskRecord)),
+                                static_cast<uint32_t>(sizeof(Header)) };
+    uint64_t hash = utils::fnv1a(seed, layout);
+    hash = utils::fnv1a(hash, std::string_view(asst::Version));
+    return utils::fnv1a(hash, content);
+}
+
+std::optional<asst::TaskDataSnapshot> asst::TaskDataSnapshot::open(const std::filesystem::path& path,
+                                                                  uint64_t input_hash)
+{
+    static_assert(sizeof(TaskRecord) == 44 * sizeof(uint32_t));
+    static_assert(sizeof(SourceRecord) == 2 * sizeof(uint32_t));
+    static_assert(sizeof(Header) == 112);
+    static_assert(std::is_trivially_copyable_v<TaskRecord> && std::is_trivially_copyable_v<SourceRecord> &&
+                  std::is_trivially_copyable_v<Header>);
+
+    if (!std::filesystem::exists(path)) {
+        return std::nullopt;
+    }
+    TaskDataSnapshot snapshot;
+    snapshot.m_data = std::make_shared<const std::vector<char>>(utils::read_file<std::vector<char>>(path));
+    if (!snapshot.validate(input_hash)) {
+        Log.warn(__FUNCTION__, "invalid snapshot", path);
+        return std::nullopt;
+    }
+    return snapshot;
+}
+
+bool asst::TaskDataSnapshot::validate(uint64_t input_hash) const
+{
+    const auto& data = *m_data;
+    if (data.size() < sizeof(Header)) {
+        return false;
+    }
+    const Header& h = header();
+    if (std::memcmp(h.magic, Magic, sizeof(Magic)) != 0 || h.version != FormatVersion || h.endian_tag != EndianTag ||
+        h.input_hash != input_hash || h.file_size != data.size()) {
+        return false;
+    }
+
+    auto section_valid = [&](uint64_t offset, uint64_t count, uint64_t elem_size) {
+        return offset % 8 == 0 && offset <= data.size() && count <= (data.size() - offset) / elem_size;
+    };
+    if (!section_valid(h.strings_offset, h.string_count, sizeof(Span)) ||
+        !section_valid(h.u32_offset, h.u32_count, sizeof(uint32_t)) ||
+        !section_valid(h.f64_offset, h.f64_count, sizeof(double)) ||
+        !section_valid(h.tasks_offset, h.task_count, sizeof(TaskRecord)) ||
+        !section_valid(h.sources_offset, h.source_count, sizeof(SourceRecord)) || h.chars_offset > data.size()) {
+        return false;
+    }
+
+    const uint64_t chars_size = data.size() - h.chars_offset;
+    const auto* strings = reinterpret_cast<const Span*>(data.data() + h.strings_offset);
+    for (uint32_t i = 0; i < h.string_count; ++i) {
+        if (strings[i].begin > chars_size || strings[i].count > chars_size - strings[i].begin) {
+            return false;
+        }
+    }
+
+    const auto* u32s = reinterpret_cast<const uint32_t*>(data.data() + h.u32_offset);
+    auto ids_valid = [&](const Span& span) {
+        return span_valid(span, h.u32_count) &&
+               std::all_of(u32s + span.begin, u32s + span.begin + span.count,
+                           [&](uint32_t id) { return id < h.string_count; });
+    };
+    if (!ids_valid(h.templ_required)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < h.task_count; ++i) {
+        const TaskRecord& r = records()[i];
+        if (r.name >= h.string_count || r.kind > Kind::Hash || !ids_valid(r.next) || !ids_valid(r.sub) ||
+            !ids_valid(r.on_error_next) || !ids_valid(r.exceeded_next) || !ids_valid(r.reduce_other_times) ||
+            !span_valid(r.special_params, h.u32_count) || !ids_valid(r.names) || !ids_valid(r.replace_map) ||
+            r.replace_map.count % 2 != 0 || !span_valid(r.thresholds, h.f64_count) || !ids_valid(r.deps)) {
+            return false;
+        }
+        // 必须按名字严格递增，find 才能二分
+        if (i > 0 && string_at(records()[i - 1].name) >= string_at(r.name)) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < h.source_count; ++i) {
+        const SourceRecord& s = sources()[i];
+        if (s.name >= h.string_count || s.json >= h.string_count) {
+            return false;
+        }
+        if (i > 0 && string_at(sources()[i - 1].name) >= string_at(s.name)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool asst::TaskDataSnapshot::span_valid(const Span& span, uint32_t limit) const noexcept
+{
+    return span.begin <= limit && span.count <= limit - span.begin;
+}
+
+const asst::TaskDataSnapshot::Header& asst::TaskDataSnapshot::header() const noexcept
+{
+    return *reinterpret_cast<const Header*>(m_data->data());
+}
+
+const asst::TaskDataSnapshot::TaskRecord* asst::TaskDataSnapshot::records() const noexcept
+{
+    return reinterpret_cast<const TaskRecord*>(m_data->data() + header().tasks_offset);
+}
+
+const asst::TaskDataSnapshot::TaskRecord* asst::TaskDataSnapshot::find_record(std::string_view name) const
+{
+    if (!m_data) {
+        return nullptr;
+    }
+    const TaskRecord* begin = records();
+    const TaskRecord* end = begin + header().task_count;
+    const TaskRecord* iter = std::lower_bound(
+        begin, end, name, [&](const TaskRecord& r, std::string_view key) { return string_at(r.name) < key; });
+    return iter == end || string_at(iter->name) != name ? nullptr : iter;
+}
+
+const asst::TaskDataSnapshot::SourceRecord* asst::TaskDataSnapshot::sources() const noexcept
+{
+    return reinterpret_cast<const SourceRecord*>(m_data->data() + header().sources_offset);
+}
+
+std::string_view asst::TaskDataSnapshot::string_at(uint32_t id) const
+{
+    const Header& h = header();
+    const Span& span = reinterpret_cast<const Span*>(m_data->data() + h.strings_offset)[id];
+    return { m_data->data() + h.chars_offset + span.begin, span.count };
+}
+
+std::vector<std::string> asst::TaskDataSnapshot::strings_in(const Span& span) const
+{
+    const auto* u32s = reinterpret_cast<const uint32_t*>(m_data->data() + header().u32_offset);
+    std::vector<std::string> result;
+    result.reserve(span.count);
+    for (uint32_t i = 0; i < span.count; ++i) {
+        result.emplace_back(string_at(u32s[span.begin + i]));
+    }
+    return result;
+}
+
+size_t asst::TaskDataSnapshot::size() const noexcept
+{
+    return m_data ? header().task_count : 0;
+}
+
+std::unordered_set<std::string> asst::TaskDataSnapshot::templ_required() const
+{
+    auto names = strings_in(header().templ_required);
+    return { std::make_move_iterator(names.begin()), std::make_move_iterator(names.end()) };
+}
+
+std::optional<std::string_view> asst::TaskDataSnapshot::source(std::string_view name) const
+{
+    if (!m_data) {
+        return std::nullopt;
+    }
+    const SourceRecord* begin = sources();
+    const SourceRecord* end = begin + header().source_count;
+    const SourceRecord* iter = std::lower_bound(
+        begin, end, name, [&](const SourceRecord& s, std::string_view key) { return string_at(s.name) < key; });
+    if (iter == end || string_at(iter->name) != name) {
+        return std::nullopt;
+    }
+    return string_at(iter->json);
+}
+
+std::vector<std::string_view> asst::TaskDataSnapshot::deps(std::string_view name) const
+{
+    const TaskRecord* record = find_record(name);
+    if (!record) {
+        return {};
+    }
+    const auto* u32s = reinterpret_cast<const uint32_t*>(m_data->data() + header().u32_offset);
+    std::vector<std::string_view> result;
+    result.reserve(record->deps.count);
+    for (uint32_t i = 0; i < record->deps.count; ++i) {
+        result.emplace_back(string_at(u32s[record->deps.begin + i]));
+    }
+    return result;
+}
+
+std::vector<std::string_view> asst::TaskDataSnapshot::dependents(std::string_view name) const
+{
+    if (!m_data) {
+        return {};
+    }
+    const Header& h = header();
+    // 字符串是去重过的，先找到 name 的 id，之后只需比较整数。name 可能只是被探测过、并不是任务，所以直接扫字符串表
+    uint32_t id = 0;
+    while (id < h.string_count && string_at(id) != name) {
+        ++id;
+    }
+    if (id == h.string_count) {
+        return {};
+    }
+
+    const auto* u32s = reinterpret_cast<const uint32_t*>(m_data->data() + h.u32_offset);
+    std::vector<std::string_view> result;
+    for (uint32_t i = 0; i < h.task_count; ++i) {
+        const TaskRecord& r = records()[i];
+        const uint32_t* deps_begin = u32s + r.deps.begin;
+        const uint32_t* deps_end = deps_begin + r.deps.count;
+        if (std::find(deps_begin, deps_end, id) != deps_end) {
+            result.emplace_back(string_at(r.name));
+        }
+    }
+    return result;
+}
+
+asst::TaskPtr asst::TaskDataSnapshot::find(std::string_view name) const
+{
+    const TaskRecord* record = find_record(name);
+    if (!record) {
+        return nullptr;
+    }
+    const TaskRecord& r = *record;
+    const auto* u32s = reinterpret_cast<const uint32_t*>(m_data->data() + header().u32_offset);
+    const auto* f64s = reinterpret_cast<const double*>(m_data->data() + header().f64_offset);
+
+    TaskPtr task;
+    switch (r.kind) {
+    case Kind::Match: {
+        auto match = std::make_shared<MatchTaskInfo>();
+        match->templ_names = strings_in(r.names);
+        match->templ_thresholds.assign(f64s + r.thresholds.begin, f64s + r.thresholds.begin + r.thresholds.count);
+        match->mask_range = { r.mask_range[0], r.mask_range[1] };
+        task = std::move(match);
+    } break;
+    case Kind::Ocr: {
+        auto ocr = std::make_shared<OcrTaskInfo>();
+        ocr->text = strings_in(r.names);
+        ocr->full_match = r.flags & FullMatch;
+        ocr->is_ascii = r.flags & IsAscii;
+        ocr->without_det = r.flags & WithoutDet;
+        ocr->replace_full = r.flags & ReplaceFull;
+        auto replace = strings_in(r.replace_map);
+        for (size_t i = 0; i + 1 < replace.size(); i += 2) {
+            ocr->replace_map.emplace_back(std::move(replace[i]), std::move(replace[i + 1]));
+        }
+        task = std::move(ocr);
+    } break;
+    case Kind::Hash: {
+        auto hash = std::make_shared<HashTaskInfo>();
+        hash->hashes = strings_in(r.names);
+        hash->dist_threshold = r.dist_threshold;
+        hash->mask_range = { r.mask_range[0], r.mask_range[1] };
+        hash->bound = r.flags & Bound;
+        task = std::move(hash);
+    } break;
+    default:
+        task = std::make_shared<TaskInfo>();
+        break;
+    }
+
+    task->name = name;
+    task->next = strings_in(r.next);
+    task->sub = strings_in(r.sub);
+    task->on_error_next = strings_in(r.on_error_next);
+    task->exceeded_next = strings_in(r.exceeded_next);
+    task->reduce_other_times = strings_in(r.reduce_other_times);
+    task->algorithm = static_cast<AlgorithmType>(r.algorithm);
+    task->action = static_cast<ProcessTaskAction>(r.action);
+    task->sub_error_ignored = r.flags & SubErrorIgnored;
+    task->cache = r.flags & Cache;
+    task->max_times = r.max_times;
+    task->pre_delay = r.pre_delay;
+    task->post_delay = r.post_delay;
+    task->retry_times = r.retry_times;
+    task->specific_rect = Rect(r.specific_rect[0], r.specific_rect[1], r.specific_rect[2], r.specific_rect[3]);
+    task->roi = Rect(r.roi[0], r.roi[1], r.roi[2], r.roi[3]);
+    task->rect_move = Rect(r.rect_move[0], r.rect_move[1], r.rect_move[2], r.rect_move[3]);
+    task->special_params.reserve(r.special_params.count);
+    for (uint32_t i = 0; i < r.special_params.count; ++i) {
+        task->special_params.emplace_back(std::bit_cast<int32_t>(u32s[r.special_params.begin + i]));
+    }
+    return task;
+}
+
+bool asst::TaskDataSnapshot::save(const std::filesystem::path& path, uint64_t input_hash,
+                                  const std::unordered_map<std::string_view, TaskPtr>& tasks,
+                                  const std::unordered_map<std::string_view, TaskDeps>& deps,
+                                  const std::unordered_map<std::string_view, std::string>& sources,
+                                  const std::unordered_set<std::string>& templ_required)
+{
+    LogTraceFunction;
+
+    std::vector<std::pair<std::string_view, TaskPtr>> sorted;
+    sorted.reserve(tasks.size());
+    for (const auto& [name, task] : tasks) {
+        if (task) {
+            sorted.emplace_back(name, task);
+        }
+    }
+    ranges::sort(sorted, {}, [](const auto& pair) { return pair.first; });
+
+    std::unordered_map<std::string, uint32_t> string_ids;
+    std::vector<Span> strings;
+    std::string chars;
+    std::vector<uint32_t> u32s;
+    std::vector<double> f64s;
+
+    auto intern = [&](std::string_view str) {
+        auto [iter, inserted] = string_ids.try_emplace(std::string(str), static_cast<uint32_t>(strings.size()));
+        if (inserted) {
+            strings.emplace_back(Span { static_cast<uint32_t>(chars.size()), static_cast<uint32_t>(str.size()) });
+            chars.append(str);
+        }
+        return iter->second;
+    };
+    auto add_strings = [&](const auto& list) {
+        Span span { static_cast<uint32_t>(u32s.size()), 0 };
+        for (const std::string& str : list) {
+            u32s.emplace_back(intern(str));
+            ++span.count;
+        }
+        return span;
+    };
+    auto set_rect = [](int32_t (&dst)[4], const Rect& rect) {
+        dst[0] = rect.x;
+        dst[1] = rect.y;
+        dst[2] = rect.width;
+        dst[3] = rect.height;
+    };
+
+    std::vector<TaskRecord> records;
+    records.reserve(sorted.size());
+    for (const auto& [name, task] : sorted) {
+        TaskRecord& r = records.emplace_back();
+        r.name = intern(name);
+        r.next = add_strings(task->next);
+        r.sub = add_strings(task->sub);
+        r.on_error_next = add_strings(task->on_error_next);
+        r.exceeded_next = add_strings(task->exceeded_next);
+        r.reduce_other_times = add_strings(task->reduce_other_times);
+        r.algorithm = static_cast<int32_t>(task->algorithm);
+        r.action = static_cast<int32_t>(task->action);
+        r.flags = (task->sub_error_ignored ? SubErrorIgnored : 0u) | (task->cache ? Cache : 0u);
+        r.max_times = task->max_times;
+        r.pre_delay = task->pre_delay;
+        r.post_delay = task->post_delay;
+        r.retry_times = task->retry_times;
+        set_rect(r.specific_rect, task->specific_rect);
+        set_rect(r.roi, task->roi);
+        set_rect(r.rect_move, task->rect_move);
+        r.special_params = { static_cast<uint32_t>(u32s.size()), static_cast<uint32_t>(task->special_params.size()) };
+        for (int param : task->special_params) {
+            u32s.emplace_back(std::bit_cast<uint32_t>(static_cast<int32_t>(param)));
+        }
+
+        if (auto match = std::dynamic_pointer_cast<MatchTaskInfo>(task)) {
+            r.kind = Kind::Match;
+            r.names = add_strings(match->templ_names);
+            r.thresholds = { static_cast<uint32_t>(f64s.size()),
+                             static_cast<uint32_t>(match->templ_thresholds.size()) };
+            f64s.insert(f64s.end(), match->templ_thresholds.begin(), match->templ_thresholds.end());
+            r.mask_range[0] = match->mask_range.first;
+            r.mask_range[1] = match->mask_range.second;
+        }
+        else if (auto ocr = std::dynamic_pointer_cast<OcrTaskInfo>(task)) {
+            r.kind = Kind::Ocr;
+            r.names = add_strings(ocr->text);
+            r.replace_map = { static_cast<uint32_t>(u32s.size()), static_cast<uint32_t>(ocr->replace_map.size() * 2) };
+            for (const auto& [from, to] : ocr->replace_map) {
+                u32s.emplace_back(intern(from));
+                u32s.emplace_back(intern(to));
+            }
+            r.flags |= (ocr->full_match ? FullMatch : 0u) | (ocr->is_ascii ? IsAscii : 0u) |
+                       (ocr->without_det ? WithoutDet : 0u) | (ocr->replace_full ? ReplaceFull : 0u);
+        }
+        else if (auto hash = std::dynamic_pointer_cast<HashTaskInfo>(task)) {
+            r.kind = Kind::Hash;
+            r.names = add_strings(hash->hashes);
+            r.dist_threshold = hash->dist_threshold;
+            r.mask_range[0] = hash->mask_range.first;
+            r.mask_range[1] = hash->mask_range.second;
+            r.flags |= hash->bound ? Bound : 0;
+        }
+
+        if (auto iter = deps.find(name); iter != deps.end()) {
+            std::vector<std::string_view> sorted_deps(iter->second.begin(), iter->second.end());
+            ranges::sort(sorted_deps);
+            r.deps = { static_cast<uint32_t>(u32s.size()), static_cast<uint32_t>(sorted_deps.size()) };
+            for (std::string_view dep : sorted_deps) {
+                u32s.emplace_back(intern(dep));
+            }
+        }
+    }
+
+    std::vector<std::pair<std::string_view, std::string_view>> sorted_sources(sources.begin(), sources.end());
+    ranges::sort(sorted_sources, {}, [](const auto& pair) { return pair.first; });
+    std::vector<SourceRecord> source_records;
+    source_records.reserve(sorted_sources.size());
+    for (const auto& [name, json] : sorted_sources) {
+        source_records.emplace_back(SourceRecord { .name = intern(name), .json = intern(json) });
+    }
+
+    Header h;
+    std::memcpy(h.magic, Magic, sizeof(Magic));
+    h.version = FormatVersion;
+    h.endian_tag = EndianTag;
+    h.input_hash = input_hash;
+    h.templ_required = add_strings(templ_required);
+    h.string_count = static_cast<uint32_t>(strings.size());
+    h.u32_count = static_cast<uint32_t>(u32s.size());
+    h.f64_count = static_cast<uint32_t>(f64s.size());
+    h.task_count = static_cast<uint32_t>(records.size());
+    h.strings_offset = align8(sizeof(Header));
+    h.u32_offset = align8(h.strings_offset + strings.size() * sizeof(Span));
+    h.f64_offset = align8(h.u32_offset + u32s.size() * sizeof(uint32_t));
+    h.tasks_offset = align8(h.f64_offset + f64s.size() * sizeof(double));
+    h.source_count = static_cast<uint32_t>(source_records.size());
+    h.sources_offset = align8(h.tasks_offset + records.size() * sizeof(TaskRecord));
+    // 字符数据放最后，不需要对齐
+    h.chars_offset = h.sources_offset + source_records.size() * sizeof(SourceRecord);
+    h.file_size = h.chars_offset + chars.size();
+
+    std::vector<char> data(h.file_size, 0);
+    auto write_at = [&](uint64_t offset, const void* src, size_t size) {
+        if (size != 0) {
+            std::memcpy(data.data() + offset, src, size);
+        }
+    };
+    write_at(0, &h, sizeof(h));
+    write_at(h.strings_offset, strings.data(), strings.size() * sizeof(Span));
+    write_at(h.u32_offset, u32s.data(), u32s.size() * sizeof(uint32_t));
+    write_at(h.f64_offset, f64s.data(), f64s.size() * sizeof(double));
+    write_at(h.tasks_offset, records.data(), records.size() * sizeof(TaskRecord));
+    write_at(h.sources_offset, source_records.data(), source_records.size() * sizeof(SourceRecord));
+    write_at(h.chars_offset, chars.data(), chars.size());
+
+    // 先写临时文件再改名，避免别的进程读到写了一半的快照
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+    auto temp_path = path;
+    temp_path += ".tmp";
+    {
+        std::ofstream ofs(temp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!ofs || !ofs.write(data.data(), static_cast<std::streamsize>(data.size()))) {
+            Log.error(__FUNCTION__, "failed to write", temp_path);
+            return false;
+        }
+    }
+    std::filesystem::rename(temp_path, path, ec);
+    if (ec) {
+        Log.error(__FUNCTION__, "failed to rename", temp_path, ec.message());
+        std::filesystem::remove(temp_path, ec);
+        return false;
+    }
+    Log.info(__FUNCTION__, "tasks:", records.size(), "strings:", strings.size(), "size:", data.size());
+    return true;
+}
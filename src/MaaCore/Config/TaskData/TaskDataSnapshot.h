@@ -0,0 +1,150 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "Common/AsstTypes.h"
+
+namespace asst
+{
+    // 已完全展开的任务的二进制快照
+    // 文件里只有偏移量没有指针：字符串统一存在字符串表里按 id 引用，各种列表是 u32/f64 数组里的区间，
+    // 每个任务是一条定长记录，按任务名排序以便二分查找。整个文件读进内存（或映射）后即可直接使用，
+    // 查询时才把对应的记录还原成 TaskInfo
+    class TaskDataSnapshot
+    {
+    public:
+        using TaskDeps = std::unordered_set<std::string_view>;
+
+        // 输入内容的哈希，seed 为上一个输入的哈希，以便多个 tasks.json 叠加加载
+        static uint64_t hash_input(uint64_t seed, std::string_view content) noexcept;
+
+        // 文件不存在、哈希不一致或格式不对时返回 nullopt
+        static std::optional<TaskDataSnapshot> open(const std::filesystem::path& path, uint64_t input_hash);
+        // deps 为每个任务生成时读到过的任务名，sources 为 json 里每个任务（合并所有输入之后）自己的 json 文本
+        static bool save(const std::filesystem::path& path, uint64_t input_hash,
+                         const std::unordered_map<std::string_view, TaskPtr>& tasks,
+                         const std::unordered_map<std::string_view, TaskDeps>& deps,
+                         const std::unordered_map<std::string_view, std::string>& sources,
+                         const std::unordered_set<std::string>& templ_required);
+
+        size_t size() const noexcept;
+        // 不在快照中时返回 nullptr
+        TaskPtr find(std::string_view name) const;
+        std::unordered_set<std::string> templ_required() const;
+
+        // 以下用于运行期修改任务：只重新解析用到的那几个任务的 json，只让依赖被修改任务的那些任务失效
+        // json 里没有这个任务时返回 nullopt
+        std::optional<std::string_view> source(std::string_view name) const;
+        // 生成 name 时读到过的任务名（包括自身），不在快照中时为空
+        std::vector<std::string_view> deps(std::string_view name) const;
+        // 生成时读到过 name 的所有任务
+        std::vector<std::string_view> dependents(std::string_view name) const;
+
+    private:
+        static constexpr uint32_t FormatVersion = 3;
+
+        struct Span
+        {
+            uint32_t begin = 0;
+            uint32_t count = 0;
+        };
+
+        enum class Kind : uint32_t
+        {
+            Base,
+            Match,
+            Ocr,
+            Hash,
+        };
+
+        // TaskRecord::flags 里的各个 bool
+        static constexpr uint32_t SubErrorIgnored = 1 << 0;
+        static constexpr uint32_t Cache = 1 << 1;
+        static constexpr uint32_t FullMatch = 1 << 2;
+        static constexpr uint32_t IsAscii = 1 << 3;
+        static constexpr uint32_t WithoutDet = 1 << 4;
+        static constexpr uint32_t ReplaceFull = 1 << 5;
+        static constexpr uint32_t Bound = 1 << 6;
+
+        // 定长记录，各字段都是 4 字节，没有填充
+        struct TaskRecord
+        {
+            uint32_t name = 0;
+            Kind kind = Kind::Base;
+            Span next;
+            Span sub;
+            Span on_error_next;
+            Span exceeded_next;
+            Span reduce_other_times;
+            int32_t algorithm = 0;
+            int32_t action = 0;
+            uint32_t flags = 0;
+            int32_t max_times = 0;
+            int32_t pre_delay = 0;
+            int32_t post_delay = 0;
+            int32_t retry_times = 0;
+            int32_t specific_rect[4] = {};
+            int32_t roi[4] = {};
+            int32_t rect_move[4] = {};
+            Span special_params;
+            Span names;       // Match: templ_names; Ocr: text; Hash: hashes
+            Span replace_map; // Ocr: 成对的字符串 id
+            Span thresholds;  // Match: f64 数组里的区间
+            int32_t mask_range[2] = {};
+            int32_t dist_threshold = 0;
+            Span deps; // 生成时读到过的任务名
+        };
+
+        struct SourceRecord
+        {
+            uint32_t name = 0;
+            uint32_t json = 0;
+        };
+
+        struct Header
+        {
+            char magic[8] = {};
+            uint32_t version = 0;
+            uint32_t endian_tag = 0;
+            uint64_t input_hash = 0;
+            uint64_t file_size = 0;
+            uint32_t string_count = 0;
+            uint32_t u32_count = 0;
+            uint32_t f64_count = 0;
+            uint32_t task_count = 0;
+            uint64_t strings_offset = 0; // Span[string_count]，指向字符数据
+            uint64_t chars_offset = 0;
+            uint64_t u32_offset = 0;
+            uint64_t f64_offset = 0;
+            uint64_t tasks_offset = 0; // TaskRecord[task_count]，按名字排序
+            Span templ_required;         // u32 数组里的字符串 id
+            uint64_t sources_offset = 0; // SourceRecord[source_count]，按名字排序
+            uint32_t source_count = 0;
+            uint32_t reserved = 0;
+        };
+
+        static constexpr char Magic[8] = { 'M', 'A', 'A', 'T', 'A', 'S', 'K', 'S' };
+        static constexpr uint32_t EndianTag = 0x01020304;
+
+        TaskDataSnapshot() = default;
+
+        bool validate(uint64_t input_hash) const;
+        const Header& header() const noexcept;
+        const TaskRecord* records() const noexcept;
+        const TaskRecord* find_record(std::string_view name) const;
+        const SourceRecord* sources() const noexcept;
+        std::string_view string_at(uint32_t id) const;
+        std::vector<std::string> strings_in(const Span& span) const;
+        bool span_valid(const Span& span, uint32_t limit) const noexcept;
+
+        std::shared_ptr<const std::vector<char>> m_data;
+    };
+}
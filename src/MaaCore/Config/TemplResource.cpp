@@ -1,5 +1,6 @@
 #include "TemplResource.h"
 
+#include <algorithm>
 #include <array>
 #include <filesystem>
 #include <string_view>
@@ -18,6 +19,8 @@ bool asst::TemplResource::load(const std::filesystem::path& path)
     LogTraceFunction;
     Log.info("load", path);
 
+    std::unique_lock<std::shared_mutex> templ_lock(m_templ_mutex);
+
 #ifdef ASST_DEBUG
     bool some_file_not_exists = false;
 #endif
@@ -31,6 +34,10 @@ bool asst::TemplResource::load(const std::filesystem::path& path)
             if (auto path_iter = m_templ_paths.find(name);
                 path_iter == m_templ_paths.end() || path_iter->second != filepath) {
                 m_templs.erase(name);
+                {
+                    std::unique_lock<std::mutex> derived_lock(m_derived_mutex);
+                    m_derived.erase(name);
+                }
                 m_templ_paths.insert_or_assign(name, filepath);
             }
         }
@@ -56,6 +63,15 @@ bool asst::TemplResource::load(const std::filesystem::path& path)
 
 const cv::Mat& asst::TemplResource::get_templ(const std::string& name)
 {
+    {
+        std::shared_lock<std::shared_mutex> templ_lock(m_templ_mutex);
+        // unordered_map 插入新元素不会使已有元素的引用失效，所以解锁后返回引用是安全的
+        if (auto iter = m_templs.find(name); iter != m_templs.cend()) {
+            return iter->second;
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> templ_lock(m_templ_mutex);
     if (m_templs.find(name) == m_templs.cend()) {
         Log.info(__FUNCTION__, "lazy load", name);
 
@@ -76,3 +92,74 @@ const cv::Mat& asst::TemplResource::get_templ(const std::string& name)
     }
     return m_templs.at(name);
 }
+
+cv::Mat asst::TemplResource::get_templ_gray(const std::string& name)
+{
+    const cv::Mat& templ = get_templ(name);
+    if (templ.empty()) {
+        return {};
+    }
+
+    std::unique_lock<std::mutex> derived_lock(m_derived_mutex);
+    auto& cache = m_derived[name];
+    if (cache.gray.empty()) {
+        cv::cvtColor(templ, cache.gray, cv::COLOR_BGR2GRAY);
+    }
+    return cache.gray;
+}
+
+cv::Mat asst::TemplResource::get_templ_mask(const std::string& name, const std::pair<int, int>& mask_range,
+                                            bool with_close)
+{
+    cv::Mat gray = get_templ_gray(name);
+    if (gray.empty()) {
+        return {};
+    }
+
+    std::unique_lock<std::mutex> derived_lock(m_derived_mutex);
+    auto& mask = m_derived[name].masks[std::make_tuple(mask_range.first, mask_range.second, with_close)];
+    if (mask.empty()) {
+        cv::inRange(gray, mask_range.first, mask_range.second, mask);
+        if (with_close) {
+            cv::Mat kernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(3, 3));
+            cv::morphologyEx(mask, mask, cv::MORPH_CLOSE, kernel);
+        }
+    }
+    return mask;
+}
+
+asst::TemplResource::CoarseTempl asst::TemplResource::get_templ_coarse(const std::string& name)
+{
+    const cv::Mat& templ = get_templ(name);
+    if (templ.empty()) {
+        return {};
+    }
+
+    std::unique_lock<std::mutex> derived_lock(m_derived_mutex);
+    auto& coarse = m_derived[name].coarse;
+    if (coarse) {
+        return *coarse;
+    }
+
+    coarse.emplace();
+    if (templ.cols % 2 != 0 || templ.rows % 2 != 0) {
+        return *coarse;
+    }
+    cv::Mat templ_f;
+    templ.convertTo(templ_f, CV_32F);
+    // 整数倍缩小时 INTER_AREA 就是 2×2 块平均
+    cv::resize(templ_f, coarse->templ, cv::Size(templ.cols / 2, templ.rows / 2), 0, 0, cv::INTER_AREA);
+
+    // 宽高都是偶数时两者的均值相同，块平均分量的平方和 = 半尺寸的方差 × 原尺寸的像素数
+    cv::Scalar mean, stddev, coarse_mean, coarse_stddev;
+    cv::meanStdDev(templ_f, mean, stddev);
+    cv::meanStdDev(coarse->templ, coarse_mean, coarse_stddev);
+    const double area = static_cast<double>(templ.total());
+    double total_energy = 0;
+    for (int c = 0; c < templ.channels(); ++c) {
+        total_energy += stddev[c] * stddev[c] * area;
+        coarse->low_energy += coarse_stddev[c] * coarse_stddev[c] * area;
+    }
+    coarse->high_energy = std::max(total_energy - coarse->low_energy, 0.0);
+    return *coarse;
+}
@@ -2,6 +2,11 @@
 
 #include "AbstractResource.h"
 
+#include <map>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <tuple>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -20,9 +25,38 @@ namespace asst
 
         const cv::Mat& get_templ(const std::string& name);
 
+        // 以下为模板的派生数据，首次使用时计算并缓存，模板本身不会变，没必要每次识别都重新算
+        // 返回的 cv::Mat 与缓存共享数据，调用方不要修改内容
+        cv::Mat get_templ_gray(const std::string& name);
+        cv::Mat get_templ_mask(const std::string& name, const std::pair<int, int>& mask_range, bool with_close);
+
+        // 金字塔上一层的模板，用于粗到细匹配时估计得分上界。
+        // 模板按 2×2 块拆成 块平均 和 块内残差 两个正交分量，low_energy、high_energy 分别是两者去均值后的平方和
+        struct CoarseTempl
+        {
+            cv::Mat templ; // 2×2 块平均后的半尺寸模板，CV_32F。模板宽高不是偶数时为空
+            double low_energy = 0;
+            double high_energy = 0;
+        };
+        CoarseTempl get_templ_coarse(const std::string& name);
+
+    private:
+        struct DerivedCache
+        {
+            cv::Mat gray;
+            std::optional<CoarseTempl> coarse;
+            // key: lower, upper, with_close
+            std::map<std::tuple<int, int, bool>, cv::Mat> masks;
+        };
+
+        std::mutex m_derived_mutex;
+        std::unordered_map<std::string, DerivedCache> m_derived;
+
     private:
         std::unordered_set<std::string> m_load_required;
         std::unordered_map<std::string, cv::Mat> m_templs;
         std::unordered_map<std::string, std::filesystem::path> m_templ_paths;
+        // 识别可能在多个线程里同时进行，懒加载时要加锁
+        std::shared_mutex m_templ_mutex;
     };
 }
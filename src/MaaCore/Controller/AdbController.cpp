@@ -4,6 +4,8 @@
 #include "Common/AsstConf.h"
 #include "Utils/NoWarningCV.h"
 #include <cstdint>
+#include <cstring>
+#include <thread>
 
 #ifdef _MSC_VER
 #pragma warning(push)
@@ -179,6 +181,8 @@ std::optional<unsigned short> asst::AdbController::init_socket(const std::string
 void asst::AdbController::clear_info() noexcept
 {
     m_inited = false;
+    release_screencap_stream();
+    m_screencap_stream_header_size = 0;
     m_adb = decltype(m_adb)();
     m_uuid.clear();
     m_width = 0;
@@ -276,6 +280,7 @@ std::pair<int, int> asst::AdbController::get_screen_res() const noexcept
 
 void asst::AdbController::release()
 {
+    release_screencap_stream();
     close_socket();
 
     if (m_kill_adb_on_exit && !m_adb.release.empty()) {
@@ -293,30 +298,43 @@ bool asst::AdbController::convert_lf(std::string& data)
     if (data.empty() || data.size() < 2) {
         return false;
     }
-    auto pred = [](const std::string::iterator& cur) -> bool { return *cur == '\r' && *(cur + 1) == '\n'; };
-    // find the first of "\r\n"
-    auto first_iter = data.end();
-    for (auto iter = data.begin(); iter != data.end() - 1; ++iter) {
-        if (pred(iter)) {
-            first_iter = iter;
-            break;
+    char* const data_beg = data.data();
+    char* const data_end = data_beg + data.size();
+    // 用 memchr 找 '\r'，最后一个字符不参与判断（它后面没有 '\n'）
+    auto find_crlf = [&](char* from) -> char* {
+        while (from < data_end - 1) {
+            auto* cr = static_cast<char*>(std::memchr(from, '\r', data_end - 1 - from));
+            if (!cr) {
+                return nullptr;
+            }
+            if (*(cr + 1) == '\n') {
+                return cr;
+            }
+            from = cr + 1;
         }
-    }
-    if (first_iter == data.end()) {
+        return nullptr;
+    };
+
+    // find the first of "\r\n"
+    char* crlf = find_crlf(data_beg);
+    if (!crlf) {
         return false;
     }
-    // move forward all non-crlf elements
-    auto end_r1_iter = data.end() - 1;
-    auto next_iter = first_iter;
-    while (++first_iter != end_r1_iter) {
-        if (!pred(first_iter)) {
-            *next_iter = *first_iter;
-            ++next_iter;
+    // 两个 "\r\n" 之间的数据整段 memmove，而不是逐字节搬运
+    char* write_iter = crlf;
+    char* read_iter = crlf + 1;
+    while (true) {
+        crlf = find_crlf(read_iter);
+        char* seg_end = crlf ? crlf : data_end;
+        const size_t seg_size = seg_end - read_iter;
+        std::memmove(write_iter, read_iter, seg_size);
+        write_iter += seg_size;
+        if (!crlf) {
+            break;
         }
+        read_iter = crlf + 1;
     }
-    *next_iter = *end_r1_iter;
-    ++next_iter;
-    data.erase(next_iter, data.end());
+    data.resize(write_iter - data_beg);
     return true;
 }
 
@@ -342,6 +360,7 @@ bool asst::AdbController::screencap(cv::Mat& image_payload, bool allow_reconnect
         const size_t header_size = data.size() - std_size; // 12 or 16. ref:
         // https://android.googlesource.com/platform/frameworks/base/+/26a2b97dbe48ee45e9ae70110714048f2f360f97%5E%21/cmds/screencap/screencap.cpp
         auto img_data_beg = data.cbegin() + header_size;
+        // 直接引用 data 的内存，不拷贝
         cv::Mat temp(m_height, m_width, CV_8UC4, const_cast<char*>(&*img_data_beg));
         if (temp.empty()) {
             return false;
@@ -350,14 +369,15 @@ bool asst::AdbController::screencap(cv::Mat& image_payload, bool allow_reconnect
         if (br[3] != 255) { // only check alpha
             return false;
         }
-        cv::cvtColor(temp, temp, cv::COLOR_RGBA2BGR);
-        image_payload = temp;
+        // 尺寸不变时 cvtColor 会直接写进 image_payload 原有的缓冲区，稳定运行后不再分配内存
+        cv::cvtColor(temp, image_payload, cv::COLOR_RGBA2BGR);
         return true;
     };
 
     DecodeFunc decode_raw_with_gzip = [&](const std::string& data) -> bool {
-        const std::string raw_data = gzip::decompress(data.data(), data.size());
-        return decode_raw(raw_data);
+        // 复用解压缓冲区，容量足够时 resize 不会重新分配
+        gzip::Decompressor().decompress(m_decompress_buffer, data.data(), data.size());
+        return decode_raw(m_decompress_buffer);
     };
 
     DecodeFunc decode_encode = [&](const std::string& data) -> bool {
@@ -420,11 +440,35 @@ bool asst::AdbController::screencap(cv::Mat& image_payload, bool allow_reconnect
         else {
             Log.info("Encode is not supported");
         }
+        clear_lf_info();
+
+        // 首帧需要探测 header 长度并拉起 shell，不计入耗时
+        bool stream_supported = screencap_by_stream(decode_raw, allow_reconnect);
+        if (stream_supported) {
+            start_time = high_resolution_clock::now();
+            stream_supported = screencap_by_stream(decode_raw, allow_reconnect);
+        }
+        if (stream_supported) {
+            auto duration = duration_cast<milliseconds>(high_resolution_clock::now() - start_time);
+            if (duration < min_cost) {
+                m_adb.screencap_method = AdbProperty::ScreencapMethod::RawByStream;
+                m_inited = true;
+                min_cost = duration;
+            }
+            Log.info("RawByStream cost", duration.count(), "ms");
+        }
+        else {
+            Log.info("RawByStream is not supported");
+        }
+        if (m_adb.screencap_method != AdbProperty::ScreencapMethod::RawByStream) {
+            release_screencap_stream();
+        }
         static const std::unordered_map<AdbProperty::ScreencapMethod, std::string> MethodName = {
             { AdbProperty::ScreencapMethod::UnknownYet, "UnknownYet" },
             { AdbProperty::ScreencapMethod::RawByNc, "RawByNc" },
             { AdbProperty::ScreencapMethod::RawWithGzip, "RawWithGzip" },
             { AdbProperty::ScreencapMethod::Encode, "Encode" },
+            { AdbProperty::ScreencapMethod::RawByStream, "RawByStream" },
         };
         Log.info("The fastest way is", MethodName.at(m_adb.screencap_method), ", cost:", min_cost.count(), "ms");
         json::value info = json::object {
@@ -449,11 +493,139 @@ bool asst::AdbController::screencap(cv::Mat& image_payload, bool allow_reconnect
     case AdbProperty::ScreencapMethod::Encode: {
         return screencap(m_adb.screencap_encode, decode_encode, allow_reconnect);
     } break;
+    case AdbProperty::ScreencapMethod::RawByStream: {
+        return screencap_by_stream(decode_raw, allow_reconnect);
+    } break;
     }
 
     return false;
 }
 
+bool asst::AdbController::screencap_by_stream(const DecodeFunc& decode_func, bool allow_reconnect)
+{
+    if (m_adb.screencap_raw_by_stream.empty()) [[unlikely]] {
+        return false;
+    }
+    if (!m_screencap_stream_handler && !call_and_hup_screencap_stream()) {
+        return false;
+    }
+
+    auto start_time = std::chrono::steady_clock::now();
+    auto ret = read_screencap_stream();
+    if (!ret && allow_reconnect && !need_exit()) {
+        Log.warn("screencap stream is broken, try to restart it");
+        if (call_and_hup_screencap_stream()) {
+            ret = read_screencap_stream();
+        }
+    }
+    if (!ret) {
+        release_screencap_stream();
+        return false;
+    }
+    auto duration =
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time).count();
+    Log.trace("Screencap by stream cost", duration, "ms, size:", ret.value().size());
+
+    // 流式截图是按固定长度切帧的，行尾被转换过的话根本切不对，所以这里不尝试 convert_lf
+    if (!decode_func(ret.value())) {
+        Log.error("screencap stream decode failed");
+        release_screencap_stream();
+        return false;
+    }
+    return true;
+}
+
+bool asst::AdbController::call_and_hup_screencap_stream()
+{
+    LogTraceFunction;
+    release_screencap_stream();
+
+    Log.info(m_adb.screencap_raw_by_stream);
+    m_screencap_stream_handler = m_platform_io->interactive_shell(m_adb.screencap_raw_by_stream);
+    if (!m_screencap_stream_handler) {
+        Log.error("unable to start screencap stream");
+        return false;
+    }
+    return true;
+}
+
+void asst::AdbController::release_screencap_stream()
+{
+    m_screencap_stream_handler.reset();
+    m_screencap_stream_buffer.clear();
+}
+
+std::optional<std::string> asst::AdbController::read_screencap_stream()
+{
+    using namespace std::chrono;
+    using namespace std::chrono_literals;
+
+    if (!m_screencap_stream_handler) {
+        return std::nullopt;
+    }
+    // 每写入一行，设备端的 shell 循环就执行一次 screencap
+    if (!m_screencap_stream_handler->write("\n")) {
+        Log.error("failed to request frame from screencap stream");
+        return std::nullopt;
+    }
+
+    // header 为 12 或 16 字节，见 decode_raw 中的说明。
+    // 流里没有别的分隔，所以首帧收满 12 字节头后再等一会儿，没有更多数据就认为是 12 字节
+    constexpr size_t MinHeaderSize = 12;
+    constexpr size_t MaxHeaderSize = 16;
+    constexpr auto HeaderProbeIdle = 300ms;
+    constexpr auto StreamTimeout = 20s;
+
+    const size_t std_size = 4ULL * m_width * m_height;
+    auto& buffer = m_screencap_stream_buffer;
+    buffer.reserve(MaxHeaderSize + std_size);
+
+    const auto start_time = steady_clock::now();
+    auto last_recv_time = start_time;
+    while (true) {
+        if (need_exit()) {
+            return std::nullopt;
+        }
+        if (m_screencap_stream_header_size != 0) {
+            if (buffer.size() >= m_screencap_stream_header_size + std_size) {
+                break;
+            }
+        }
+        else if (buffer.size() >= MaxHeaderSize + std_size) {
+            m_screencap_stream_header_size = MaxHeaderSize;
+            break;
+        }
+        else if (buffer.size() >= MinHeaderSize + std_size && steady_clock::now() - last_recv_time > HeaderProbeIdle) {
+            m_screencap_stream_header_size = MinHeaderSize;
+            break;
+        }
+
+        if (steady_clock::now() - start_time > StreamTimeout) {
+            Log.error("screencap stream timeout, received", buffer.size(), "bytes");
+            return std::nullopt;
+        }
+
+        std::string chunk = m_screencap_stream_handler->read(1);
+        if (chunk.empty()) {
+            std::this_thread::sleep_for(1ms);
+            continue;
+        }
+        buffer.append(chunk);
+        last_recv_time = steady_clock::now();
+    }
+
+    const size_t frame_size = m_screencap_stream_header_size + std_size;
+    if (buffer.size() > frame_size) {
+        // 一问一答的情况下不应该有多余数据，多半是流已经错位了
+        Log.error("screencap stream has", buffer.size() - frame_size, "extra bytes, maybe out of sync");
+        buffer.clear();
+        return std::nullopt;
+    }
+    std::string frame = std::move(buffer);
+    buffer = std::string();
+    return frame;
+}
+
 bool asst::AdbController::screencap(const std::string& cmd, const DecodeFunc& decode_func, bool allow_reconnect,
                                     bool by_socket)
 {
@@ -702,6 +874,7 @@ bool asst::AdbController::connect(const std::string& adb_path, const std::string
     m_adb.press_esc = cmd_replace(adb_cfg.press_esc);
     m_adb.screencap_raw_with_gzip = cmd_replace(adb_cfg.screencap_raw_with_gzip);
     m_adb.screencap_encode = cmd_replace(adb_cfg.screencap_encode);
+    m_adb.screencap_raw_by_stream = cmd_replace(adb_cfg.screencap_raw_by_stream);
     m_adb.start = cmd_replace(adb_cfg.start);
     m_adb.stop = cmd_replace(adb_cfg.stop);
     m_adb.back_to_home = cmd_replace(adb_cfg.back_to_home);
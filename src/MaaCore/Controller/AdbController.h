@@ -66,6 +66,12 @@ namespace asst
                        bool by_socket = false);
         void clear_lf_info();
 
+        // 常驻的截图 shell，每写入一行就推送一帧 raw 数据，省去每帧创建 adb 进程的开销
+        bool screencap_by_stream(const DecodeFunc& decode_func, bool allow_reconnect = false);
+        bool call_and_hup_screencap_stream();
+        void release_screencap_stream();
+        std::optional<std::string> read_screencap_stream();
+
         virtual void clear_info() noexcept;
         void callback(AsstMsg msg, const json::value& details);
 
@@ -94,6 +100,7 @@ namespace asst
             std::string screencap_raw_by_nc;
             std::string screencap_raw_with_gzip;
             std::string screencap_encode;
+            std::string screencap_raw_by_stream;
             std::string release;
 
             std::string start;
@@ -116,10 +123,16 @@ namespace asst
                 // Default,
                 RawByNc,
                 RawWithGzip,
-                Encode
+                Encode,
+                RawByStream
             } screencap_method = ScreencapMethod::UnknownYet;
         } m_adb;
 
+        std::string m_decompress_buffer; // 复用的 gzip 解压缓冲区
+        std::shared_ptr<IOHandler> m_screencap_stream_handler = nullptr;
+        std::string m_screencap_stream_buffer;
+        size_t m_screencap_stream_header_size = 0; // 0 表示尚未探测
+
         std::string m_uuid;
         std::pair<int, int> m_screen_size = { 0, 0 };
         int m_width = 0;
@@ -22,7 +22,9 @@
 #include "AdbController.h"
 
 #include "Common/AsstTypes.h"
+#include "Config/GeneralConfig.h"
 #include "Utils/Logger.hpp"
+#include "Vision/FrameCache.h"
 
 asst::Controller::Controller(const AsstCallback& callback, Assistant* inst)
     : InstHelper(inst), m_callback(callback), m_rand_engine(std::random_device {}())
@@ -35,6 +37,14 @@ asst::Controller::Controller(const AsstCallback& callback, Assistant* inst)
 asst::Controller::~Controller()
 {
     LogTraceFunction;
+
+    auto stats = get_frame_pool_stats();
+    Log.info("frame pool reused", stats.reused, "times, allocated", stats.allocated, "times");
+
+    auto& frame_cache = FrameCache::get_instance();
+    frame_cache.release(this);
+    auto cache_stats = frame_cache.get_stats();
+    Log.info("frame cache hit", cache_stats.hits, "times, missed", cache_stats.misses, "times");
 }
 
 std::pair<int, int> asst::Controller::get_scale_size() const noexcept
@@ -85,11 +95,51 @@ cv::Mat asst::Controller::get_resized_image_cache() const
         Log.error("image is empty");
         return { d_size, CV_8UC3 };
     }
-    cv::Mat resized_mat;
+    cv::Mat resized_mat = acquire_pooled_frame(d_size, m_cache_image.type());
     cv::resize(m_cache_image, resized_mat, d_size, 0.0, 0.0, cv::INTER_AREA);
+    if (Config.get_options().frame_recognition_cache) {
+        FrameCache::get_instance().register_frame(this, resized_mat);
+    }
     return resized_mat;
 }
 
+cv::Mat asst::Controller::acquire_pooled_frame(const cv::Size& size, int type) const
+{
+    std::unique_lock<std::mutex> pool_lock(m_frame_pool_mutex);
+
+    // 引用计数为 1 说明只剩池子自己持有，之前拿走它的调用方都已经释放了
+    auto is_idle = [](const cv::Mat& frame) { return frame.u && frame.u->refcount == 1; };
+
+    cv::Mat* idle_slot = nullptr;
+    for (cv::Mat& frame : m_frame_pool) {
+        if (!is_idle(frame)) {
+            continue;
+        }
+        if (frame.size() == size && frame.type() == type) {
+            ++m_frame_pool_stats.reused;
+            return frame;
+        }
+        idle_slot = &frame;
+    }
+
+    ++m_frame_pool_stats.allocated;
+    cv::Mat frame(size, type);
+    if (idle_slot) {
+        *idle_slot = frame;
+    }
+    else if (m_frame_pool.size() < FramePoolSize) {
+        m_frame_pool.emplace_back(frame);
+    }
+    // 池子满了且都在被外部使用，这块就不入池了
+    return frame;
+}
+
+asst::Controller::FramePoolStats asst::Controller::get_frame_pool_stats() const
+{
+    std::unique_lock<std::mutex> pool_lock(m_frame_pool_mutex);
+    return m_frame_pool_stats;
+}
+
 bool asst::Controller::start_game(const std::string& client_type)
 {
     CHECK_EXIST(m_controller, false);
@@ -105,12 +155,14 @@ bool asst::Controller::stop_game()
 bool asst::Controller::click(const Point& p)
 {
     CHECK_EXIST(m_controller, false);
+    discard_prefetched_image();
     return m_scale_proxy->click(p);
 }
 
 bool asst::Controller::click(const Rect& rect)
 {
     CHECK_EXIST(m_controller, false);
+    discard_prefetched_image();
     return m_scale_proxy->click(rect);
 }
 
@@ -118,6 +170,7 @@ bool asst::Controller::swipe(const Point& p1, const Point& p2, int duration, boo
                              double slope_out, bool with_pause)
 {
     CHECK_EXIST(m_controller, false);
+    discard_prefetched_image();
     return m_scale_proxy->swipe(p1, p2, duration, extra_swipe, slope_in, slope_out, with_pause);
 }
 
@@ -125,12 +178,14 @@ bool asst::Controller::swipe(const Rect& r1, const Rect& r2, int duration, bool
                              double slope_out, bool with_pause)
 {
     CHECK_EXIST(m_controller, false);
+    discard_prefetched_image();
     return m_scale_proxy->swipe(r1, r2, duration, extra_swipe, slope_in, slope_out, with_pause);
 }
 
 bool asst::Controller::inject_input_event(InputEvent& event)
 {
     CHECK_EXIST(m_controller, false);
+    discard_prefetched_image();
     return m_controller->inject_input_event(event);
 }
 
@@ -139,6 +194,7 @@ bool asst::Controller::press_esc()
     LogTraceFunction;
 
     CHECK_EXIST(m_controller, false);
+    discard_prefetched_image();
     return m_controller->press_esc();
 }
 
@@ -152,6 +208,7 @@ bool asst::Controller::connect(const std::string& adb_path, const std::string& a
 {
     LogTraceFunction;
 
+    discard_prefetched_image();
     clear_info();
 
     m_controller =
@@ -258,6 +315,60 @@ const std::string& asst::Controller::get_uuid() const
 }
 
 cv::Mat asst::Controller::get_image(bool raw)
+{
+    discard_prefetched_image();
+    return capture_image(raw);
+}
+
+void asst::Controller::prefetch_image()
+{
+    std::unique_lock<std::mutex> prefetch_lock(m_prefetch_mutex);
+    if (m_prefetched_image.valid()) {
+        return;
+    }
+    m_prefetched_image = std::async(std::launch::async, [this]() {
+        cv::Mat image = capture_image(false);
+        return std::make_pair(std::move(image), std::chrono::steady_clock::now());
+    });
+}
+
+std::optional<cv::Mat> asst::Controller::take_prefetched_image(std::chrono::milliseconds max_age)
+{
+    decltype(m_prefetched_image) prefetched;
+    {
+        std::unique_lock<std::mutex> prefetch_lock(m_prefetch_mutex);
+        prefetched = std::move(m_prefetched_image);
+    }
+    if (!prefetched.valid()) {
+        return std::nullopt;
+    }
+
+    auto [image, captured_time] = prefetched.get();
+    if (image.empty() || std::chrono::steady_clock::now() - captured_time > max_age) {
+        return std::nullopt;
+    }
+    return image;
+}
+
+std::chrono::milliseconds asst::Controller::screencap_latency() const noexcept
+{
+    return std::chrono::milliseconds(m_screencap_latency_ms.load());
+}
+
+void asst::Controller::discard_prefetched_image()
+{
+    decltype(m_prefetched_image) prefetched;
+    {
+        std::unique_lock<std::mutex> prefetch_lock(m_prefetch_mutex);
+        prefetched = std::move(m_prefetched_image);
+    }
+    // 等它截完，免得和接下来的操作、截图交错
+    if (prefetched.valid()) {
+        prefetched.wait();
+    }
+}
+
+cv::Mat asst::Controller::capture_image(bool raw)
 {
     if (get_scale_size() == std::pair(0, 0)) {
         Log.error("Unknown image size");
@@ -271,7 +382,11 @@ cv::Mat asst::Controller::get_image(bool raw)
         if (need_exit()) {
             break;
         }
+        const auto start = std::chrono::steady_clock::now();
         if (screencap()) {
+            m_screencap_latency_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                         std::chrono::steady_clock::now() - start)
+                                         .count();
             success = true;
             break;
         }
@@ -297,7 +412,8 @@ cv::Mat asst::Controller::get_image(bool raw)
 
     if (raw) {
         std::shared_lock<std::shared_mutex> image_lock(m_image_mutex);
-        cv::Mat copy = m_cache_image.clone();
+        cv::Mat copy = acquire_pooled_frame(m_cache_image.size(), m_cache_image.type());
+        m_cache_image.copyTo(copy);
         return copy;
     }
 
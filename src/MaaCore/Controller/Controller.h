@@ -1,11 +1,17 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <future>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <random>
 #include <shared_mutex>
 #include <string>
 #include <thread>
+#include <utility>
+#include <vector>
 
 #ifdef _WIN32
 #include "Platform/Win32IO.h"
@@ -50,6 +56,14 @@ namespace asst
         cv::Mat get_image_cache() const;
         bool screencap(bool allow_reconnect = false);
 
+        // 在后台开始截一张图，调用方在等待期间可以继续做别的事，之后用 take_prefetched_image 取走。
+        // 期间有任何操作（点击、滑动等）或者 get_image，这张图都会作废
+        void prefetch_image();
+        // 取走后台截的图。没有预取，或者截完到现在已经超过 max_age 时，返回 std::nullopt
+        std::optional<cv::Mat> take_prefetched_image(std::chrono::milliseconds max_age);
+        // 最近一次截图的耗时，还没截过图时为 0
+        std::chrono::milliseconds screencap_latency() const noexcept;
+
         bool start_game(const std::string& client_type);
         bool stop_game();
 
@@ -68,13 +82,24 @@ namespace asst
 
         std::pair<int, int> get_scale_size() const noexcept;
 
+        struct FramePoolStats
+        {
+            size_t reused = 0;    // 复用池中缓冲区的次数
+            size_t allocated = 0; // 新分配缓冲区的次数，稳定运行后应不再增长
+        };
+        FramePoolStats get_frame_pool_stats() const;
+
         Controller& operator=(const Controller&) = delete;
         Controller& operator=(Controller&&) = delete;
 
         bool back_to_home();
 
     private:
+        cv::Mat capture_image(bool raw);
+        void discard_prefetched_image();
         cv::Mat get_resized_image_cache() const;
+        // 从帧缓冲池中取一块外部已不再持有的缓冲区，没有则新分配
+        cv::Mat acquire_pooled_frame(const cv::Size& size, int type) const;
 
         void clear_info() noexcept;
         void callback(AsstMsg msg, const json::value& details);
@@ -102,6 +127,18 @@ namespace asst
         bool m_kill_adb_on_exit = false;
 
         mutable std::shared_mutex m_image_mutex;
+        // 截图直接解码到这里并原地复用，不要把它浅拷贝给外部
         cv::Mat m_cache_image;
+
+        static constexpr size_t FramePoolSize = 4;
+        mutable std::mutex m_frame_pool_mutex;
+        mutable std::vector<cv::Mat> m_frame_pool;
+        mutable FramePoolStats m_frame_pool_stats;
+
+        std::atomic<int64_t> m_screencap_latency_ms = 0;
+
+        // 放在最后，析构时最先等后台截图结束
+        std::mutex m_prefetch_mutex;
+        std::future<std::pair<cv::Mat, std::chrono::steady_clock::time_point>> m_prefetched_image; // 图和截完的时间
     };
 } // namespace asst
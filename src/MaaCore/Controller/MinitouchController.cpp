@@ -141,8 +141,11 @@ bool asst::MinitouchController::click(const Point& p)
     }
 
     Log.trace(m_use_maa_touch ? "maatouch" : "minitouch", "click:", p);
-    bool ret = m_minitoucher->down(p.x, p.y) && m_minitoucher->up();
-    m_minitoucher->extra_sleep();
+    m_minitoucher->begin_gesture();
+    m_minitoucher->down(p.x, p.y);
+    m_minitoucher->up();
+    bool ret = m_minitoucher->end_gesture();
+    finish_gesture();
     return ret;
 }
 
@@ -165,6 +168,8 @@ bool asst::MinitouchController::swipe(const Point& p1, const Point& p2, int dura
     }
 
     Log.trace(m_use_maa_touch ? "maatouch" : "minitouch", "swipe", p1, p2, duration, extra_swipe, slope_in, slope_out);
+    // 整个滑动拼成一段指令一次写入，而不是每一步都写一次管道
+    m_minitoucher->begin_gesture();
     m_minitoucher->down(x1, y1);
 
     constexpr int TimeInterval = Minitoucher::DefaultSwipeDelay;
@@ -193,7 +198,9 @@ bool asst::MinitouchController::swipe(const Point& p1, const Point& p2, int dura
                     m_minitoucher->key_up(EscKeyCode, 0);
                 }
                 else {
-                    pause_future = std::async(std::launch::async, [&]() { press_esc(); });
+                    // 先把暂停点之前的移动写进去，再去按返回键
+                    m_minitoucher->flush();
+                    pause_future = std::async(std::launch::async, [&]() { AdbController::press_esc(); });
                 }
             }
             if (cur_x < 0 || cur_x > m_minitouch_props.max_x || cur_y < 0 || cur_y > m_minitouch_props.max_y) {
@@ -212,11 +219,35 @@ bool asst::MinitouchController::swipe(const Point& p1, const Point& p2, int dura
         m_minitoucher->wait(opt.minitouch_swipe_extra_end_delay); // 停留终点
         minitouch_move(x2, y2, x2, y2 - opt.minitouch_extra_swipe_dist, opt.minitouch_extra_swipe_duration);
     }
-    bool ret = m_minitoucher->up();
-    m_minitoucher->extra_sleep();
+    m_minitoucher->up();
+    bool ret = m_minitoucher->end_gesture();
+    finish_gesture();
     return ret;
 }
 
+void asst::MinitouchController::finish_gesture()
+{
+    if (!Config.get_options().minitouch_async_gesture) {
+        m_minitoucher->extra_sleep();
+    }
+}
+
+bool asst::MinitouchController::screencap(cv::Mat& image_payload, bool allow_reconnect)
+{
+    if (m_minitoucher) {
+        m_minitoucher->extra_sleep();
+    }
+    return AdbController::screencap(image_payload, allow_reconnect);
+}
+
+bool asst::MinitouchController::press_esc()
+{
+    if (m_minitoucher) {
+        m_minitoucher->extra_sleep();
+    }
+    return AdbController::press_esc();
+}
+
 bool asst::MinitouchController::inject_input_event(const InputEvent& event)
 {
     LogTraceFunction;
@@ -4,6 +4,10 @@
 
 #include "Config/GeneralConfig.h"
 
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <string_view>
 #include <thread>
 
 namespace asst
@@ -30,6 +34,10 @@ namespace asst
 
         virtual bool inject_input_event(const InputEvent& event) override;
 
+        // 异步手势模式下，截图和按返回键前要先等之前的手势在设备上执行完
+        virtual bool screencap(cv::Mat& image_payload, bool allow_reconnect = false) override;
+        virtual bool press_esc() override;
+
         virtual ControlFeat::Feat support_features() const noexcept override;
 
         MinitouchController& operator=(const MinitouchController&) = delete;
@@ -49,6 +57,8 @@ namespace asst
         void release_minitouch(bool force = false);
 
         bool use_swipe_with_pause() const noexcept;
+        // 手势写入后，同步模式等设备执行完再返回；异步模式直接返回，由下一次截图等待
+        void finish_gesture();
 
         virtual void clear_info() noexcept override;
 
@@ -83,122 +93,147 @@ namespace asst
             static constexpr int DefaultSwipeDelay = 2;
             static constexpr int ExtraDelay = 0;
 
-            Minitoucher(InputFunc func, const MinitouchProps& props) : m_input_func(func), m_props(props) {}
+            Minitoucher(InputFunc func, const MinitouchProps& props) : m_input_func(func), m_props(props)
+            {
+                m_buffer.reserve(4096);
+            }
 
             ~Minitoucher() = default;
 
-            bool reset() { return m_input_func(reset_cmd()); }
-            bool commit() { return m_input_func(commit_cmd()); }
+            bool reset()
+            {
+                append(reset_cmd());
+                return submit();
+            }
+            bool commit()
+            {
+                append(commit_cmd());
+                return submit();
+            }
             bool down(int x, int y, int wait_ms = DefaultClickDelay, bool with_commit = true, int contact = 0)
             {
-                return m_input_func(down_cmd(x, y, wait_ms, with_commit, contact));
+                down_cmd(x, y, wait_ms, with_commit, contact);
+                return submit();
             }
             bool move(int x, int y, int wait_ms = DefaultSwipeDelay, bool with_commit = true, int contact = 0)
             {
-                return m_input_func(move_cmd(x, y, wait_ms, with_commit, contact));
+                move_cmd(x, y, wait_ms, with_commit, contact);
+                return submit();
             }
             bool up(int wait_ms = DefaultClickDelay, bool with_commit = true, int contact = 0)
             {
-                return m_input_func(up_cmd(wait_ms, with_commit, contact));
+                up_cmd(wait_ms, with_commit, contact);
+                return submit();
             }
             bool key_down(int key_code, int wait_ms = DefaultClickDelay, bool with_commit = true)
             {
-                return m_input_func(key_down_cmd(key_code, wait_ms, with_commit));
+                key_cmd(key_code, 'd', wait_ms, with_commit);
+                return submit();
             }
             bool key_up(int key_code, int wait_ms = DefaultClickDelay, bool with_commit = true)
             {
-                return m_input_func(key_up_cmd(key_code, wait_ms, with_commit));
+                key_cmd(key_code, 'u', wait_ms, with_commit);
+                return submit();
+            }
+            bool wait(int ms)
+            {
+                wait_cmd(ms);
+                return submit();
+            }
+            void clear() noexcept
+            {
+                m_buffer.clear();
+                m_wait_ms_count = 0;
+            }
+
+            // 手势开始后，各指令只拼进缓冲区，到 end_gesture 时一次写入
+            void begin_gesture() noexcept { m_in_gesture = true; }
+            bool end_gesture()
+            {
+                m_in_gesture = false;
+                return flush();
+            }
+            // 把缓冲区里已有的指令立即写入，手势中途需要和其他操作对齐时用
+            bool flush()
+            {
+                if (m_buffer.empty()) {
+                    return true;
+                }
+                // 设备按顺序执行指令里的等待，据此推算执行完的时间
+                const auto now = std::chrono::steady_clock::now();
+                m_done_time = (std::max)(now, m_done_time) + std::chrono::milliseconds(m_wait_ms_count);
+                m_wait_ms_count = 0;
+
+                bool ret = m_input_func(m_buffer);
+                m_buffer.clear();
+                return ret;
             }
-            bool wait(int ms) { return m_input_func(wait_cmd(ms)); }
-            void clear() noexcept { m_wait_ms_count = 0; }
 
-            void extra_sleep() { sleep(); }
+            // 等待已写入的指令在设备上执行完
+            void extra_sleep() { std::this_thread::sleep_until(m_done_time); }
 
         private:
-            [[nodiscard]] std::string reset_cmd() const noexcept { return "r\n"; }
-            [[nodiscard]] std::string commit_cmd() const noexcept { return "c\n"; }
-#ifdef _MSC_VER
-#pragma warning(push)
-#pragma warning(disable : 4996)
-#endif
-            [[nodiscard]] std::string down_cmd(int x, int y, int wait_ms = DefaultClickDelay, bool with_commit = true,
-                                               int contact = 0)
-            {
-                // mac 编不过
-                // std::string str = std::format("d {} {} {} {}\n", contact, x, y, pressure);
-
-                char buff[64] = { 0 };
-                auto [c_x, c_y] = scale(x, y);
-                sprintf(buff, "d %d %d %d %d\n", contact, c_x, c_y, m_props.max_pressure);
-                std::string str = buff;
+            bool submit() { return m_in_gesture || flush(); }
 
-                if (with_commit) str += commit_cmd();
-                if (wait_ms) str += wait_cmd(wait_ms);
-                return str;
+            void append(std::string_view str) { m_buffer.append(str); }
+            void append(int value)
+            {
+                char buff[16] = { 0 };
+                auto [ptr, ec] = std::to_chars(std::begin(buff), std::end(buff), value);
+                m_buffer.append(buff, ptr);
+            }
+            // "op v1 v2 ...\n"
+            template <typename... Ints>
+            void append_line(char op, Ints... values)
+            {
+                m_buffer.push_back(op);
+                ((m_buffer.push_back(' '), append(values)), ...);
+                m_buffer.push_back('\n');
+            }
+            void append_tail(int wait_ms, bool with_commit)
+            {
+                if (with_commit) append(commit_cmd());
+                if (wait_ms) wait_cmd(wait_ms);
             }
 
-            [[nodiscard]] std::string move_cmd(int x, int y, int wait_ms = DefaultSwipeDelay, bool with_commit = true,
-                                               int contact = 0)
+            static constexpr std::string_view reset_cmd() noexcept { return "r\n"; }
+            static constexpr std::string_view commit_cmd() noexcept { return "c\n"; }
+
+            void down_cmd(int x, int y, int wait_ms, bool with_commit, int contact)
             {
-                char buff[64] = { 0 };
                 auto [c_x, c_y] = scale(x, y);
-                sprintf(buff, "m %d %d %d %d\n", contact, c_x, c_y, m_props.max_pressure);
-                std::string str = buff;
-
-                if (with_commit) str += commit_cmd();
-                if (wait_ms) str += wait_cmd(wait_ms);
-                return str;
+                append_line('d', contact, c_x, c_y, m_props.max_pressure);
+                append_tail(wait_ms, with_commit);
             }
 
-            [[nodiscard]] std::string up_cmd(int wait_ms = DefaultClickDelay, bool with_commit = true, int contact = 0)
+            void move_cmd(int x, int y, int wait_ms, bool with_commit, int contact)
             {
-                char buff[16] = { 0 };
-                sprintf(buff, "u %d\n", contact);
-                std::string str = buff;
-
-                if (with_commit) str += commit_cmd();
-                if (wait_ms) str += wait_cmd(wait_ms);
-                return str;
+                auto [c_x, c_y] = scale(x, y);
+                append_line('m', contact, c_x, c_y, m_props.max_pressure);
+                append_tail(wait_ms, with_commit);
             }
 
-            [[nodiscard]] std::string key_down_cmd(int key_code, int wait_ms = DefaultClickDelay,
-                                                   bool with_commit = true)
+            void up_cmd(int wait_ms, bool with_commit, int contact)
             {
-                char buff[64] = { 0 };
-                sprintf(buff, "k %d d\n", key_code);
-                std::string str = buff;
-
-                if (with_commit) str += commit_cmd();
-                if (wait_ms) str += wait_cmd(wait_ms);
-                return str;
+                append_line('u', contact);
+                append_tail(wait_ms, with_commit);
             }
 
-            [[nodiscard]] std::string key_up_cmd(int key_code, int wait_ms = DefaultClickDelay, bool with_commit = true)
+            // "k <key_code> d|u"
+            void key_cmd(int key_code, char action, int wait_ms, bool with_commit)
             {
-                char buff[64] = { 0 };
-                sprintf(buff, "k %d u\n", key_code);
-                std::string str = buff;
-
-                if (with_commit) str += commit_cmd();
-                if (wait_ms) str += wait_cmd(wait_ms);
-                return str;
+                m_buffer.append("k ");
+                append(key_code);
+                m_buffer.push_back(' ');
+                m_buffer.push_back(action);
+                m_buffer.push_back('\n');
+                append_tail(wait_ms, with_commit);
             }
 
-            [[nodiscard]] std::string wait_cmd(int ms)
+            void wait_cmd(int ms)
             {
                 m_wait_ms_count += ms;
-                char buff[16] = { 0 };
-                sprintf(buff, "w %d\n", ms);
-                return buff;
-            }
-#ifdef _MSC_VER
-#pragma warning(pop)
-#endif
-            void sleep()
-            {
-                using namespace std::chrono_literals;
-                std::this_thread::sleep_for(m_wait_ms_count * 1ms);
-                m_wait_ms_count = 0;
+                append_line('w', ms);
             }
 
         private:
@@ -231,7 +266,10 @@ namespace asst
 
             const std::function<bool(const std::string&)> m_input_func = nullptr;
             const MinitouchProps& m_props;
+            std::string m_buffer;
+            bool m_in_gesture = false;
             int m_wait_ms_count = ExtraDelay;
+            std::chrono::steady_clock::time_point m_done_time;
         };
     };
 } // namespace asst
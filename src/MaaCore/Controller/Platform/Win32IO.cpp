@@ -381,19 +381,21 @@ std::string asst::IOHandlerWin32::read(unsigned timeout_sec)
     OVERLAPPED pipeov { .hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr) };
     std::ignore = ReadFile(m_read, pipe_buffer.get(), PipeBufferSize, nullptr, &pipeov);
 
+    DWORD len = 0;
     while (true) {
         if (!check_timeout(start_time)) {
             CancelIoEx(m_read, &pipeov);
             Log.error("read timeout");
+            len = 0;
             break;
         }
-        DWORD len = 0;
         if (GetOverlappedResult(m_read, &pipeov, &len, FALSE)) {
             break;
         }
     }
 
-    return pipe_buffer.get();
+    // 按实际长度构造，流式截图读到的是二进制数据，不能当作 C 字符串截断
+    return std::string(pipe_buffer.get(), len);
 }
 
 bool asst::IOHandlerWin32::write(std::string_view data)
@@ -11,6 +11,7 @@
 #include "Utils/ImageIo.hpp"
 #include "Utils/Logger.hpp"
 #include "Utils/NoWarningCV.h"
+#include "Vision/Battle/AvatarIndex.h"
 #include "Vision/Battle/BattlefieldClassifier.h"
 #include "Vision/Battle/BattlefieldMatcher.h"
 #include "Vision/BestMatcher.h"
@@ -129,7 +130,56 @@ bool asst::BattleHelper::update_deployment(bool init, const cv::Mat& reusable)
     auto& cur_opers = oper_result_opt->deployment;
     std::vector<DeploymentOper> unknown_opers;
 
-    for (auto& oper : cur_opers) {
+    static const double avatar_threshold = Task.get<MatchTaskInfo>("BattleAvatarData")->templ_thresholds.front();
+    static const double drone_avatar_threshold =
+        Task.get<MatchTaskInfo>("BattleDroneAvatarData")->templ_thresholds.front();
+
+    // 非冷却中的干员按职业分组，用预处理好的头像索引一次性识别整个部署栏。
+    // 冷却中的头像要以自身做掩码匹配，以及尺寸对不上的，还是走下面逐个模板匹配的流程
+    std::vector<std::optional<AvatarIndex::ResultOpt>> indexed_results(cur_opers.size());
+    {
+        std::unordered_map<Role, std::vector<size_t>> role_opers;
+        for (size_t i = 0; i < cur_opers.size(); ++i) {
+            if (!cur_opers[i].cooling) {
+                role_opers[cur_opers[i].role].emplace_back(i);
+            }
+        }
+        for (const auto& [role, oper_indexes] : role_opers) {
+            auto avatar_index = AvatarCache.get_avatar_index(role);
+            std::vector<size_t> accepted;
+            std::vector<cv::Mat> avatars;
+            for (size_t i : oper_indexes) {
+                if (avatar_index->accepts(cur_opers[i].avatar)) {
+                    accepted.emplace_back(i);
+                    avatars.emplace_back(cur_opers[i].avatar);
+                }
+            }
+            if (avatars.empty()) {
+                continue;
+            }
+            double threshold = role == Role::Drone ? drone_avatar_threshold : avatar_threshold;
+            auto results = avatar_index->match(avatars, threshold);
+            for (size_t j = 0; j < accepted.size(); ++j) {
+                indexed_results[accepted[j]] = std::move(results[j]);
+            }
+        }
+    }
+
+    for (size_t oper_index = 0; oper_index < cur_opers.size(); ++oper_index) {
+        auto& oper = cur_opers[oper_index];
+        if (const auto& indexed = indexed_results[oper_index]) {
+            if (*indexed) {
+                set_oper_name(oper, (*indexed)->name);
+                remove_cooling_from_battlefield(oper);
+            }
+            else {
+                Log.info("unknown oper", oper.index);
+                unknown_opers.emplace_back(oper);
+            }
+            m_cur_deployment_opers.emplace_back(oper);
+            continue;
+        }
+
         BestMatcher avatar_analyzer(oper.avatar);
         if (oper.cooling) {
             Log.trace("start matching cooling", oper.index);
@@ -140,10 +190,7 @@ bool asst::BattleHelper::update_deployment(bool init, const cv::Mat& reusable)
             avatar_analyzer.set_mask_range(cooling_mask_range.first, cooling_mask_range.second, true, true);
         }
         else {
-            static const double threshold = Task.get<MatchTaskInfo>("BattleAvatarData")->templ_thresholds.front();
-            static const double drone_threshold =
-                Task.get<MatchTaskInfo>("BattleDroneAvatarData")->templ_thresholds.front();
-            avatar_analyzer.set_threshold(oper.role == Role::Drone ? drone_threshold : threshold);
+            avatar_analyzer.set_threshold(oper.role == Role::Drone ? drone_avatar_threshold : avatar_threshold);
         }
 
         auto& avatar_cache = AvatarCache.get_avatars(oper.role);
@@ -476,19 +523,44 @@ bool asst::BattleHelper::do_strategic_action(const cv::Mat& reusable)
 
 bool asst::BattleHelper::use_all_ready_skill(const cv::Mat& reusable)
 {
-    bool used = false;
     cv::Mat image = reusable.empty() ? m_inst_helper.ctrler()->get_image() : reusable;
+
+    std::vector<std::string> candidates;
+    std::vector<Point> base_points;
     for (const auto& [name, loc] : m_battlefield_opers) {
-        auto& usage = m_skill_usage[name];
-        auto& retry = m_skill_error_count[name];
-        auto& times = m_skill_times[name];
+        auto usage = m_skill_usage[name];
         if (usage != SkillUsage::Possibly && usage != SkillUsage::Times) {
             continue;
         }
-        bool has_error = false;
-        if (!check_and_use_skill(loc, has_error, image)) {
+        auto target_iter = m_normal_tile_info.find(loc);
+        if (target_iter == m_normal_tile_info.end()) {
+            Log.error("No loc", loc);
             continue;
         }
+        candidates.emplace_back(name);
+        base_points.emplace_back(target_iter->second.pos);
+    }
+    if (candidates.empty()) {
+        return false;
+    }
+
+    // 所有干员的技能一次推理识别完，用掉某个技能不影响其他干员的识别结果
+    BattlefieldClassifier skill_analyzer(image);
+    skill_analyzer.set_object_of_interest({ .skill_ready = true });
+    skill_analyzer.set_base_points(std::move(base_points));
+    auto results = skill_analyzer.analyze_batch();
+
+    bool used = false;
+    for (size_t i = 0; i < candidates.size() && i < results.size(); ++i) {
+        if (!results[i].skill_ready.ready) {
+            continue;
+        }
+        const std::string& name = candidates[i];
+        auto& usage = m_skill_usage[name];
+        auto& retry = m_skill_error_count[name];
+        auto& times = m_skill_times[name];
+
+        bool has_error = !use_skill(m_battlefield_opers.at(name), false);
         // 识别到了，但点进去发现没有。一般来说是识别错了
         if (has_error) {
             Log.warn("Skill", name, "is not ready");
@@ -506,7 +578,6 @@ bool asst::BattleHelper::use_all_ready_skill(const cv::Mat& reusable)
             times--;
             if (times == 0) usage = SkillUsage::TimesUsed;
         }
-        image = m_inst_helper.ctrler()->get_image();
     }
 
     return used;
@@ -7,6 +7,7 @@
 #include "Utils/Logger.hpp"
 #include "Utils/NoWarningCV.h"
 #include "Utils/Ranges.hpp"
+#include "Utils/WorkerPool.hpp"
 #include "Vision/Battle/BattleFormationAnalyzer.h"
 #include "Vision/Battle/BattlefieldClassifier.h"
 #include "Vision/Battle/BattlefieldDetector.h"
@@ -47,6 +48,7 @@ bool asst::CombatRecordRecognitionTask::_run()
     m_video_frame_count = static_cast<size_t>(m_video_ptr->get(cv::CAP_PROP_FRAME_COUNT));
     m_battle_start_frame = 0;
     m_scale = WindowHeightDefault / m_video_ptr->get(cv::CAP_PROP_FRAME_HEIGHT);
+    m_reader = std::make_unique<VideoFrameReader>(m_video_ptr, m_scale);
 
 #ifdef ASST_DEBUG
     cv::namedWindow(DrawWindow, cv::WINDOW_AUTOSIZE);
@@ -72,6 +74,18 @@ bool asst::CombatRecordRecognitionTask::_run()
         return false;
     }
 
+    // 各片段的干员检测互不依赖，先一起做完；后面的步骤要用到前一个片段的结果，只能按顺序来
+    std::vector<ClipInfo*> det_clips;
+    for (auto iter = m_clips.begin(); iter != m_clips.end(); ++iter) {
+        if (iter->deployment_changed || iter == m_clips.begin()) {
+            det_clips.emplace_back(&*iter);
+        }
+    }
+    if (!detect_operators(det_clips)) {
+        Log.error(__FUNCTION__, "failed to detect operators");
+        return false;
+    }
+
     ClipInfo* pre_valid = nullptr;
     for (auto iter = m_clips.begin(); iter != m_clips.end(); ++iter) {
         auto& clip = *iter;
@@ -87,6 +101,7 @@ bool asst::CombatRecordRecognitionTask::_run()
         }
         pre_valid = &clip;
     }
+    m_reader->stop();
 
     Log.info("full copilot json", m_copilot_json.to_string());
 
@@ -118,17 +133,16 @@ bool asst::CombatRecordRecognitionTask::analyze_formation()
 
     BattleFormationAnalyzer formation_ananlyzer;
     int no_changes_count = 0;
-    for (size_t i = 0; i < m_video_frame_count; i += skip_frames(skip_count) + 1) {
-        cv::Mat frame;
-        *m_video_ptr >> frame;
+    m_reader->start(0, skip_count + 1, m_video_frame_count);
+    while (auto frame_opt = m_reader->next()) {
+        const size_t i = frame_opt->index;
+        const cv::Mat& frame = frame_opt->image;
         if (frame.empty()) {
             Log.error(i, "frame is empty");
             callback(AsstMsg::SubTaskError, basic_info_with_what("OcrFormation"));
             return false;
         }
 
-        cv::resize(frame, frame, cv::Size(), m_scale, m_scale, cv::INTER_AREA);
-
         formation_ananlyzer.set_image(frame);
         auto formation_opt = formation_ananlyzer.analyze();
         show_img(formation_ananlyzer);
@@ -176,17 +190,16 @@ bool asst::CombatRecordRecognitionTask::analyze_stage()
     const auto stage_name_task_ptr = Task.get("BattleStageName");
     const int skip_count = m_video_fps > m_stage_ocr_fps ? static_cast<int>(m_video_fps / m_stage_ocr_fps) - 1 : 0;
 
-    for (size_t i = m_formation_end_frame; i < m_video_frame_count; i += skip_frames(skip_count) + 1) {
-        cv::Mat frame;
-        *m_video_ptr >> frame;
+    m_reader->start(m_formation_end_frame + 1, skip_count + 1, m_video_frame_count);
+    while (auto frame_opt = m_reader->next()) {
+        const size_t i = frame_opt->index;
+        const cv::Mat& frame = frame_opt->image;
         if (frame.empty()) {
             Log.error(i, "frame is empty");
             callback(AsstMsg::SubTaskError, basic_info_with_what("OcrStage"));
             return false;
         }
 
-        cv::resize(frame, frame, cv::Size(), m_scale, m_scale, cv::INTER_AREA);
-
         RegionOCRer stage_analyzer(frame);
         stage_analyzer.set_task_info(stage_name_task_ptr);
         bool analyzed = stage_analyzer.analyze().has_value();
@@ -241,17 +254,16 @@ bool asst::CombatRecordRecognitionTask::analyze_deployment()
     oper_analyzer.set_object_of_interest({ .deployment = true });
 
     std::vector<battle::DeploymentOper> deployment;
-    for (size_t i = m_stage_ocr_end_frame; i < m_video_frame_count; i += skip_frames(skip_count) + 1) {
-        cv::Mat frame;
-        *m_video_ptr >> frame;
+    m_reader->start(m_stage_ocr_end_frame + 1, skip_count + 1, m_video_frame_count);
+    while (auto frame_opt = m_reader->next()) {
+        const size_t i = frame_opt->index;
+        const cv::Mat& frame = frame_opt->image;
         if (frame.empty()) {
             Log.error(i, "frame is empty");
             callback(AsstMsg::SubTaskError, basic_info_with_what("MatchDeployment"));
             return false;
         }
 
-        cv::resize(frame, frame, cv::Size(), m_scale, m_scale, cv::INTER_AREA);
-
         oper_analyzer.set_image(frame);
         auto oper_result_opt = oper_analyzer.analyze();
         bool analyzed = oper_result_opt && oper_result_opt->pause_button;
@@ -342,17 +354,17 @@ bool asst::CombatRecordRecognitionTask::slice_video()
         pre_clip.end_frame = pre_frame;
         in_segment = false;
     };
-    for (; i < ends; i += skip_frames(skip_count) + 1, pre_frame = frame) {
-        cv::Mat temp;
-        // 这里如果不用temp，frame的所有权会出错
-        *m_video_ptr >> temp;
-        frame = temp;
+    bool interrupted = false;
+    m_reader->start(m_battle_start_frame, skip_count + 1, ends);
+    for (auto frame_opt = m_reader->next(); frame_opt; pre_frame = frame, frame_opt = m_reader->next()) {
+        i = frame_opt->index;
+        frame = frame_opt->image;
         if (frame.empty()) {
             Log.warn(i, "frame is empty");
             battle_over();
+            interrupted = true;
             break;
         }
-        cv::resize(frame, frame, cv::Size(), m_scale, m_scale, cv::INTER_AREA);
 
         BattlefieldMatcher analyzer(frame);
         analyzer.set_object_of_interest({
@@ -368,6 +380,7 @@ bool asst::CombatRecordRecognitionTask::slice_video()
         if (!result_opt) {
             battle_over();
             if (++not_in_battle_count > 10) {
+                interrupted = true;
                 break;
             }
             continue;
@@ -434,6 +447,10 @@ bool asst::CombatRecordRecognitionTask::slice_video()
             in_segment = true;
         }
     }
+    if (!interrupted) {
+        // 正常取完时按原来的步进停在最后一帧之后
+        i += skip_count + 1;
+    }
     battle_over();
 
     if (m_clips.empty()) {
@@ -477,7 +494,7 @@ bool asst::CombatRecordRecognitionTask::slice_video()
         iter->deployment_changed = deployment_changed;
         ++iter;
     }
-    m_video_ptr->set(cv::CAP_PROP_POS_FRAMES, static_cast<double>(m_battle_start_frame));
+    m_reader->stop();
 
     callback(AsstMsg::SubTaskCompleted, basic_info_with_what("Slice"));
     return true;
@@ -487,9 +504,7 @@ bool asst::CombatRecordRecognitionTask::analyze_clip(ClipInfo& clip, ClipInfo* p
 {
     LogTraceFunction;
 
-    if (!detect_operators(clip, pre_clip_ptr)) {
-        return false;
-    }
+    // 干员检测已经在 detect_operators 里对所有片段统一做过了
     if (!classify_direction(clip, pre_clip_ptr)) {
         return false;
     }
@@ -528,17 +543,13 @@ bool asst::CombatRecordRecognitionTask::compare_skill(ClipInfo& clip, ClipInfo&
         Log.warn("skip too much");
         cls_begin = clip.start_frame_index + (clip.end_frame_index - clip.start_frame_index) / 2;
     }
-    const size_t begin_skip = cls_begin - static_cast<size_t>(m_video_ptr->get(cv::CAP_PROP_POS_FRAMES));
-    skip_frames(begin_skip);
 
-    cv::Mat frame;
-    *m_video_ptr >> frame;
+    cv::Mat frame = m_reader->read_at(cls_begin);
     if (frame.empty()) {
         Log.error("frame is empty");
         callback(AsstMsg::SubTaskError, basic_info_with_what("CompSkill"));
         return false;
     }
-    cv::resize(frame, frame, cv::Size(), m_scale, m_scale, cv::INTER_AREA);
     analyzer.set_image(frame);
     bool cur_ready = analyzer.analyze()->skill_ready.ready;
 
@@ -558,74 +569,114 @@ bool asst::CombatRecordRecognitionTask::compare_skill(ClipInfo& clip, ClipInfo&
     return true;
 }
 
-bool asst::CombatRecordRecognitionTask::detect_operators(ClipInfo& clip, [[maybe_unused]] ClipInfo* pre_clip_ptr)
+bool asst::CombatRecordRecognitionTask::detect_operators(const std::vector<ClipInfo*>& clips)
 {
     LogTraceFunction;
 
-    callback(AsstMsg::SubTaskStart, basic_info_with_what("DetectOperators"));
-
-    const size_t frame_count = clip.end_frame_index - clip.start_frame_index;
-
     /* detect operators on the battefield */
     using DetectionResult = std::unordered_set<Point>;
-    std::unordered_map<DetectionResult, size_t, ContainerHasher<DetectionResult>> oper_det_samping;
+    struct DetectionSample
+    {
+        DetectionResult locations;
+        cv::Mat draw;
+    };
     const Rect det_box_move = Task.get("BattleOperBoxRectMove")->rect_move;
 
     constexpr size_t OperDetSamplingCount = 20;
-    const size_t skip_count =
-        frame_count > (OperDetSamplingCount + 1) ? frame_count / (OperDetSamplingCount + 1) - 1 : 0;
-
-    const size_t det_begin = clip.start_frame_index + skip_count;
-    const size_t det_end = clip.end_frame_index - skip_count;
 
-    const size_t begin_skip = det_begin - static_cast<size_t>(m_video_ptr->get(cv::CAP_PROP_POS_FRAMES));
-    skip_frames(begin_skip);
-
-    for (size_t i = det_begin; i <= det_end; i += skip_frames(skip_count) + 1) {
-        cv::Mat frame;
-        *m_video_ptr >> frame;
-        if (frame.empty()) {
-            Log.error(i, "frame is empty");
-            callback(AsstMsg::SubTaskError, basic_info_with_what("DetectOperators"));
-            return false;
+    // 解码在 m_reader 的线程里按顺序进行，检测交给线程池，所有片段的帧一起排队
+    auto& pool = WorkerPool::get_instance();
+    std::vector<std::vector<std::future<DetectionSample>>> clip_samples(clips.size());
+    // 提前返回前要等已经提交的检测跑完，它们还引用着 this
+    auto wait_all = [&]() {
+        for (auto& futures : clip_samples) {
+            for (auto& future : futures) {
+                if (future.valid()) {
+                    std::ignore = pool.wait(future);
+                }
+            }
         }
-
-        cv::resize(frame, frame, cv::Size(), m_scale, m_scale, cv::INTER_AREA);
-        BattlefieldDetector analyzer(frame);
-        analyzer.set_object_of_interest({ .operators = true });
-        auto result_opt = analyzer.analyze();
-        show_img(analyzer);
-
-        DetectionResult cur_locations;
-        auto tiles = m_normal_tile_info | views::values;
-        for (const auto& box : result_opt->operators) {
-            Rect rect = box.rect.move(det_box_move);
-            auto iter = ranges::find_if(tiles, [&](const TilePack::TileInfo& t) { return rect.include(t.pos); });
-            if (iter == tiles.end()) {
-                Log.warn(i, __FUNCTION__, "no pos", box.rect.to_string(), rect);
-                continue;
+    };
+    bool decoded = true;
+    for (size_t c = 0; c < clips.size() && decoded; ++c) {
+        ClipInfo& clip = *clips[c];
+        const size_t frame_count = clip.end_frame_index - clip.start_frame_index;
+        const size_t skip_count =
+            frame_count > (OperDetSamplingCount + 1) ? frame_count / (OperDetSamplingCount + 1) - 1 : 0;
+
+        const size_t det_begin = clip.start_frame_index + skip_count;
+        const size_t det_end = clip.end_frame_index - skip_count;
+
+        m_reader->start(det_begin, skip_count + 1, det_end + 1);
+        while (auto frame_opt = m_reader->next()) {
+            const size_t i = frame_opt->index;
+            const cv::Mat& frame = frame_opt->image;
+            if (frame.empty()) {
+                Log.error(i, "frame is empty");
+                decoded = false;
+                break;
             }
-            cur_locations.emplace((*iter).loc);
+            clip.random_frames.emplace_back(frame); // for classify_direction
+
+            clip_samples[c].emplace_back(pool.submit([this, frame, i, det_box_move]() {
+                BattlefieldDetector analyzer(frame);
+                analyzer.set_object_of_interest({ .operators = true });
+                auto result_opt = analyzer.analyze();
+
+                DetectionSample sample;
+                auto tiles = m_normal_tile_info | views::values;
+                for (const auto& box : result_opt->operators) {
+                    Rect rect = box.rect.move(det_box_move);
+                    auto iter =
+                        ranges::find_if(tiles, [&](const TilePack::TileInfo& t) { return rect.include(t.pos); });
+                    if (iter == tiles.end()) {
+                        Log.warn(i, "detect_operators", "no pos", box.rect.to_string(), rect);
+                        continue;
+                    }
+                    sample.locations.emplace((*iter).loc);
+                }
+#ifdef ASST_DEBUG
+                sample.draw = analyzer.get_draw();
+#endif
+                return sample;
+            }));
         }
-        oper_det_samping[std::move(cur_locations)] += 1;
-
-        clip.random_frames.emplace_back(frame); // for classify_direction
     }
+    m_reader->stop();
 
-    /* 取众数 */
-    auto oper_det_iter = ranges::max_element(oper_det_samping,
-                                             [&](const auto& lhs, const auto& rhs) { return lhs.second < rhs.second; });
-    if (oper_det_iter == oper_det_samping.end()) {
-        Log.error(__FUNCTION__, "oper_det_samping is empty");
+    if (!decoded) {
+        wait_all();
         callback(AsstMsg::SubTaskError, basic_info_with_what("DetectOperators"));
         return false;
     }
 
-    for (const Point& loc : oper_det_iter->first) {
-        clip.battlefield.emplace(loc, BattlefieldOper {});
-    }
+    for (size_t c = 0; c < clips.size(); ++c) {
+        ClipInfo& clip = *clips[c];
+        callback(AsstMsg::SubTaskStart, basic_info_with_what("DetectOperators"));
 
-    callback(AsstMsg::SubTaskCompleted, basic_info_with_what("DetectOperators"));
+        std::unordered_map<DetectionResult, size_t, ContainerHasher<DetectionResult>> oper_det_samping;
+        for (auto& future : clip_samples[c]) {
+            DetectionSample sample = pool.wait(future);
+            show_img(sample.draw);
+            oper_det_samping[std::move(sample.locations)] += 1;
+        }
+
+        /* 取众数 */
+        auto oper_det_iter = ranges::max_element(
+            oper_det_samping, [&](const auto& lhs, const auto& rhs) { return lhs.second < rhs.second; });
+        if (oper_det_iter == oper_det_samping.end()) {
+            Log.error(__FUNCTION__, "oper_det_samping is empty");
+            wait_all();
+            callback(AsstMsg::SubTaskError, basic_info_with_what("DetectOperators"));
+            return false;
+        }
+
+        for (const Point& loc : oper_det_iter->first) {
+            clip.battlefield.emplace(loc, BattlefieldOper {});
+        }
+
+        callback(AsstMsg::SubTaskCompleted, basic_info_with_what("DetectOperators"));
+    }
     return true;
 }
 
@@ -656,15 +707,19 @@ bool asst::CombatRecordRecognitionTask::classify_direction(ClipInfo& clip, ClipI
     constexpr size_t ClsSize = BattlefieldClassifier::DeployDirectionResult::ClsSize;
     std::unordered_map<Point, Raw> dir_cls_sampling;
 
+    std::vector<Point> base_points;
+    for (const auto& loc : newcomer) {
+        base_points.emplace_back(m_normal_tile_info.at(loc).pos);
+    }
     for (const cv::Mat& frame : clip.random_frames) {
         BattlefieldClassifier analyzer(frame);
         analyzer.set_object_of_interest({ .skill_ready = false, .deploy_direction = true });
-        for (const auto& loc : newcomer) {
-            analyzer.set_base_point(m_normal_tile_info.at(loc).pos);
-            auto result_opt = analyzer.analyze();
-            show_img(analyzer);
-            for (size_t i = 0; i < ClsSize; ++i) {
-                dir_cls_sampling[loc][i] += result_opt->deploy_direction.raw[i];
+        analyzer.set_base_points(base_points);
+        auto results = analyzer.analyze_batch();
+        show_img(analyzer);
+        for (size_t i = 0; i < newcomer.size() && i < results.size(); ++i) {
+            for (size_t j = 0; j < ClsSize; ++j) {
+                dir_cls_sampling[newcomer[i]][j] += results[i].deploy_direction.raw[j];
             }
         }
     }
@@ -852,15 +907,6 @@ json::object asst::CombatRecordRecognitionTask::analyze_action_condition(ClipInf
     return condition;
 }
 
-size_t asst::CombatRecordRecognitionTask::skip_frames(size_t count)
-{
-    for (size_t i = 0; i < count; ++i) {
-        cv::Mat ignore;
-        *m_video_ptr >> ignore;
-    }
-    return count;
-}
-
 std::string asst::CombatRecordRecognitionTask::analyze_detail_page_oper_name(const cv::Mat& frame)
 {
     const auto& replace_task = Task.get<OcrTaskInfo>("CharsNameOcrReplace");
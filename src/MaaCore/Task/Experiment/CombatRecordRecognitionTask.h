@@ -5,6 +5,7 @@
 #include "Common/AsstBattleDef.h"
 #include "Common/AsstTypes.h"
 #include "Config/Miscellaneous/TilePack.h"
+#include "VideoFrameReader.h"
 
 #include <meojson/json.hpp>
 
@@ -56,18 +57,18 @@ namespace asst
         bool compare_skill(ClipInfo& clip, ClipInfo& pre_clip);
 
         bool analyze_clip(ClipInfo& clip, ClipInfo* pre_clip_ptr);
-        bool detect_operators(ClipInfo& clip, ClipInfo* pre_clip_ptr);
+        bool detect_operators(const std::vector<ClipInfo*>& clips);
         bool classify_direction(ClipInfo& clip, ClipInfo* pre_clip_ptr);
         bool process_changes(ClipInfo& clip, ClipInfo* pre_clip_ptr);
         void ananlyze_deployment_names(ClipInfo& clip);
 
         json::object analyze_action_condition(ClipInfo& clip, ClipInfo* pre_clip_ptr);
-        size_t skip_frames(size_t count);
 
         static std::string analyze_detail_page_oper_name(const cv::Mat& frame);
 
         std::filesystem::path m_video_path;
         std::shared_ptr<cv::VideoCapture> m_video_ptr = nullptr;
+        std::unique_ptr<VideoFrameReader> m_reader = nullptr;
         std::string m_stage_name;
         double m_video_fps = 0;
         size_t m_video_frame_count = 0;
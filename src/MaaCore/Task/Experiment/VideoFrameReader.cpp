@@ -0,0 +1,139 @@
+#include "VideoFrameReader.h"
+
+#include <algorithm>
+
+#include "Utils/Logger.hpp"
+#include "Utils/NoWarningCV.h"
+
+asst::VideoFrameReader::VideoFrameReader(std::shared_ptr<cv::VideoCapture> video, double scale, size_t queue_limit)
+    : m_video(std::move(video)),
+      m_scale(scale),
+      m_queue_limit(std::max<size_t>(queue_limit, 1))
+{
+    m_position = static_cast<size_t>(m_video->get(cv::CAP_PROP_POS_FRAMES));
+}
+
+asst::VideoFrameReader::~VideoFrameReader()
+{
+    stop();
+}
+
+void asst::VideoFrameReader::start(size_t begin, size_t step, size_t end)
+{
+    stop();
+
+    m_finished = false;
+    m_decoder = std::thread(&VideoFrameReader::decode, this, begin, std::max<size_t>(step, 1), end);
+}
+
+std::optional<asst::VideoFrameReader::Frame> asst::VideoFrameReader::next()
+{
+    std::unique_lock lock(m_mutex);
+    m_cv.wait(lock, [&]() { return !m_queue.empty() || m_finished; });
+    if (m_queue.empty()) {
+        return std::nullopt;
+    }
+    Frame frame = std::move(m_queue.front());
+    m_queue.pop_front();
+    lock.unlock();
+
+    m_cv.notify_all();
+    return frame;
+}
+
+void asst::VideoFrameReader::stop()
+{
+    {
+        std::unique_lock lock(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+    if (m_decoder.joinable()) {
+        m_decoder.join();
+    }
+
+    std::unique_lock lock(m_mutex);
+    m_queue.clear();
+    m_finished = true;
+    m_stop = false;
+}
+
+cv::Mat asst::VideoFrameReader::read_at(size_t index)
+{
+    stop();
+
+    if (!seek(index)) {
+        return {};
+    }
+    return read_scaled();
+}
+
+bool asst::VideoFrameReader::seek(size_t index)
+{
+    if (index < m_position) {
+        // 往回走只能 set，往前走 grab 比 set 快也更准
+        if (!m_video->set(cv::CAP_PROP_POS_FRAMES, static_cast<double>(index))) {
+            Log.error(__FUNCTION__, "failed to seek to", index);
+            return false;
+        }
+        m_position = index;
+        return true;
+    }
+    for (; m_position < index; ++m_position) {
+        if (!m_video->grab()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+cv::Mat asst::VideoFrameReader::read_scaled()
+{
+    cv::Mat raw;
+    if (!m_video->read(raw) || raw.empty()) {
+        return {};
+    }
+    ++m_position;
+
+    cv::Mat frame;
+    cv::resize(raw, frame, cv::Size(), m_scale, m_scale, cv::INTER_AREA);
+    return frame;
+}
+
+void asst::VideoFrameReader::decode(size_t begin, size_t step, size_t end)
+{
+    for (size_t index = begin; index < end; index += step) {
+        {
+            std::unique_lock lock(m_mutex);
+            m_cv.wait(lock, [&]() { return m_queue.size() < m_queue_limit || m_stop; });
+            if (m_stop) {
+                break;
+            }
+        }
+
+        cv::Mat frame;
+        if (seek(index)) {
+            frame = read_scaled();
+        }
+        bool failed = frame.empty();
+        push(Frame { index, std::move(frame) });
+        if (failed) {
+            break;
+        }
+    }
+
+    {
+        std::unique_lock lock(m_mutex);
+        m_finished = true;
+    }
+    m_cv.notify_all();
+}
+
+void asst::VideoFrameReader::push(Frame frame)
+{
+    {
+        std::unique_lock lock(m_mutex);
+        m_queue.emplace_back(std::move(frame));
+    }
+    m_cv.notify_all();
+}
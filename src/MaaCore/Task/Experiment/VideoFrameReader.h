@@ -0,0 +1,64 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+#include "Utils/NoWarningCVMat.h"
+
+namespace cv
+{
+    class VideoCapture;
+}
+
+namespace asst
+{
+    // 在单独的线程里解码视频，按固定间隔取帧、缩放好后放进有界队列，识别线程直接取用。
+    // 被跳过的帧只 grab 不解码；帧号由这里自己维护，不依赖 CAP_PROP_POS_FRAMES
+    class VideoFrameReader
+    {
+    public:
+        struct Frame
+        {
+            size_t index = 0;
+            cv::Mat image; // 已缩放；读取失败时为空，之后不会再有帧
+        };
+
+    public:
+        VideoFrameReader(std::shared_ptr<cv::VideoCapture> video, double scale, size_t queue_limit = 8);
+        ~VideoFrameReader();
+
+        VideoFrameReader(const VideoFrameReader&) = delete;
+        VideoFrameReader& operator=(const VideoFrameReader&) = delete;
+
+        // 从 begin 开始每 step 帧取一帧，直到 end（不含）。上一次 start 没取完的帧会被丢弃
+        void start(size_t begin, size_t step, size_t end);
+        // 按顺序取下一帧，取完了返回 std::nullopt
+        std::optional<Frame> next();
+        void stop();
+
+        // 同步读取指定的一帧，会先停掉后台解码
+        cv::Mat read_at(size_t index);
+
+    private:
+        bool seek(size_t index);
+        cv::Mat read_scaled();
+        void decode(size_t begin, size_t step, size_t end);
+        void push(Frame frame);
+
+        std::shared_ptr<cv::VideoCapture> m_video;
+        double m_scale = 1.0;
+        size_t m_queue_limit = 0;
+        size_t m_position = 0; // 下一次 grab 得到的帧号，只在解码线程（或没有解码线程时的调用方）里访问
+
+        std::thread m_decoder;
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        std::deque<Frame> m_queue;
+        bool m_finished = true;
+        bool m_stop = false;
+    };
+} // namespace asst
@@ -13,9 +13,9 @@
 #include "Utils/Ranges.hpp"
 #include "Vision/Infrast/InfrastFacilityImageAnalyzer.h"
 #include "Vision/Infrast/InfrastOperImageAnalyzer.h"
+#include "Vision/BatchRegionOCRer.h"
 #include "Vision/Matcher.h"
 #include "Vision/OCRer.h"
-#include "Vision/RegionOCRer.h"
 
 asst::InfrastAbstractTask::InfrastAbstractTask(const AsstCallback& callback, Assistant* inst,
                                                std::string_view task_chain)
@@ -383,20 +383,17 @@ bool asst::InfrastAbstractTask::select_opers_review(infrast::CustomRoomConfig co
         return false;
     }
 
-    const auto& ocr_replace = Task.get<OcrTaskInfo>("CharsNameOcrReplace");
-    for (const auto& oper : oper_analyzer_res) {
-        RegionOCRer name_analyzer;
-        name_analyzer.set_replace(ocr_replace->replace_map, ocr_replace->replace_full);
-        name_analyzer.set_image(oper.name_img);
-        name_analyzer.set_bin_expansion(0);
-        if (!name_analyzer.analyze()) {
+    const auto oper_names = analyze_oper_names(oper_analyzer_res);
+    for (size_t i = 0; i < oper_analyzer_res.size(); ++i) {
+        const auto& oper = oper_analyzer_res.at(i);
+        if (!oper_names.at(i)) {
             continue;
         }
         if (!oper.selected) {
             break;
         }
 
-        const std::string& name = name_analyzer.get_result().text;
+        const std::string& name = oper_names.at(i)->text;
         if (auto iter = ranges::find(room_config.names, name); iter != room_config.names.end()) {
             Log.info(name, "在\"operators\"中，且已选中");
             room_config.names.erase(iter);
@@ -439,16 +436,14 @@ bool asst::InfrastAbstractTask::select_custom_opers(std::vector<std::string>& pa
     oper_analyzer.sort_by_loc();
     partial_result.clear();
 
-    const auto& ocr_replace = Task.get<OcrTaskInfo>("CharsNameOcrReplace");
-    for (const auto& oper : oper_analyzer.get_result()) {
-        RegionOCRer name_analyzer;
-        name_analyzer.set_replace(ocr_replace->replace_map, ocr_replace->replace_full);
-        name_analyzer.set_image(oper.name_img);
-        name_analyzer.set_bin_expansion(0);
-        if (!name_analyzer.analyze()) {
+    const auto& opers = oper_analyzer.get_result();
+    const auto oper_names = analyze_oper_names(opers);
+    for (size_t i = 0; i < opers.size(); ++i) {
+        const auto& oper = opers.at(i);
+        if (!oper_names.at(i)) {
             continue;
         }
-        const std::string& name = name_analyzer.get_result().text;
+        const std::string& name = oper_names.at(i)->text;
         partial_result.emplace_back(name);
 
         if (auto iter = ranges::find(room_config.names, name); iter != room_config.names.end()) {
@@ -490,18 +485,14 @@ bool asst::InfrastAbstractTask::get_opers(std::vector<std::string>& result, doub
     }
     oper_analyzer.sort_by_loc();
 
-    const auto& ocr_replace = Task.get<OcrTaskInfo>("CharsNameOcrReplace");
-    for (const auto& oper : oper_analyzer.get_result()) {
-        RegionOCRer name_analyzer;
-        name_analyzer.set_replace(ocr_replace->replace_map, ocr_replace->replace_full);
-        name_analyzer.set_image(oper.name_img);
-        name_analyzer.set_bin_expansion(0);
-        if (!name_analyzer.analyze()) {
+    const auto& opers = oper_analyzer.get_result();
+    auto oper_names = analyze_oper_names(opers);
+    for (size_t i = 0; i < opers.size(); ++i) {
+        if (!oper_names.at(i)) {
             continue;
         }
-        std::string name = name_analyzer.get_result().text;
-        if (oper.mood_ratio >= mood) {
-            result.emplace_back(std::move(name));
+        if (opers.at(i).mood_ratio >= mood) {
+            result.emplace_back(std::move(oper_names.at(i)->text));
         }
     }
     return true;
@@ -524,19 +515,16 @@ void asst::InfrastAbstractTask::order_opers_selection(const std::vector<std::str
         return;
     }
     oper_analyzer.sort_by_loc();
-    const auto& ocr_replace = Task.get<OcrTaskInfo>("CharsNameOcrReplace");
 
+    const auto& opers = oper_analyzer.get_result();
+    auto oper_names = analyze_oper_names(opers);
     std::vector<TextRect> page_result;
-    for (const auto& oper : oper_analyzer.get_result()) {
-        RegionOCRer name_analyzer;
-        name_analyzer.set_replace(ocr_replace->replace_map, ocr_replace->replace_full);
-        name_analyzer.set_image(oper.name_img);
-        name_analyzer.set_bin_expansion(0);
-        if (!name_analyzer.analyze()) {
+    for (size_t i = 0; i < opers.size(); ++i) {
+        if (!oper_names.at(i)) {
             continue;
         }
-        TextRect tr = name_analyzer.get_result();
-        tr.rect = oper.rect;
+        TextRect tr = std::move(*oper_names.at(i));
+        tr.rect = opers.at(i).rect;
         page_result.emplace_back(std::move(tr));
     }
 
@@ -552,6 +540,20 @@ void asst::InfrastAbstractTask::order_opers_selection(const std::vector<std::str
     sleep(500); // 此处刚刚选择了一位干员，因后续任务需截图识别，所以需要一个延迟，以保证后续截图选中状态无误
 }
 
+std::vector<std::optional<asst::TextRect>> asst::InfrastAbstractTask::analyze_oper_names(
+    const std::vector<infrast::Oper>& opers)
+{
+    const auto& ocr_replace = Task.get<OcrTaskInfo>("CharsNameOcrReplace");
+
+    BatchRegionOCRer name_analyzer;
+    name_analyzer.set_replace(ocr_replace->replace_map, ocr_replace->replace_full);
+    name_analyzer.set_bin_expansion(0);
+    for (const auto& oper : opers) {
+        name_analyzer.add_region(oper.name_img);
+    }
+    return name_analyzer.analyze();
+}
+
 void asst::InfrastAbstractTask::click_return_button()
 {
     LogTraceFunction;
@@ -56,6 +56,8 @@ namespace asst
         // 复核干员选择是否符合期望
         bool select_opers_review(infrast::CustomRoomConfig const& origin_room_config, size_t num_of_opers_expect = 0);
         void order_opers_selection(const std::vector<std::string>& names);
+        // 批量识别当前页干员名，结果与 opers 一一对应，没识别出来的为 std::nullopt
+        std::vector<std::optional<TextRect>> analyze_oper_names(const std::vector<infrast::Oper>& opers);
 
         virtual void click_return_button() override;
         // 点击进入设施后，左下角的tab（我也不知道这玩意该叫啥）
@@ -18,94 +18,63 @@
 namespace asst::recruit_calc
 {
     // all combinations and their operator list, excluding empty set and 6-star operators while there is no senior tag
-    auto get_all_combs(const std::vector<RecruitConfig::TagId>& tags,
-                       const std::vector<Recruitment>& all_ops = RecruitData.get_all_opers())
+    // the operator lists are precomputed by RecruitConfig, here we only look them up
+    auto get_all_combs(const std::vector<RecruitConfig::TagId>& tags)
     {
-        std::vector<RecruitCombs> rcs_with_single_tag;
+        const auto& comb_opers = RecruitData.get_comb_opers();
 
-        {
-            rcs_with_single_tag.reserve(tags.size());
-            ranges::transform(tags, std::back_inserter(rcs_with_single_tag), [](const RecruitConfig::TagId& t) {
-                RecruitCombs result;
-                result.tags = { t };
-                result.min_level = 6;
-                result.max_level = 0;
-                result.avg_level = 0;
-                return result;
-            });
-
-            for (const auto& op : all_ops) {
-                for (auto& rc : rcs_with_single_tag) {
-                    if (!op.has_tag(rc.tags.front())) continue;
-                    rc.opers.push_back(op);
-                    rc.min_level = (std::min)(rc.min_level, op.level);
-                    rc.max_level = (std::max)(rc.max_level, op.level);
-                    rc.avg_level += op.level;
-                }
-            }
-
-            for (auto& rc : rcs_with_single_tag) {
-                rc.avg_level /= static_cast<double>(rc.opers.size());
-                // intersection and union are based on sorted container
-                ranges::sort(rc.tags);
-                ranges::sort(rc.opers);
-            }
-        }
+        std::vector<RecruitConfig::TagMask> masks;
+        masks.reserve(tags.size());
+        ranges::transform(tags, std::back_inserter(masks),
+                          [](const RecruitConfig::TagId& t) { return RecruitData.get_tag_mask(t); });
 
         std::vector<RecruitCombs> result;
         const size_t tag_size = tags.size();
         result.reserve(tag_size * (tag_size * tag_size + 5) / 6); // C(size, 3) + C(size, 2) + C(size, 1)
 
-        // select one tag first
-        for (size_t i = 0; i < tag_size; ++i) {
-            RecruitCombs temp1 = rcs_with_single_tag[i];
-            if (temp1.opers.empty()) [[unlikely]] {
-                continue; // this is not possible
+        auto emplace_comb = [&](std::initializer_list<size_t> indexes) {
+            RecruitConfig::TagMask mask = 0;
+            for (size_t index : indexes) {
+                if (masks[index] == 0) [[unlikely]] {
+                    return; // unknown tag, no operator at all
+                }
+                mask |= masks[index];
+            }
+            const RecruitConfig::TagComb* comb = RecruitData.find_tag_comb(mask);
+            if (!comb) {
+                return;
             }
-            result.emplace_back(temp1); // that is it
 
-            // but what if another tag is also selected
-            for (size_t j = i + 1; j < tag_size; ++j) {
-                RecruitCombs temp2 = temp1 * rcs_with_single_tag[j];
-                if (temp2.opers.empty()) [[unlikely]] {
-                    continue;
+            RecruitCombs rc;
+            for (size_t index : indexes) {
+                rc.tags.emplace_back(tags[index]);
+            }
+            // intersection and union are based on sorted container
+            ranges::sort(rc.tags);
+            rc.tags.erase(std::unique(rc.tags.begin(), rc.tags.end()), rc.tags.end());
+
+            rc.opers.reserve(comb->opers.count());
+            for (size_t i = 0; i < comb_opers.size(); ++i) {
+                if (comb->opers[i]) {
+                    rc.opers.emplace_back(comb_opers[i]); // already sorted by level
                 }
-                result.emplace_back(temp2); // two tags only
+            }
+            rc.min_level = comb->min_level;
+            rc.max_level = comb->max_level;
+            rc.avg_level = comb->avg_level;
+            result.emplace_back(std::move(rc));
+        };
 
-                // select a third one
+        for (size_t i = 0; i < tag_size; ++i) {
+            emplace_comb({ i });
+            for (size_t j = i + 1; j < tag_size; ++j) {
+                emplace_comb({ i, j });
                 for (size_t k = j + 1; k < tag_size; ++k) {
-                    RecruitCombs temp3 = temp2 * rcs_with_single_tag[k];
-                    if (temp3.opers.empty()) [[unlikely]] {
-                        continue;
-                    }
-                    result.emplace_back(temp3);
+                    emplace_comb({ i, j, k });
                 }
             }
         }
 
-        static constexpr std::string_view SeniorOper = "高级资深干员";
-
-        for (auto comb_iter = result.begin(); comb_iter != result.end();) {
-            if (ranges::find(comb_iter->tags, RecruitConfig::TagId(SeniorOper)) != comb_iter->tags.end()) {
-                ++comb_iter;
-                continue;
-            }
-            // no senior tag, remove 6-star operators
-            // assuming sorted by level
-            auto iter = ranges::find_if(comb_iter->opers, [](const Recruitment& op) { return op.level >= 6; });
-            if (iter == comb_iter->opers.end()) {
-                ++comb_iter;
-                continue;
-            }
-            comb_iter->opers.erase(iter, comb_iter->opers.end());
-            if (comb_iter->opers.empty()) {
-                comb_iter = result.erase(comb_iter);
-                continue;
-            }
-            comb_iter->update_attributes();
-            ++comb_iter;
-        }
-
         return result;
     }
 } // namespace asst::recruit_calc
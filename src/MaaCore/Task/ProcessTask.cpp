@@ -40,6 +40,8 @@ bool asst::ProcessTask::run()
     }
 
     m_cur_task_name_list = m_raw_task_name_list;
+    // 两次 run 之间任务参数可能被插件等修改过，之前的结果不再可信
+    m_analyze_memo.clear();
     for (m_cur_retry = 0; m_cur_retry <= m_retry_times; ++m_cur_retry) {
         if (_run()) {
             return true;
@@ -122,15 +124,25 @@ bool ProcessTask::_run()
             m_cur_task_ptr = front_task_ptr;
         }
         else {
-            cv::Mat image = m_reusable.empty() ? ctrler()->get_image() : m_reusable;
+            cv::Mat image = m_reusable;
             m_reusable = cv::Mat();
+            if (image.empty()) {
+                // 上一步 task_delay 快结束时在后台预先截的图。截完之后又过了太久的（比如中间被别的事耽搁了）不用
+                constexpr auto PrefetchSlack = std::chrono::milliseconds(100);
+                auto prefetched = ctrler()->take_prefetched_image(ctrler()->screencap_latency() + PrefetchSlack);
+                image = prefetched ? std::move(*prefetched) : ctrler()->get_image();
+            }
             PipelineAnalyzer analyzer(image, Rect(), m_inst);
             analyzer.set_tasks(m_cur_task_name_list);
+            analyzer.set_memo(m_analyze_memo);
+            analyzer.set_parallel(Config.get_options().parallel_pipeline_analyze);
 
             auto res_opt = analyzer.analyze();
             if (!res_opt) {
                 return false;
             }
+            // 识别到了就要执行动作、回调插件，任务参数可能会被修改，清掉之前的记录
+            m_analyze_memo.clear();
             m_cur_task_ptr = res_opt->task_ptr;
             rect = res_opt->rect;
         }
@@ -270,12 +282,31 @@ bool ProcessTask::_run()
             return true;
         }
         m_cur_task_name_list = m_cur_task_ptr->next;
-        sleep(m_task_delay);
+        wait_task_delay();
     }
 
     return true;
 }
 
+void asst::ProcessTask::wait_task_delay()
+{
+    auto next_task_ptr = m_cur_task_name_list.empty() ? nullptr : Task.get(m_cur_task_name_list.front());
+    if (!Config.get_options().prefetch_screencap || m_task_delay <= 0 || !next_task_ptr ||
+        next_task_ptr->algorithm == AlgorithmType::JustReturn) {
+        sleep(m_task_delay);
+        return;
+    }
+
+    // task_delay 是留给游戏画面过渡的，期间画面还在变。
+    // 按最近一次截图的耗时提前开始截，让截完的时间差不多落在 task_delay 结束时，而不是一开始就截
+    const auto latency = static_cast<int>(std::min<int64_t>(ctrler()->screencap_latency().count(), m_task_delay));
+    if (!sleep(m_task_delay - latency)) {
+        return;
+    }
+    ctrler()->prefetch_image();
+    sleep(latency);
+}
+
 bool asst::ProcessTask::on_run_fails()
 {
     LogTraceFunction;
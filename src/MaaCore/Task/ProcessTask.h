@@ -3,6 +3,7 @@
 #include "AbstractTask.h"
 #include "Common/AsstTypes.h"
 #include "Utils/NoWarningCVMat.h"
+#include "Vision/Miscellaneous/PipelineAnalyzer.h"
 
 namespace asst
 {
@@ -46,6 +47,8 @@ namespace asst
 
         std::pair<int, TimesLimitType> calc_time_limit() const;
         int calc_post_delay() const;
+        // 等待 task_delay，下一张图在等待快结束时就开始截
+        void wait_task_delay();
 
         void exec_click_task(const Rect& matched_rect);
         void exec_swipe_task(const Rect& r1, const Rect& r2, int duration, bool extra_swipe, double slope_in,
@@ -62,5 +65,7 @@ namespace asst
         static constexpr int TaskDelayUnsetted = -1;
         int m_task_delay = TaskDelayUnsetted;
         cv::Mat m_reusable;
+        // 等待界面变化时画面往往不变，记下未识别到的任务，画面没变就不再重复识别
+        PipelineAnalyzer::Memo m_analyze_memo;
     };
 }
@@ -3,6 +3,7 @@
 #include "Utils/Ranges.hpp"
 #include <chrono>
 #include <future>
+#include <tuple>
 #include <vector>
 
 #include "Utils/NoWarningCV.h"
@@ -23,6 +24,29 @@
 using namespace asst::battle;
 using namespace asst::battle::roguelike;
 
+namespace
+{
+    using TileKey = asst::TilePack::TileKey;
+    // 战斗干员朝向的权重
+    const std::unordered_map<TileKey, int> TileKeyFightWeights = {
+        { TileKey::Invalid, 0 },    { TileKey::Forbidden, 0 },  { TileKey::Wall, 500 },
+        { TileKey::Road, 1000 },    { TileKey::Home, 500 },     { TileKey::EnemyHome, 1000 },
+        { TileKey::Airport, 1000 }, { TileKey::Floor, 1000 },   { TileKey::Hole, 0 },
+        { TileKey::Telin, 700 },    { TileKey::Telout, 800 },   { TileKey::Grass, 500 },
+        { TileKey::DeepSea, 1000 }, { TileKey::Volcano, 1000 }, { TileKey::Healing, 1000 },
+        { TileKey::Fence, 800 },
+    };
+    // 治疗干员朝向的权重
+    const std::unordered_map<TileKey, int> TileKeyMedicWeights = {
+        { TileKey::Invalid, 0 },  { TileKey::Forbidden, 0 },  { TileKey::Wall, 1000 },
+        { TileKey::Road, 1000 },  { TileKey::Home, 0 },       { TileKey::EnemyHome, 0 },
+        { TileKey::Airport, 0 },  { TileKey::Floor, 0 },      { TileKey::Hole, 0 },
+        { TileKey::Telin, 0 },    { TileKey::Telout, 0 },     { TileKey::Grass, 500 },
+        { TileKey::DeepSea, 0 },  { TileKey::Volcano, 1000 }, { TileKey::Healing, 1000 },
+        { TileKey::Fence, 1000 },
+    };
+}
+
 asst::RoguelikeBattleTaskPlugin::RoguelikeBattleTaskPlugin(const AsstCallback& callback, Assistant* inst,
                                                            std::string_view task_chain,
                                                            std::shared_ptr<RoguelikeConfig> roguelike_config_ptr)
@@ -209,6 +233,17 @@ bool asst::RoguelikeBattleTaskPlugin::calc_stage_info()
     }
     m_homes_status.resize(m_homes.size());
 
+    m_tile_grid_ready = m_tile_grid.build(m_normal_tile_info);
+    if (!m_tile_grid_ready) {
+        Log.warn("stage is wider than", RoguelikeTileGrid::MaxWidth, "tiles, fall back to point lists");
+    }
+    m_blacklist_layer = m_tile_grid.make_layer();
+    for (const Point& loc : m_blacklist_location) {
+        m_tile_grid.set(m_blacklist_layer, loc);
+    }
+    m_fight_weight_layers = m_tile_grid.make_weighted_layers(TileKeyFightWeights);
+    m_medic_weight_layers = m_tile_grid.make_weighted_layers(TileKeyMedicWeights);
+
     auto cb_info = basic_info_with_what("StageInfo");
     auto& details = cb_info["details"];
     details["name"] = m_stage_name;
@@ -781,6 +816,13 @@ void asst::RoguelikeBattleTaskPlugin::clear()
     m_deployed_time.clear();
 
     m_oper_elite.clear();
+
+    m_tile_grid.clear();
+    m_tile_grid_ready = false;
+    m_blacklist_layer.clear();
+    m_fight_weight_layers.clear();
+    m_medic_weight_layers.clear();
+    m_range_masks_cache.clear();
 }
 
 std::vector<asst::Point> asst::RoguelikeBattleTaskPlugin::available_locations(const DeploymentOper& oper) const
@@ -793,6 +835,33 @@ std::vector<asst::Point> asst::RoguelikeBattleTaskPlugin::available_locations(co
 }
 
 std::vector<asst::Point> asst::RoguelikeBattleTaskPlugin::available_locations(battle::LocationType type) const
+{
+    if (!m_tile_grid_ready) [[unlikely]] {
+        return available_locations_by_points(type);
+    }
+
+    using Layer = RoguelikeTileGrid::Layer;
+    const Layer& type_layer = m_tile_grid.buildable_layer(type);
+    const Layer& all_layer = m_tile_grid.buildable_layer(battle::LocationType::All);
+    const Layer& melee_layer = m_tile_grid.buildable_layer(battle::LocationType::Melee);
+    const Layer& ranged_layer = m_tile_grid.buildable_layer(battle::LocationType::Ranged);
+    // 水上要先放板子才能放人，肉鸽里也没板子，那就当作不可放置
+    const Layer& deep_sea_layer = m_tile_grid.key_layer(TilePack::TileKey::DeepSea);
+    const Layer used_layer = used_tiles_layer(false);
+
+    Layer candidates = m_tile_grid.make_layer();
+    for (size_t y = 0; y < candidates.size(); ++y) {
+        RoguelikeTileGrid::RowMask matched = type_layer[y] | all_layer[y];
+        if (type == battle::LocationType::All) {
+            matched |= melee_layer[y] | ranged_layer[y];
+        }
+        candidates[y] = matched & ~deep_sea_layer[y] & ~used_layer[y] & ~m_blacklist_layer[y];
+    }
+    return m_tile_grid.locations(candidates);
+}
+
+std::vector<asst::Point> asst::RoguelikeBattleTaskPlugin::available_locations_by_points(
+    battle::LocationType type) const
 {
     std::vector<Point> result;
     for (const auto& [loc, tile] : m_normal_tile_info) {
@@ -805,9 +874,25 @@ std::vector<asst::Point> asst::RoguelikeBattleTaskPlugin::available_locations(ba
             result.emplace_back(loc);
         }
     }
+    // 和位图的结果一样按行优先排列
+    ranges::sort(result, [](const Point& lhs, const Point& rhs) {
+        return std::tie(lhs.y, lhs.x) < std::tie(rhs.y, rhs.x);
+    });
     return result;
 }
 
+asst::RoguelikeTileGrid::Layer asst::RoguelikeBattleTaskPlugin::used_tiles_layer(bool exclude_drone) const
+{
+    auto layer = m_tile_grid.make_layer();
+    for (const auto& [loc, name] : m_used_tiles) {
+        if (exclude_drone && BattleData.get_role(name) == battle::Role::Drone) {
+            continue;
+        }
+        m_tile_grid.set(layer, loc);
+    }
+    return layer;
+}
+
 asst::battle::AttackRange asst::RoguelikeBattleTaskPlugin::get_attack_range(const battle::DeploymentOper& oper,
                                                                             DeployDirection direction) const
 {
@@ -867,6 +952,45 @@ asst::battle::AttackRange asst::RoguelikeBattleTaskPlugin::get_attack_range(cons
     return right_attack_range;
 }
 
+const asst::RoguelikeTileGrid::RangeMasks&
+    asst::RoguelikeBattleTaskPlugin::get_attack_range_masks(const battle::DeploymentOper& oper) const
+{
+    int64_t elite = 0;
+    if (m_oper_elite.contains(oper.name)) {
+        elite = m_oper_elite.at(oper.name);
+    }
+    std::string key = oper.name + "_" + std::to_string(elite);
+    if (auto iter = m_range_masks_cache.find(key); iter != m_range_masks_cache.end()) {
+        return iter->second;
+    }
+    auto masks = RoguelikeTileGrid::make_range_masks(get_attack_range(oper, DeployDirection::Right));
+    return m_range_masks_cache.emplace(std::move(key), std::move(masks)).first->second;
+}
+
+int asst::RoguelikeBattleTaskPlugin::range_score_by_points(Point loc, const battle::DeploymentOper& oper,
+                                                           DeployDirection direction) const
+{
+    int score = 0;
+    for (const Point& relative_pos : get_attack_range(oper, direction)) {
+        Point absolute_pos = loc + relative_pos;
+        switch (oper.role) {
+        case battle::Role::Medic:
+            if (auto iter = m_used_tiles.find(absolute_pos);
+                iter != m_used_tiles.cend() &&
+                BattleData.get_role(iter->second) != battle::Role::Drone) // 根据哪个方向上人多决定朝向哪
+                score += 10000;
+            if (auto iter = m_side_tile_info.find(absolute_pos); iter != m_side_tile_info.end())
+                score += TileKeyMedicWeights.at(iter->second.key);
+            break;
+        default:
+            if (auto iter = m_side_tile_info.find(absolute_pos); iter != m_side_tile_info.end())
+                score += TileKeyFightWeights.at(iter->second.key);
+            break;
+        }
+    }
+    return score;
+}
+
 std::optional<asst::RoguelikeBattleTaskPlugin::DeployInfo> asst::RoguelikeBattleTaskPlugin::calc_best_loc(
     const battle::DeploymentOper& oper) const
 {
@@ -904,10 +1028,17 @@ std::optional<asst::RoguelikeBattleTaskPlugin::DeployInfo> asst::RoguelikeBattle
     const auto& near_loc = available_loc.front();
     int min_dist = std::abs(near_loc.x - home.location.x) + std::abs(near_loc.y - home.location.y);
 
+    // 治疗干员要朝向人多的方向，场上的干员（不算无人机）每次选点只统计一次
+    RoguelikeTileGrid::Layer medic_targets;
+    if (oper.role == battle::Role::Medic) {
+        medic_targets = used_tiles_layer(true);
+    }
+
     // 取距离最近的N个点，计算分数。然后使用得分最高的点
     constexpr int CalcPointCount = 4;
     for (const auto& loc : available_loc | views::take(CalcPointCount)) {
-        const auto& [cur_direction, cur_socre] = calc_best_direction_and_score(loc, oper, home.direction);
+        const auto& [cur_direction, cur_socre] =
+            calc_best_direction_and_score(loc, oper, home.direction, medic_targets);
         // 离得远的要扣分
         constexpr int DistWeights = -1050;
         int extra_dist = std::abs(loc.x - home.location.x) + std::abs(loc.y - home.location.y) - min_dist;
@@ -934,7 +1065,8 @@ std::optional<asst::RoguelikeBattleTaskPlugin::DeployInfo> asst::RoguelikeBattle
 }
 
 asst::RoguelikeBattleTaskPlugin::DirectionAndScore asst::RoguelikeBattleTaskPlugin::calc_best_direction_and_score(
-    Point loc, const battle::DeploymentOper& oper, DeployDirection recommended_direction) const
+    Point loc, const battle::DeploymentOper& oper, DeployDirection recommended_direction,
+    const RoguelikeTileGrid::Layer& medic_targets) const
 {
     LogTraceFunction;
 
@@ -990,45 +1122,24 @@ asst::RoguelikeBattleTaskPlugin::DirectionAndScore asst::RoguelikeBattleTaskPlug
     int max_score = 0;
     DeployDirection best_direction = DeployDirection::None;
 
-    for (auto direction :
-         { DeployDirection::Right, DeployDirection::Up, DeployDirection::Left, DeployDirection::Down }) {
+    constexpr std::array<DeployDirection, 4> Directions = { DeployDirection::Right, DeployDirection::Up,
+                                                            DeployDirection::Left, DeployDirection::Down };
+    for (size_t i = 0; i < Directions.size(); ++i) {
+        const DeployDirection direction = Directions[i];
         int score = 0;
-        // 按朝右算，后面根据方向做转换
-        for (const Point& relative_pos : get_attack_range(oper, direction)) {
-            Point absolute_pos = loc + relative_pos;
-
-            using TileKey = TilePack::TileKey;
-            // 战斗干员朝向的权重
-            static const std::unordered_map<TileKey, int> TileKeyFightWeights = {
-                { TileKey::Invalid, 0 },    { TileKey::Forbidden, 0 },  { TileKey::Wall, 500 },
-                { TileKey::Road, 1000 },    { TileKey::Home, 500 },     { TileKey::EnemyHome, 1000 },
-                { TileKey::Airport, 1000 }, { TileKey::Floor, 1000 },   { TileKey::Hole, 0 },
-                { TileKey::Telin, 700 },    { TileKey::Telout, 800 },   { TileKey::Grass, 500 },
-                { TileKey::DeepSea, 1000 }, { TileKey::Volcano, 1000 }, { TileKey::Healing, 1000 },
-                { TileKey::Fence, 800 },
-            };
-            // 治疗干员朝向的权重
-            static const std::unordered_map<TileKey, int> TileKeyMedicWeights = {
-                { TileKey::Invalid, 0 },  { TileKey::Forbidden, 0 },  { TileKey::Wall, 1000 },
-                { TileKey::Road, 1000 },  { TileKey::Home, 0 },       { TileKey::EnemyHome, 0 },
-                { TileKey::Airport, 0 },  { TileKey::Floor, 0 },      { TileKey::Hole, 0 },
-                { TileKey::Telin, 0 },    { TileKey::Telout, 0 },     { TileKey::Grass, 500 },
-                { TileKey::DeepSea, 0 },  { TileKey::Volcano, 1000 }, { TileKey::Healing, 1000 },
-                { TileKey::Fence, 1000 },
-            };
-
+        if (!m_tile_grid_ready) [[unlikely]] {
+            score = range_score_by_points(loc, oper, direction);
+        }
+        else {
+            const auto& range = get_attack_range_masks(oper)[i];
             switch (oper.role) {
             case battle::Role::Medic:
-                if (auto iter = m_used_tiles.find(absolute_pos);
-                    iter != m_used_tiles.cend() &&
-                    BattleData.get_role(iter->second) != battle::Role::Drone) // 根据哪个方向上人多决定朝向哪
-                    score += 10000;
-                if (auto iter = m_side_tile_info.find(absolute_pos); iter != m_side_tile_info.end())
-                    score += TileKeyMedicWeights.at(iter->second.key);
+                // 根据哪个方向上人多决定朝向哪
+                score += 10000 * m_tile_grid.count(range, loc, medic_targets);
+                score += m_tile_grid.score(range, loc, m_medic_weight_layers);
                 break;
             default:
-                if (auto iter = m_side_tile_info.find(absolute_pos); iter != m_side_tile_info.end())
-                    score += TileKeyFightWeights.at(iter->second.key);
+                score += m_tile_grid.score(range, loc, m_fight_weight_layers);
                 break;
             }
         }
@@ -7,6 +7,7 @@
 #include "Common/AsstBattleDef.h"
 #include "Common/AsstTypes.h"
 #include "Config/Miscellaneous/TilePack.h"
+#include "RoguelikeTileGrid.h"
 #include "Task/BattleHelper.h"
 
 namespace asst
@@ -61,14 +62,21 @@ namespace asst
         std::optional<DeployInfo> calc_best_loc(const battle::DeploymentOper& oper) const;
         battle::AttackRange get_attack_range(const battle::DeploymentOper& oper,
                                              battle::DeployDirection direction = battle::DeployDirection::Right) const;
+        // 四个朝向的攻击范围位掩码，按 干员名 + 精英化 缓存
+        const RoguelikeTileGrid::RangeMasks& get_attack_range_masks(const battle::DeploymentOper& oper) const;
+        // 地图太宽、位图放不下时逐点计算攻击范围的得分
+        int range_score_by_points(Point loc, const battle::DeploymentOper& oper,
+                                  battle::DeployDirection direction) const;
 
         struct DirectionAndScore
         {
             battle::DeployDirection direction;
             int score = 0;
         };
+        // medic_targets 是场上除无人机外的干员位置，只有治疗干员会用到
         DirectionAndScore calc_best_direction_and_score(Point loc, const battle::DeploymentOper& oper,
-                                                        battle::DeployDirection recommended_direction) const;
+                                                        battle::DeployDirection recommended_direction,
+                                                        const RoguelikeTileGrid::Layer& medic_targets) const;
 
         void postproc_of_deployment_conditions(const battle::DeploymentOper& oper, const Point& placed_loc,
                                                battle::DeployDirection direction);
@@ -80,6 +88,8 @@ namespace asst
         battle::LocationType get_oper_location_type(const battle::DeploymentOper& oper) const;
         std::vector<Point> available_locations(const battle::DeploymentOper& oper) const;
         std::vector<Point> available_locations(battle::LocationType type) const;
+        std::vector<Point> available_locations_by_points(battle::LocationType type) const;
+        RoguelikeTileGrid::Layer used_tiles_layer(bool exclude_drone) const;
         bool get_position_full(const battle::DeploymentOper& oper) const;
         bool get_position_full(battle::LocationType loc_type) const;
         void set_position_full(const battle::DeploymentOper& oper, bool full);
@@ -144,6 +154,14 @@ namespace asst
 
         // 缓存干员精英
         std::unordered_map<std::string, int64_t> m_oper_elite;
+
+        // 地图的位图表示，在 calc_stage_info 里生成
+        RoguelikeTileGrid m_tile_grid;
+        bool m_tile_grid_ready = false; // 地图宽度超出位图上限时为 false，退回逐点计算
+        RoguelikeTileGrid::Layer m_blacklist_layer;
+        RoguelikeTileGrid::WeightedLayers m_fight_weight_layers;
+        RoguelikeTileGrid::WeightedLayers m_medic_weight_layers;
+        mutable std::unordered_map<std::string, RoguelikeTileGrid::RangeMasks> m_range_masks_cache;
         // 缓存干员精英情况
         void cache_oper_elite_status();
     };
@@ -0,0 +1,161 @@
+#include "RoguelikeTileGrid.h"
+
+#include <algorithm>
+#include <bit>
+#include <map>
+
+#include "Utils/Logger.hpp"
+#include "Utils/Ranges.hpp"
+
+using namespace asst;
+
+bool RoguelikeTileGrid::build(const std::unordered_map<Point, TilePack::TileInfo>& tiles)
+{
+    clear();
+
+    int width = 0;
+    int height = 0;
+    for (const auto& loc : tiles | views::keys) {
+        width = std::max(width, loc.x + 1);
+        height = std::max(height, loc.y + 1);
+    }
+    if (width > MaxWidth) {
+        Log.error(__FUNCTION__, "map is too wide:", width);
+        return false;
+    }
+
+    m_width = width;
+    m_height = height;
+    m_empty_layer = make_layer();
+    for (const auto& [loc, tile] : tiles) {
+        auto& key_layer = m_key_layers.try_emplace(tile.key, m_empty_layer).first->second;
+        set(key_layer, loc);
+        auto& buildable_layer = m_buildable_layers.try_emplace(tile.buildable, m_empty_layer).first->second;
+        set(buildable_layer, loc);
+    }
+    return true;
+}
+
+void RoguelikeTileGrid::clear()
+{
+    m_width = 0;
+    m_height = 0;
+    m_key_layers.clear();
+    m_buildable_layers.clear();
+    m_empty_layer.clear();
+}
+
+void RoguelikeTileGrid::set(Layer& layer, const Point& loc) const
+{
+    if (loc.x < 0 || loc.x >= m_width || loc.y < 0 || loc.y >= m_height) {
+        return;
+    }
+    layer[loc.y] |= RowMask(1) << loc.x;
+}
+
+const RoguelikeTileGrid::Layer& RoguelikeTileGrid::key_layer(TilePack::TileKey key) const
+{
+    auto iter = m_key_layers.find(key);
+    return iter == m_key_layers.end() ? m_empty_layer : iter->second;
+}
+
+const RoguelikeTileGrid::Layer& RoguelikeTileGrid::buildable_layer(battle::LocationType type) const
+{
+    auto iter = m_buildable_layers.find(type);
+    return iter == m_buildable_layers.end() ? m_empty_layer : iter->second;
+}
+
+RoguelikeTileGrid::WeightedLayers
+    RoguelikeTileGrid::make_weighted_layers(const std::unordered_map<TilePack::TileKey, int>& weights) const
+{
+    // 同样权重的地块合成一层，减少打分时要扫的层数
+    std::map<int, Layer> grouped;
+    for (const auto& [key, layer] : m_key_layers) {
+        auto iter = weights.find(key);
+        if (iter == weights.end() || iter->second == 0) {
+            continue;
+        }
+        auto& merged = grouped.try_emplace(iter->second, m_empty_layer).first->second;
+        for (size_t y = 0; y < merged.size(); ++y) {
+            merged[y] |= layer[y];
+        }
+    }
+    return WeightedLayers(grouped.begin(), grouped.end());
+}
+
+RoguelikeTileGrid::RangeMasks RoguelikeTileGrid::make_range_masks(const battle::AttackRange& right_range)
+{
+    RangeMasks masks;
+    battle::AttackRange range = right_range;
+    for (RangeMask& mask : masks) {
+        if (!range.empty()) {
+            auto [min_iter, max_iter] = ranges::minmax_element(range, {}, &Point::y);
+            mask.top = min_iter->y;
+            mask.rows.assign(static_cast<size_t>(max_iter->y - min_iter->y + 1), 0);
+        }
+        for (const Point& point : range) {
+            int bit = point.x + RangeMask::Bias;
+            if (bit < 0 || bit >= MaxWidth) {
+                Log.warn(__FUNCTION__, "attack range is too wide:", point);
+                continue;
+            }
+            mask.rows[point.y - mask.top] |= RowMask(1) << bit;
+        }
+
+        // 逆时针转到下一个朝向
+        for (Point& point : range) {
+            point = { point.y, -point.x };
+        }
+    }
+    return masks;
+}
+
+int RoguelikeTileGrid::count(const RangeMask& range, const Point& loc, const Layer& layer) const
+{
+    int total = 0;
+    for (size_t i = 0; i < range.rows.size(); ++i) {
+        int y = loc.y + range.top + static_cast<int>(i);
+        if (y < 0 || y >= m_height) {
+            continue;
+        }
+        total += std::popcount(shift_row(range.rows[i], loc.x) & layer[y]);
+    }
+    return total;
+}
+
+int RoguelikeTileGrid::score(const RangeMask& range, const Point& loc, const WeightedLayers& layers) const
+{
+    int total = 0;
+    for (size_t i = 0; i < range.rows.size(); ++i) {
+        int y = loc.y + range.top + static_cast<int>(i);
+        if (y < 0 || y >= m_height) {
+            continue;
+        }
+        RowMask row = shift_row(range.rows[i], loc.x);
+        for (const auto& [weight, layer] : layers) {
+            total += weight * std::popcount(row & layer[y]);
+        }
+    }
+    return total;
+}
+
+std::vector<Point> RoguelikeTileGrid::locations(const Layer& layer) const
+{
+    std::vector<Point> result;
+    for (int y = 0; y < static_cast<int>(layer.size()); ++y) {
+        for (RowMask row = layer[y]; row; row &= row - 1) {
+            result.emplace_back(std::countr_zero(row), y);
+        }
+    }
+    return result;
+}
+
+RoguelikeTileGrid::RowMask RoguelikeTileGrid::shift_row(RowMask mask, int x) noexcept
+{
+    // 相对列偏移 dx 在第 dx + Bias 位，移到第 x + dx 位
+    int shift = x - RangeMask::Bias;
+    if (shift >= 0) {
+        return shift >= MaxWidth ? 0 : mask << shift;
+    }
+    return -shift >= MaxWidth ? 0 : mask >> -shift;
+}
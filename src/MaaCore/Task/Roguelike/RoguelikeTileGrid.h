@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Common/AsstBattleDef.h"
+#include "Common/AsstTypes.h"
+#include "Config/Miscellaneous/TilePack.h"
+
+namespace asst
+{
+    // 肉鸽战斗地图的稠密位图表示。每一层按行存放，每行一个 uint64_t，第 x 位表示第 x 列的格子。
+    // 攻击范围预先转成四个朝向的位掩码，算 位置 × 朝向 的得分时只需要逐行按位与再 popcount
+    class RoguelikeTileGrid
+    {
+    public:
+        using RowMask = uint64_t;
+        using Layer = std::vector<RowMask>;
+        static constexpr int MaxWidth = 64;
+
+        // 一个朝向的攻击范围，列偏移加上 Bias 作为位下标，rows[i] 对应相对行 top + i
+        struct RangeMask
+        {
+            static constexpr int Bias = 32;
+            int top = 0;
+            std::vector<RowMask> rows;
+        };
+        // 依次为 Right, Up, Left, Down
+        using RangeMasks = std::array<RangeMask, 4>;
+
+        // 按权重分好组的若干层，得分 = Σ 权重 × 攻击范围覆盖到的格子数
+        using WeightedLayers = std::vector<std::pair<int, Layer>>;
+
+    public:
+        // 地图宽度超过 MaxWidth 时返回 false，此时所有层都为空
+        bool build(const std::unordered_map<Point, TilePack::TileInfo>& tiles);
+        void clear();
+
+        int width() const noexcept { return m_width; }
+        int height() const noexcept { return m_height; }
+
+        Layer make_layer() const { return Layer(m_height, 0); }
+        // 不在地图上的点会被忽略
+        void set(Layer& layer, const Point& loc) const;
+
+        const Layer& key_layer(TilePack::TileKey key) const;
+        const Layer& buildable_layer(battle::LocationType type) const;
+        WeightedLayers make_weighted_layers(const std::unordered_map<TilePack::TileKey, int>& weights) const;
+
+        static RangeMasks make_range_masks(const battle::AttackRange& right_range);
+        int count(const RangeMask& range, const Point& loc, const Layer& layer) const;
+        int score(const RangeMask& range, const Point& loc, const WeightedLayers& layers) const;
+
+        // 按行优先的顺序列出层中所有的格子
+        std::vector<Point> locations(const Layer& layer) const;
+
+    private:
+        static RowMask shift_row(RowMask mask, int x) noexcept;
+
+        int m_width = 0;
+        int m_height = 0;
+        std::unordered_map<TilePack::TileKey, Layer> m_key_layers;
+        std::unordered_map<battle::LocationType, Layer> m_buildable_layers;
+        Layer m_empty_layer;
+    };
+} // namespace asst
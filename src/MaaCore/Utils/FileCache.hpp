@@ -0,0 +1,78 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <iomanip>
+#include <sstream>
+#include <string_view>
+#include <type_traits>
+
+#include "Platform.hpp"
+#include "WorkingDir.hpp"
+
+namespace asst::utils
+{
+    // FNV-1a，seed 传入上一次的结果就能接着累计；seed 为 0 时从头开始
+    inline uint64_t fnv1a(uint64_t seed, std::string_view bytes) noexcept
+    {
+        constexpr uint64_t OffsetBasis = 0xcbf29ce484222325ULL;
+        constexpr uint64_t Prime = 0x100000001b3ULL;
+        uint64_t hash = seed == 0 ? OffsetBasis : seed;
+        for (unsigned char c : bytes) {
+            hash = (hash ^ c) * Prime;
+        }
+        return hash;
+    }
+
+    // 按内存里的字节算，只用于写进缓存文件头的那些定长字段
+    template <typename T>
+    requires(std::is_trivially_copyable_v<T> && !std::is_pointer_v<T> && !std::is_convertible_v<T, std::string_view>)
+    inline uint64_t fnv1a(uint64_t seed, const T& value) noexcept
+    {
+        return fnv1a(seed, std::string_view(reinterpret_cast<const char*>(&value), sizeof(value)));
+    }
+
+    // 用户目录下按内容哈希命名的缓存文件，例如 cache/tasks/0123456789abcdef.bin
+    // 资源每次更新都会产生一个新文件，旧的靠修改时间过期清理
+    namespace file_cache
+    {
+        inline std::filesystem::path path(std::string_view category, uint64_t hash)
+        {
+            using namespace path_literals;
+
+            std::stringstream name;
+            name << std::hex << std::setfill('0') << std::setw(16) << hash << ".bin";
+            return UserDir.get() / "cache"_p / utils::path(std::string(category)) / name.str();
+        }
+
+        // 用修改时间记录最近一次使用，清理时据此判断
+        inline void touch(const std::filesystem::path& file)
+        {
+            std::error_code ec;
+            std::filesystem::last_write_time(file, std::filesystem::file_time_type::clock::now(), ec);
+        }
+
+        // 清理同一目录下很久没用过的缓存文件，keep 是刚写入的那个，不动它。返回删掉的个数
+        inline size_t remove_expired(const std::filesystem::path& keep)
+        {
+            using namespace std::chrono_literals;
+            constexpr auto ExpireTime = 24h * 30;
+
+            const auto now = std::filesystem::file_time_type::clock::now();
+            size_t removed = 0;
+            std::error_code ec;
+            for (const auto& entry : std::filesystem::directory_iterator(keep.parent_path(), ec)) {
+                std::error_code entry_ec;
+                if (entry.path() == keep || entry.path().extension() != ".bin" ||
+                    now - entry.last_write_time(entry_ec) < ExpireTime || entry_ec) {
+                    continue;
+                }
+                if (std::filesystem::remove(entry.path(), entry_ec)) {
+                    ++removed;
+                }
+            }
+            return removed;
+        }
+    }
+}
@@ -1,10 +1,15 @@
 #pragma once
 
+#include <atomic>
+#include <cstdlib>
+#include <exception>
 #include <filesystem>
 #include <fstream>
 #include <functional>
 #include <iostream>
 #include <mutex>
+#include <sstream>
+#include <string>
 #include <thread>
 #include <type_traits>
 #include <utility>
@@ -218,6 +223,212 @@ namespace asst
         private:
             std::vector<id> m_state {};
         };
+
+        // 多生产者单消费者的无锁队列，生产者只做一次 CAS，消费者一次取走全部
+        class log_queue
+        {
+        public:
+            log_queue() = default;
+            log_queue(const log_queue&) = delete;
+            log_queue& operator=(const log_queue&) = delete;
+            ~log_queue()
+            {
+                node* head = m_head.exchange(nullptr);
+                while (head) {
+                    delete std::exchange(head, head->next);
+                }
+            }
+
+            void push(std::string line)
+            {
+                node* n = new node { std::move(line), m_head.load(std::memory_order_relaxed) };
+                while (!m_head.compare_exchange_weak(n->next, n, std::memory_order_release, std::memory_order_relaxed))
+                    ;
+                // 消费者只会在队列为空时睡眠，所以只有从空变为非空时需要唤醒
+                if (!n->next) {
+                    m_head.notify_one();
+                }
+            }
+
+            // 按入队顺序返回
+            std::vector<std::string> take_all()
+            {
+                node* head = m_head.exchange(nullptr, std::memory_order_acquire);
+                std::vector<std::string> lines;
+                for (; head; delete std::exchange(head, head->next)) {
+                    lines.emplace_back(std::move(head->line));
+                }
+                std::reverse(lines.begin(), lines.end());
+                return lines;
+            }
+
+            // 阻塞直到队列非空
+            void wait() const { m_head.wait(nullptr, std::memory_order_acquire); }
+
+        private:
+            struct node
+            {
+                std::string line;
+                node* next = nullptr;
+            };
+            std::atomic<node*> m_head = nullptr;
+        };
+
+        // 日志文件及其写入状态。后台写线程也持有它，所以单独拿出来用 shared_ptr 管理生命周期
+        struct log_sink
+        {
+            static constexpr uintmax_t MaxLogSize = 4ULL * 1024 * 1024;
+
+            log_sink(std::filesystem::path log, std::filesystem::path bak)
+                : log_path(std::move(log)), bak_path(std::move(bak))
+            {}
+
+            std::ofstream& stream()
+            {
+                if (!ofs || !ofs.is_open()) {
+                    ofs = std::ofstream(log_path, std::ios::out | std::ios::app);
+                }
+                return ofs;
+            }
+
+            void close()
+            {
+                if (ofs.is_open()) {
+                    ofs.close();
+                }
+            }
+
+            void rotate() const
+            {
+                try {
+                    if (std::filesystem::exists(log_path) && std::filesystem::is_regular_file(log_path)) {
+                        const uintmax_t log_size = std::filesystem::file_size(log_path);
+                        if (log_size >= MaxLogSize) {
+                            std::filesystem::rename(log_path, bak_path);
+                        }
+                    }
+                }
+                catch (std::filesystem::filesystem_error& e) {
+                    std::cerr << e.what() << std::endl;
+                }
+                catch (...) {
+                }
+            }
+
+            // 把队列里的日志整批写入文件，需持有 mutex。空行是 flush 请求：关闭文件并检查是否需要轮转
+            void write_pending()
+            {
+                bool flush_requested = false;
+                for (const std::string& line : queue.take_all()) {
+                    if (line.empty()) {
+                        flush_requested = true;
+                        continue;
+                    }
+                    stream() << line;
+                }
+                if (ofs.is_open()) {
+                    ofs.flush();
+                }
+                if (flush_requested ||
+                    (ofs.is_open() && static_cast<uintmax_t>(std::streamoff(ofs.tellp())) >= MaxLogSize)) {
+                    close();
+                    rotate();
+                }
+            }
+
+            // 进程退出或 terminate 时把还在排队的日志写出去。terminate 时出错的线程可能正持有 mutex，只尝试加锁
+            static void install_exit_hooks(const std::shared_ptr<log_sink>& sink)
+            {
+                static std::weak_ptr<log_sink> s_sink;
+                static std::terminate_handler s_prev_terminate = nullptr;
+                static std::once_flag s_once;
+
+                std::call_once(s_once, [&]() {
+                    s_sink = sink;
+                    std::atexit([]() {
+                        if (auto locked = s_sink.lock()) {
+                            std::unique_lock<std::mutex> lock(locked->mutex);
+                            locked->write_pending();
+                        }
+                    });
+                    s_prev_terminate = std::set_terminate([]() {
+                        if (auto locked = s_sink.lock()) {
+                            std::unique_lock<std::mutex> lock(locked->mutex, std::try_to_lock);
+                            if (lock.owns_lock()) {
+                                locked->write_pending();
+                            }
+                        }
+                        if (s_prev_terminate) {
+                            s_prev_terminate();
+                        }
+                        std::abort();
+                    });
+                });
+            }
+
+            static void writer_func(std::shared_ptr<log_sink> sink)
+            {
+                while (true) {
+                    sink->queue.wait();
+                    std::unique_lock<std::mutex> lock(sink->mutex);
+                    if (sink->stop) {
+                        return;
+                    }
+                    sink->write_pending();
+                }
+            }
+
+            const std::filesystem::path log_path;
+            const std::filesystem::path bak_path;
+            std::mutex mutex; // 保护 ofs，以及 debug 下的 scope
+            std::ofstream ofs;
+            log_queue queue;
+            bool stop = false;
+        };
+
+        // 先把一行日志格式化到本地缓冲区，格式化期间不持有任何锁。
+        // 析构时异步模式下整行交给写线程，否则加锁后先写完排队中的再直接写文件
+        class log_line
+        {
+        public:
+            log_line(std::shared_ptr<log_sink> sink, bool async) : m_sink(std::move(sink)), m_async(async) {}
+            log_line(log_line&&) = default;
+            log_line(const log_line&) = delete;
+            log_line& operator=(log_line&&) = default;
+            log_line& operator=(const log_line&) = delete;
+            ~log_line()
+            {
+                if (!m_sink) {
+                    return;
+                }
+                if (m_async) {
+                    m_sink->queue.push(std::move(m_buff).str());
+                    return;
+                }
+                std::unique_lock<std::mutex> lock(m_sink->mutex);
+                m_sink->write_pending();
+                m_sink->stream() << std::move(m_buff).str() << std::flush;
+            }
+
+            template <typename T>
+            requires has_stream_insertion_operator<std::ostream, T>
+            log_line& operator<<(T&& v)
+            {
+                m_buff << std::forward<T>(v);
+                return *this;
+            }
+
+            log_line& operator<<(std::ostream& (*pf)(std::ostream&))
+            {
+                m_buff << pf;
+                return *this;
+            }
+
+        private:
+            std::shared_ptr<log_sink> m_sink;
+            bool m_async = false;
+            std::ostringstream m_buff;
+        };
     } // namespace detail
 
     class toansi_ostream
@@ -325,7 +536,8 @@ namespace asst
         {
             constexpr level(const level&) = default;
             constexpr level(level&&) noexcept = default;
-            constexpr explicit level(std::string_view s) noexcept : str(s) {}
+            // 外部传入的自定义级别（如 AsstLog）默认不会被过滤
+            constexpr explicit level(std::string_view s, int r = MaxRank) noexcept : str(s), rank(r) {}
             constexpr level& operator=(const level&) = default;
             constexpr level& operator=(level&&) noexcept = default;
             constexpr level& operator=(std::string_view s) noexcept
@@ -334,6 +546,8 @@ namespace asst
                 return *this;
             }
 
+            static constexpr int MaxRank = 4;
+
             static const level debug;
             static const level trace;
             static const level info;
@@ -341,6 +555,12 @@ namespace asst
             static const level error;
 
             std::string_view str;
+            int rank = MaxRank; // 用于按级别过滤，越大越重要
+        };
+
+        // 级别被过滤掉的流式日志用这个构造 LogStream，之后的输出全部丢弃
+        struct discard_t
+        {
         };
 
         template <typename stream_t>
@@ -350,6 +570,9 @@ namespace asst
             template <typename T>
             LogStream& operator<<(T&& arg)
             {
+                if (m_discard) {
+                    return *this;
+                }
                 if constexpr (std::same_as<separator, remove_cvref_t<T>>) {
                     m_sep = std::forward<T>(arg);
                 }
@@ -380,12 +603,27 @@ namespace asst
             {
                 ((*this << lv) << ... << std::forward<Args>(buff));
             }
+            // 写入调用方独占的缓冲区，不需要加锁
+            template <typename _stream_t = stream_t, typename... Args>
+            LogStream(_stream_t&& ofs, Logger::level lv, Args&&... buff) : m_ofs(std::forward<_stream_t>(ofs))
+            {
+                ((*this << lv) << ... << std::forward<Args>(buff));
+            }
+            // 不加锁，也不写任何内容
+            template <typename _stream_t = stream_t>
+            LogStream(discard_t, _stream_t&& ofs) : m_ofs(std::forward<_stream_t>(ofs)), m_discard(true)
+            {}
             LogStream(LogStream&&) = delete;
             LogStream(const LogStream&) = delete;
             LogStream& operator=(LogStream&&) = delete;
             LogStream& operator=(const LogStream&) = delete;
 
-            ~LogStream() { m_ofs << std::endl; }
+            ~LogStream()
+            {
+                if (!m_discard) {
+                    m_ofs << std::endl;
+                }
+            }
 
         private:
             template <typename Stream, typename T>
@@ -445,6 +683,7 @@ namespace asst
             separator m_sep = separator::space;
             std::unique_lock<std::mutex> m_trace_lock;
             stream_t m_ofs;
+            bool m_discard = false;
         };
 
         // template <typename stream_t>
@@ -462,8 +701,30 @@ namespace asst
         template <typename stream_t, typename... Args>
         LogStream(std::unique_lock<std::mutex>&&, stream_t&&, Args&&...) -> LogStream<stream_t>;
 
+        template <typename stream_t, typename... Args>
+        LogStream(stream_t&&, Logger::level, Args&&...) -> LogStream<stream_t>;
+
+        template <typename stream_t>
+        LogStream(discard_t, stream_t&&) -> LogStream<stream_t>;
+
     public:
-        virtual ~Logger() override { flush(); }
+        virtual ~Logger() override
+        {
+            m_async = false;
+            {
+                std::unique_lock<std::mutex> lock(m_sink->mutex);
+                m_sink->stop = true;
+                m_sink->write_pending();
+                m_sink->close();
+                m_sink->rotate();
+            }
+            if (m_writer.joinable()) {
+                // 唤醒写线程让它自行退出。
+                // 不在这里 join：作为 dll 里的静态对象析构时 join 可能会和 loader lock 死锁
+                m_sink->queue.push({});
+                m_writer.detach();
+            }
+        }
 
         // static bool set_directory(const std::filesystem::path& dir)
         // {
@@ -478,31 +739,76 @@ namespace asst
         template <typename T>
         auto operator<<(T&& arg)
         {
-            if (!m_ofs || !m_ofs.is_open()) {
-                m_ofs = std::ofstream(m_log_path, std::ios::out | std::ios::app);
+            // 与 log() 一样按级别过滤，不带级别的按 trace 算
+            constexpr bool with_level = std::same_as<level, remove_cvref_t<T>>;
+            bool discard = false;
+            if constexpr (with_level) {
+                discard = !enabled(arg);
+            }
+            else {
+                discard = !enabled(level::trace);
             }
-            if constexpr (std::same_as<level, remove_cvref_t<T>>) {
 #ifdef ASST_DEBUG
-                return LogStream(m_trace_mutex, ostreams { toansi_ostream(std::cout), m_ofs }, arg);
-#else
-                return LogStream(m_trace_mutex, m_ofs, arg);
-#endif
+            std::ofstream& ofs = m_sink->stream();
+            if (discard) {
+                return LogStream(discard_t {}, ostreams { toansi_ostream(std::cout), ofs });
+            }
+            if constexpr (with_level) {
+                return LogStream(m_sink->mutex, ostreams { toansi_ostream(std::cout), ofs }, arg);
             }
             else {
-#ifdef ASST_DEBUG
-                return LogStream(m_trace_mutex, ostreams { toansi_ostream(std::cout), m_ofs }, level::trace, arg);
+                return LogStream(m_sink->mutex, ostreams { toansi_ostream(std::cout), ofs }, level::trace, arg);
+            }
 #else
-                return LogStream(m_trace_mutex, m_ofs, level::trace, arg);
+            if (discard) {
+                return LogStream(discard_t {}, detail::log_line(nullptr, false));
+            }
+            if constexpr (with_level) {
+                // error 及以上同步写入，崩溃前的最后几行不能还留在队列里
+                return LogStream(detail::log_line(m_sink, m_async && arg.rank < level::error.rank), arg);
+            }
+            else {
+                return LogStream(detail::log_line(m_sink, m_async), level::trace, arg);
+            }
 #endif
+        }
+
+        // 异步模式下调用方只负责格式化，由后台线程批量写文件，默认关闭。
+        // 调试版本始终同步输出，保证控制台和 scope 的顺序
+        void set_async([[maybe_unused]] bool enable)
+        {
+#ifndef ASST_DEBUG
+            if (enable) {
+                std::unique_lock<std::mutex> lock(m_sink->mutex);
+                if (!m_writer.joinable()) {
+                    detail::log_sink::install_exit_hooks(m_sink);
+                    m_writer = std::thread(&detail::log_sink::writer_func, m_sink);
+                }
+            }
+            else if (m_async) {
+                // 先把已经排队的写完，后续的同步日志才不会插到它们前面
+                m_async = false;
+                std::unique_lock<std::mutex> lock(m_sink->mutex);
+                m_sink->write_pending();
             }
+            m_async = enable;
+#endif
         }
+        bool is_async() const noexcept { return m_async; }
+
+        // 低于该级别的日志在格式化之前就被丢弃
+        void set_min_level(const level& lv) noexcept { m_min_rank = lv.rank; }
+        bool enabled(const level& lv) const noexcept { return lv.rank >= m_min_rank.load(std::memory_order_relaxed); }
 
 #ifdef ASST_DEBUG
 #define LOGGER_FUNC_WITH_LEVEL(lv)                                                     \
     template <typename... Args>                                                        \
     inline void lv(Args&&... args)                                                     \
     {                                                                                  \
-        std::unique_lock lock { m_trace_mutex };                                       \
+        if (!enabled(level::lv)) {                                                     \
+            return;                                                                    \
+        }                                                                              \
+        std::unique_lock lock { m_sink->mutex };                                       \
         log(std::move(lock), level::lv, m_scopes.next(), std::forward<Args>(args)...); \
     }
 #else
@@ -522,7 +828,10 @@ namespace asst
         inline void debug([[maybe_unused]] Args&&... args)
         {
 #ifdef ASST_DEBUG
-            std::unique_lock lock { m_trace_mutex };
+            if (!enabled(level::debug)) {
+                return;
+            }
+            std::unique_lock lock { m_sink->mutex };
             log(std::move(lock), level::debug, std::forward<Args>(args)...);
 #endif
         }
@@ -533,33 +842,34 @@ namespace asst
         inline int push(Args&&... args)
         {
             int id = -1;
-            std::unique_lock lock { m_trace_mutex };
+            std::unique_lock lock { m_sink->mutex };
             log(std::move(lock), level::trace, m_scopes.push(id), std::forward<Args>(args)...);
             return id;
         }
         template <typename... Args>
         inline void pop(int id, Args&&... args)
         {
-            std::unique_lock lock { m_trace_mutex };
+            std::unique_lock lock { m_sink->mutex };
             log(std::move(lock), level::trace, m_scopes.pop(id), std::forward<Args>(args)...);
         }
 
         template <typename... Args>
         inline void log(level lv, Args&&... args)
         {
+            if (!enabled(lv)) {
+                return;
+            }
             ((*this << lv) << ... << std::forward<Args>(args));
         }
         template <typename... Args>
         inline void log(std::unique_lock<std::mutex>&& lock, level lv, Args&&... args)
         {
-            if (!m_ofs || !m_ofs.is_open()) {
-                m_ofs = std::ofstream(m_log_path, std::ios::out | std::ios::app);
-            }
+            std::ofstream& ofs = m_sink->stream();
             (LogStream(std::move(lock),
 #ifdef ASST_DEBUG
-                       ostreams { toansi_ostream(std::cout), m_ofs },
+                       ostreams { toansi_ostream(std::cout), ofs },
 #else
-                       m_ofs,
+                       ofs,
 #endif
                        lv)
              << ... << std::forward<Args>(args));
@@ -567,11 +877,14 @@ namespace asst
 
         void flush()
         {
-            std::unique_lock<std::mutex> m_trace_lock(m_trace_mutex);
-            if (m_ofs.is_open()) {
-                m_ofs.close();
+            if (m_async) {
+                // 关闭文件和轮转交给写线程，不占用调用方的时间
+                m_sink->queue.push({});
+                return;
             }
-            rotate();
+            std::unique_lock<std::mutex> m_trace_lock(m_sink->mutex);
+            m_sink->close();
+            m_sink->rotate();
         }
 
     private:
@@ -579,28 +892,10 @@ namespace asst
 
         Logger() : m_directory(UserDir.get())
         {
-            std::filesystem::create_directories(m_log_path.parent_path());
-            rotate();
+            std::filesystem::create_directories(m_sink->log_path.parent_path());
+            m_sink->rotate();
             log_init_info();
         }
-
-        void rotate() const
-        {
-            constexpr uintmax_t MaxLogSize = 4ULL * 1024 * 1024;
-            try {
-                if (std::filesystem::exists(m_log_path) && std::filesystem::is_regular_file(m_log_path)) {
-                    const uintmax_t log_size = std::filesystem::file_size(m_log_path);
-                    if (log_size >= MaxLogSize) {
-                        std::filesystem::rename(m_log_path, m_log_bak_path);
-                    }
-                }
-            }
-            catch (std::filesystem::filesystem_error& e) {
-                std::cerr << e.what() << std::endl;
-            }
-            catch (...) {
-            }
-        }
         void log_init_info()
         {
             trace("-----------------------------");
@@ -615,10 +910,11 @@ namespace asst
 
         std::filesystem::path m_directory;
 
-        std::filesystem::path m_log_path = m_directory / "debug" / "asst.log";
-        std::filesystem::path m_log_bak_path = m_directory / "debug" / "asst.bak.log";
-        std::mutex m_trace_mutex;
-        std::ofstream m_ofs;
+        std::shared_ptr<detail::log_sink> m_sink = std::make_shared<detail::log_sink>(
+            m_directory / "debug" / "asst.log", m_directory / "debug" / "asst.bak.log");
+        std::atomic<bool> m_async = false;
+        std::atomic<int> m_min_rank = 0;
+        std::thread m_writer;
     };
 
     inline constexpr Logger::separator Logger::separator::none;
@@ -627,11 +923,11 @@ namespace asst
     inline constexpr Logger::separator Logger::separator::newline("\n");
     inline constexpr Logger::separator Logger::separator::comma(",");
 
-    inline constexpr Logger::level Logger::level::debug("DBG");
-    inline constexpr Logger::level Logger::level::trace("TRC");
-    inline constexpr Logger::level Logger::level::info("INF");
-    inline constexpr Logger::level Logger::level::warn("WRN");
-    inline constexpr Logger::level Logger::level::error("ERR");
+    inline constexpr Logger::level Logger::level::debug("DBG", 0);
+    inline constexpr Logger::level Logger::level::trace("TRC", 1);
+    inline constexpr Logger::level Logger::level::info("INF", 2);
+    inline constexpr Logger::level Logger::level::warn("WRN", 3);
+    inline constexpr Logger::level Logger::level::error("ERR", 4);
 
     class LoggerAux
     {
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <regex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "SingletonHolder.hpp"
+
+namespace asst
+{
+    // 编译后的匹配规则。不含正则元字符的纯文本、以及 "^纯文本" 这种前缀规则走字符串查找，
+    // 其余的才用 std::regex，结果与直接用 std::regex(ECMAScript) 一致
+    class CompiledPattern
+    {
+    public:
+        explicit CompiledPattern(const std::string& pattern)
+        {
+            if (is_literal(pattern)) {
+                m_kind = Kind::Literal;
+                m_literal = pattern;
+            }
+            else if (pattern.size() > 1 && pattern.front() == '^' && is_literal(std::string_view(pattern).substr(1))) {
+                m_kind = Kind::Prefix;
+                m_literal = pattern.substr(1);
+            }
+            else {
+                m_kind = Kind::Regex;
+                m_regex = std::regex(pattern);
+            }
+        }
+
+        bool search(const std::string& text) const
+        {
+            switch (m_kind) {
+            case Kind::Literal:
+                return text.find(m_literal) != std::string::npos;
+            case Kind::Prefix:
+                return text.starts_with(m_literal);
+            default:
+                return std::regex_search(text, m_regex);
+            }
+        }
+
+        std::string replace(const std::string& text, const std::string& fmt) const
+        {
+            // 替换串里的 $ 有特殊含义（$&、$1 等），这种情况直接交给 std::regex 处理
+            if (m_kind == Kind::Regex || fmt.find('$') != std::string::npos) {
+                if (m_kind != Kind::Regex) {
+                    std::call_once(m_regex_once, [&]() {
+                        m_regex = std::regex(m_kind == Kind::Prefix ? "^" + m_literal : m_literal);
+                    });
+                }
+                return std::regex_replace(text, m_regex, fmt);
+            }
+            if (m_kind == Kind::Prefix) {
+                return text.starts_with(m_literal) ? fmt + text.substr(m_literal.size()) : text;
+            }
+
+            std::string result;
+            size_t last = 0;
+            for (size_t pos = text.find(m_literal); pos != std::string::npos; pos = text.find(m_literal, last)) {
+                result.append(text, last, pos - last).append(fmt);
+                last = pos + m_literal.size();
+            }
+            if (last == 0) {
+                return text;
+            }
+            result.append(text, last);
+            return result;
+        }
+
+    private:
+        enum class Kind
+        {
+            Literal,
+            Prefix,
+            Regex,
+        };
+
+        static bool is_literal(std::string_view pattern) noexcept
+        {
+            // 空串的正则会在每个字符之间都匹配一次，不能当纯文本处理
+            return !pattern.empty() && pattern.find_first_of(R"(\^$.|?*+()[]{})") == std::string_view::npos;
+        }
+
+        Kind m_kind = Kind::Regex;
+        std::string m_literal;
+        // 纯文本规则遇到带 $ 的替换串时才需要正则，按需编译
+        mutable std::regex m_regex;
+        mutable std::once_flag m_regex_once;
+    };
+
+    // 全局的已编译规则缓存，以规则字符串为 key，避免每次识别都重新构造 std::regex
+    class RegexCache final : public SingletonHolder<RegexCache>
+    {
+    public:
+        virtual ~RegexCache() override = default;
+
+        // 规则非法时与 std::regex 一样抛出 std::regex_error，且不会被缓存
+        std::shared_ptr<const CompiledPattern> get(const std::string& pattern)
+        {
+            {
+                std::shared_lock<std::shared_mutex> lock(m_mutex);
+                if (auto iter = m_patterns.find(pattern); iter != m_patterns.end()) {
+                    return iter->second;
+                }
+            }
+            auto compiled = std::make_shared<const CompiledPattern>(pattern);
+            std::unique_lock<std::shared_mutex> lock(m_mutex);
+            return m_patterns.try_emplace(pattern, std::move(compiled)).first->second;
+        }
+
+    private:
+        friend class SingletonHolder<RegexCache>;
+        RegexCache() = default;
+
+        std::shared_mutex m_mutex;
+        std::unordered_map<std::string, std::shared_ptr<const CompiledPattern>> m_patterns;
+    };
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "SingletonHolder.hpp"
+
+namespace asst
+{
+    // 进程内共享的工作线程池，给识别之类的 CPU 密集型任务做并行用
+    // 所有 Assistant 实例共用同一个池子，避免各自开一堆线程
+    class WorkerPool final : public SingletonHolder<WorkerPool>
+    {
+    public:
+        virtual ~WorkerPool() override
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_state->mutex);
+                m_state->stop = true;
+            }
+            m_state->cv.notify_all();
+            // 线程持有 state 的 shared_ptr，detach 后自行退出。
+            // 不在这里 join：作为 dll 里的静态对象析构时 join 可能会和 loader lock 死锁
+            for (auto& worker : m_workers) {
+                worker.detach();
+            }
+        }
+
+        size_t concurrency() const noexcept { return m_workers.size(); }
+
+        template <typename Func>
+        auto submit(Func&& func) -> std::future<std::invoke_result_t<std::decay_t<Func>>>
+        {
+            using ReturnT = std::invoke_result_t<std::decay_t<Func>>;
+            auto task = std::make_shared<std::packaged_task<ReturnT()>>(std::forward<Func>(func));
+            auto future = task->get_future();
+            {
+                std::unique_lock<std::mutex> lock(m_state->mutex);
+                m_state->tasks.emplace_back([task]() { (*task)(); });
+            }
+            m_state->cv.notify_one();
+            return future;
+        }
+
+        // 等待 future 就绪。等待期间调用方线程也会帮忙执行队列里的任务，
+        // 所以在工作线程里嵌套 submit + wait 也不会因为线程耗尽而死锁
+        template <typename T>
+        T wait(std::future<T>& future)
+        {
+            using namespace std::chrono_literals;
+            while (future.wait_for(0s) != std::future_status::ready) {
+                if (!run_pending_task()) {
+                    // 队列已空，说明要等的任务已经在别的线程上跑了
+                    future.wait();
+                }
+            }
+            return future.get();
+        }
+
+    private:
+        friend class SingletonHolder<WorkerPool>;
+
+        struct State
+        {
+            std::mutex mutex;
+            std::condition_variable cv;
+            std::deque<std::function<void()>> tasks;
+            bool stop = false;
+        };
+
+        WorkerPool()
+        {
+            // 至少两个线程，留一个核给调用方线程（它在 wait 时也会干活）
+            const size_t hardware = std::thread::hardware_concurrency();
+            const size_t thread_count = std::max<size_t>(2, hardware > 1 ? hardware - 1 : 1);
+            for (size_t i = 0; i < thread_count; ++i) {
+                m_workers.emplace_back(&WorkerPool::worker_func, m_state);
+            }
+        }
+
+        bool run_pending_task()
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(m_state->mutex);
+                if (m_state->tasks.empty()) {
+                    return false;
+                }
+                task = std::move(m_state->tasks.front());
+                m_state->tasks.pop_front();
+            }
+            task();
+            return true;
+        }
+
+        static void worker_func(std::shared_ptr<State> state)
+        {
+            while (true) {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(state->mutex);
+                    state->cv.wait(lock, [&]() { return state->stop || !state->tasks.empty(); });
+                    if (state->stop) {
+                        return;
+                    }
+                    task = std::move(state->tasks.front());
+                    state->tasks.pop_front();
+                }
+                task();
+            }
+        }
+
+        std::shared_ptr<State> m_state = std::make_shared<State>();
+        std::vector<std::thread> m_workers;
+    };
+}
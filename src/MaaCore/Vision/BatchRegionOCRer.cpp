@@ -0,0 +1,70 @@
+#include "BatchRegionOCRer.h"
+
+#include "Utils/NoWarningCV.h"
+
+#include "Config/Miscellaneous/OcrPack.h"
+#include "Utils/Logger.hpp"
+
+using namespace asst;
+
+void BatchRegionOCRer::add_region(const Rect& roi)
+{
+    add_region(m_image, roi);
+}
+
+void BatchRegionOCRer::add_region(const cv::Mat& image, const Rect& roi)
+{
+    m_regions.emplace_back(Region { .image = image, .roi = roi });
+}
+
+const BatchRegionOCRer::ResultOpts& BatchRegionOCRer::analyze() const
+{
+    m_result.assign(m_regions.size(), std::nullopt);
+
+    auto config = m_params;
+    config.without_det = true;
+
+    // 先逐个区域做二值化裁剪，能识别的区域攒起来一起推理
+    std::vector<size_t> region_indexes;
+    std::vector<OCRer> ocr_analyzers;
+    std::vector<cv::Mat> crops;
+    for (size_t i = 0; i < m_regions.size(); ++i) {
+        const auto& [image, roi] = m_regions.at(i);
+        if (image.empty()) {
+            Log.error(__FUNCTION__, "image is empty, index:", i);
+            continue;
+        }
+
+        RegionOCRer region_analyzer(image, roi, m_inst);
+        region_analyzer.set_params(m_params);
+        auto new_roi = region_analyzer.preproc_roi();
+        if (!new_roi) {
+            continue;
+        }
+        Rect ocr_roi = correct_rect(*new_roi, image);
+
+        OCRer& ocr_analyzer = ocr_analyzers.emplace_back(image, ocr_roi, m_inst);
+        ocr_analyzer.set_params(config);
+        region_indexes.emplace_back(i);
+        crops.emplace_back(make_roi(image, ocr_roi));
+    }
+    if (crops.empty()) {
+        return m_result;
+    }
+
+    OcrPack& ocr_pack = m_params.use_char_model ? static_cast<OcrPack&>(CharOcr::get_instance())
+                                                : static_cast<OcrPack&>(WordOcr::get_instance());
+    auto raw_results = ocr_pack.recognize_batch(crops, m_inst);
+    if (raw_results.size() != crops.size()) {
+        Log.error(__FUNCTION__, "batch result size mismatch", raw_results.size(), crops.size());
+        return m_result;
+    }
+
+    for (size_t i = 0; i < raw_results.size(); ++i) {
+        auto processed = ocr_analyzers.at(i).postprocess({ std::move(raw_results.at(i)) });
+        if (processed) {
+            m_result.at(region_indexes.at(i)) = std::move(processed->front());
+        }
+    }
+    return m_result;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "RegionOCRer.h"
+
+namespace asst
+{
+    // RegionOCRer 的批量版本：各个区域分别二值化裁剪后，一次性送进识别模型
+    // 适合列表类页面（干员名、材料数量等）逐个区域 OCR 的场景
+    class BatchRegionOCRer : public VisionHelper, public OCRerConfig
+    {
+    public:
+        using Result = RegionOCRer::Result;
+        using ResultOpt = RegionOCRer::ResultOpt;
+        using ResultOpts = std::vector<ResultOpt>;
+
+    public:
+        using VisionHelper::VisionHelper;
+        virtual ~BatchRegionOCRer() override = default;
+
+        // 在 set_image 设置的图上添加一个区域
+        void add_region(const Rect& roi);
+        // 添加一张单独的图，roi 为空表示整张图
+        void add_region(const cv::Mat& image, const Rect& roi = Rect());
+        void clear_regions() noexcept { m_regions.clear(); }
+
+        // 结果与添加区域的顺序一一对应，没识别出来或被过滤掉的为 std::nullopt
+        const ResultOpts& analyze() const;
+        const auto& get_result() const noexcept { return m_result; }
+
+    protected:
+        using OCRerConfig::set_without_det;
+        virtual void _set_roi(const Rect& roi) override { set_roi(roi); }
+
+    private:
+        struct Region
+        {
+            cv::Mat image;
+            Rect roi;
+        };
+
+        std::vector<Region> m_regions;
+        mutable ResultOpts m_result;
+    };
+}
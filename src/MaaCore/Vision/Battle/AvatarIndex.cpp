@@ -0,0 +1,106 @@
+#include "AvatarIndex.h"
+
+#include <cmath>
+
+#include "Utils/NoWarningCV.h"
+
+#include "Utils/Logger.hpp"
+
+using namespace asst;
+
+AvatarIndex::AvatarIndex(const std::unordered_map<std::string, cv::Mat>& avatars)
+{
+    for (const auto& [name, avatar] : avatars) {
+        if (avatar.empty()) {
+            continue;
+        }
+        if (m_names.empty()) {
+            m_size = avatar.size();
+            m_type = avatar.type();
+            m_features.reserve(avatars.size());
+        }
+        else if (!accepts(avatar)) {
+            Log.warn(__FUNCTION__, "avatar size mismatch, skip", name, avatar.cols, avatar.rows);
+            continue;
+        }
+
+        m_names.emplace_back(name);
+        m_features.push_back(normalize(avatar));
+    }
+}
+
+bool AvatarIndex::accepts(const cv::Mat& avatar) const noexcept
+{
+    return !empty() && avatar.size() == m_size && avatar.type() == m_type;
+}
+
+AvatarIndex::ResultOpt AvatarIndex::match(const cv::Mat& avatar, double threshold) const
+{
+    if (!accepts(avatar)) {
+        return std::nullopt;
+    }
+    return match_normalized(normalize(avatar), threshold).front();
+}
+
+std::vector<AvatarIndex::ResultOpt> AvatarIndex::match(const std::vector<cv::Mat>& avatars, double threshold) const
+{
+    std::vector<ResultOpt> results(avatars.size());
+    std::vector<size_t> indices;
+    cv::Mat features;
+    for (size_t i = 0; i < avatars.size(); ++i) {
+        if (!accepts(avatars[i])) {
+            continue;
+        }
+        indices.emplace_back(i);
+        features.push_back(normalize(avatars[i]));
+    }
+    if (indices.empty()) {
+        return results;
+    }
+
+    auto matched = match_normalized(features, threshold);
+    for (size_t i = 0; i < indices.size(); ++i) {
+        results[indices[i]] = std::move(matched[i]);
+    }
+    return results;
+}
+
+std::vector<AvatarIndex::ResultOpt> AvatarIndex::match_normalized(const cv::Mat& features, double threshold) const
+{
+    // 所有头像和所有模板的得分一次算完，scores(i, j) 是第 i 个头像与第 j 个模板的得分
+    cv::Mat scores;
+    cv::gemm(features, m_features, 1.0, cv::noArray(), 0.0, scores, cv::GEMM_2_T);
+
+    std::vector<ResultOpt> results(static_cast<size_t>(features.rows));
+    for (int i = 0; i < scores.rows; ++i) {
+        ResultOpt& best = results[static_cast<size_t>(i)];
+        const float* row = scores.ptr<float>(i);
+        for (size_t j = 0; j < m_names.size(); ++j) {
+            double score = row[j];
+            if (std::isnan(score) || std::isinf(score)) {
+                score = 0;
+            }
+            if (score >= threshold && (!best || best->score < score)) {
+                best = Result { .name = m_names[j], .score = score };
+            }
+        }
+    }
+    return results;
+}
+
+cv::Mat AvatarIndex::normalize(const cv::Mat& avatar)
+{
+    cv::Mat feature;
+    avatar.convertTo(feature, CV_32F);
+    feature -= cv::mean(feature);
+    feature = feature.reshape(1, 1).clone();
+
+    double norm = cv::norm(feature, cv::NORM_L2);
+    if (norm < 1e-6) {
+        feature.setTo(0);
+    }
+    else {
+        feature /= norm;
+    }
+    return feature;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Utils/NoWarningCVMat.h"
+
+namespace asst
+{
+    // 部署栏头像的批量识别索引
+    // 头像和缓存的模板尺寸相同，TM_CCOEFF_NORMED 只有一个得分，等价于去均值、归一化后的向量点积。
+    // 所以建索引时把所有模板预处理成一个连续的矩阵（每行一个头像），识别时一次矩阵乘法就能算出所有得分。
+    // 不做任何预筛：被跳过的模板也可能是得分最高的那个
+    class AvatarIndex
+    {
+    public:
+        struct Result
+        {
+            std::string name;
+            double score = 0.0;
+        };
+        using ResultOpt = std::optional<Result>;
+
+    public:
+        AvatarIndex() = default;
+        explicit AvatarIndex(const std::unordered_map<std::string, cv::Mat>& avatars);
+
+        bool empty() const noexcept { return m_names.empty(); }
+        size_t size() const noexcept { return m_names.size(); }
+        // 只有和模板尺寸、类型一致的头像才能用索引识别
+        bool accepts(const cv::Mat& avatar) const noexcept;
+
+        // 与 BestMatcher 一致：返回得分最高且不低于阈值的模板
+        ResultOpt match(const cv::Mat& avatar, double threshold) const;
+        std::vector<ResultOpt> match(const std::vector<cv::Mat>& avatars, double threshold) const;
+
+    private:
+        // 每个通道减去自身均值后展平、归一化为单位向量；方差为 0 时返回全 0
+        static cv::Mat normalize(const cv::Mat& avatar);
+
+        // features 每行一个待识别的头像，返回每行得分最高且不低于阈值的模板
+        std::vector<ResultOpt> match_normalized(const cv::Mat& features, double threshold) const;
+
+        cv::Size m_size;
+        int m_type = 0;
+        std::vector<std::string> m_names;
+        cv::Mat m_features; // m_names.size() x (w * h * channels), CV_32FC1
+    };
+}
@@ -5,6 +5,8 @@
 #include <algorithm>
 #include <array>
 #include <cmath>
+#include <map>
+#include <span>
 
 #include <onnxruntime/core/session/onnxruntime_cxx_api.h>
 
@@ -20,12 +22,12 @@ BattlefieldClassifier::ResultOpt BattlefieldClassifier::analyze() const
     bool analyzed = false;
 
     if (m_object_of_interest.skill_ready) {
-        result.skill_ready = skill_ready_analyze();
+        result.skill_ready = skill_ready_analyze({ m_base_point }).front();
         analyzed = true;
     }
 
     if (m_object_of_interest.deploy_direction) {
-        result.deploy_direction = deploy_direction_analyze();
+        result.deploy_direction = deploy_direction_analyze({ m_base_point }).front();
         analyzed = true;
     }
 
@@ -36,92 +38,134 @@ BattlefieldClassifier::ResultOpt BattlefieldClassifier::analyze() const
     return result;
 }
 
-BattlefieldClassifier::SkillReadyResult BattlefieldClassifier::skill_ready_analyze() const
+BattlefieldClassifier::ResultsVec BattlefieldClassifier::analyze_batch() const
 {
-    auto task_ptr = Task.get<MatchTaskInfo>("BattleSkillReady");
-    const Rect& skill_roi_move = task_ptr->rect_move;
-    Rect roi = Rect(m_base_point.x, m_base_point.y, 0, 0).move(skill_roi_move);
-
-    cv::Mat image = make_roi(m_image, correct_rect(roi, m_image));
-    std::vector<float> input = image_to_tensor(image);
+    if (m_base_points.empty() || (!m_object_of_interest.skill_ready && !m_object_of_interest.deploy_direction)) {
+        return {};
+    }
 
-    auto memory_info = Ort::MemoryInfo::CreateCpu(OrtDeviceAllocator, OrtMemTypeCPU);
-    constexpr int64_t batch_size = 1;
-    std::array<int64_t, 4> input_shape { batch_size, image.channels(), image.cols, image.rows };
+    ResultsVec results(m_base_points.size(), Result { .object_of_interest = m_object_of_interest });
 
-    Ort::Value input_tensor = Ort::Value::CreateTensor<float>(memory_info, input.data(), input.size(),
-                                                              input_shape.data(), input_shape.size());
-    SkillReadyResult::Raw raw_results;
-    std::array<int64_t, 2> output_shape { batch_size, SkillReadyResult::ClsSize };
-    Ort::Value output_tensor = Ort::Value::CreateTensor<float>(memory_info, raw_results.data(), raw_results.size(),
-                                                               output_shape.data(), output_shape.size());
+    if (m_object_of_interest.skill_ready) {
+        auto skill_ready = skill_ready_analyze(m_base_points);
+        for (size_t i = 0; i < results.size(); ++i) {
+            results[i].skill_ready = std::move(skill_ready[i]);
+        }
+    }
 
-    auto& session = OnnxSessions::get_instance().get("skill_ready_cls");
-    // 这俩是hardcode在模型里的
-    constexpr const char* input_names[] = { "input" };   // session.GetInputName()
-    constexpr const char* output_names[] = { "output" }; // session.GetOutputName()
+    if (m_object_of_interest.deploy_direction) {
+        auto deploy_direction = deploy_direction_analyze(m_base_points);
+        for (size_t i = 0; i < results.size(); ++i) {
+            results[i].deploy_direction = std::move(deploy_direction[i]);
+        }
+    }
 
-    Ort::RunOptions run_options;
-    session.Run(run_options, input_names, &input_tensor, 1, output_names, &output_tensor, 1);
-    Log.info(__FUNCTION__, "raw results:", raw_results);
+    return results;
+}
 
-    SkillReadyResult::Prob prob = softmax(raw_results);
-    Log.info(__FUNCTION__, "prob:", prob);
-    bool ready = prob[1] > prob[0];
-    float score = std::max(prob[0], prob[1]);
+template <typename Raw>
+std::vector<Raw> BattlefieldClassifier::infer_batch(const std::string& model_name, const std::vector<cv::Mat>& images)
+{
+    std::vector<Raw> raws(images.size());
 
-#ifdef ASST_DEBUG
-    if (ready) {
-        cv::rectangle(m_image_draw, make_rect<cv::Rect>(roi), cv::Scalar(0, 165, 255), 2);
-        cv::putText(m_image_draw, std::to_string(score), cv::Point(roi.x, roi.y - 10), 1, 1.2, cv::Scalar(0, 165, 255),
-                    2);
+    // 靠近边缘的 roi 可能被裁小，同一批里的图尺寸必须一致
+    std::map<std::pair<int, int>, std::vector<size_t>> groups;
+    for (size_t i = 0; i < images.size(); ++i) {
+        groups[{ images[i].cols, images[i].rows }].emplace_back(i);
     }
-#endif
 
-    return SkillReadyResult {
-        .ready = ready,
-        .rect = roi,
-        .score = score,
-        .raw = raw_results,
-        .prob = prob,
-        .base_point = m_base_point,
-    };
+    auto context = OnnxSessions::get_instance().acquire(model_name);
+    const size_t batch_limit = context->batch_limit();
+    for (const auto& [size, indices] : groups) {
+        const auto& [cols, rows] = size;
+        const size_t image_size = static_cast<size_t>(cols) * rows * 3;
+        for (size_t begin = 0; begin < indices.size();) {
+            const size_t count = batch_limit == 0 ? indices.size() - begin
+                                                  : std::min(batch_limit, indices.size() - begin);
+
+            float* input = context->input({ static_cast<int64_t>(count), 3, cols, rows });
+            for (size_t i = 0; i < count; ++i) {
+                image_to_tensor(images[indices[begin + i]], input + i * image_size);
+            }
+            std::span<const float> output = context->run();
+            if (output.size() != count * std::tuple_size_v<Raw>) {
+                Log.error(__FUNCTION__, model_name, "unexpected output size", output.size(), count);
+            }
+            else {
+                for (size_t i = 0; i < count; ++i) {
+                    auto first = output.begin() + i * std::tuple_size_v<Raw>;
+                    std::copy(first, first + std::tuple_size_v<Raw>, raws[indices[begin + i]].begin());
+                }
+            }
+            begin += count;
+        }
+    }
+    return raws;
 }
 
-BattlefieldClassifier::DeployDirectionResult BattlefieldClassifier::deploy_direction_analyze() const
+std::vector<BattlefieldClassifier::SkillReadyResult>
+    BattlefieldClassifier::skill_ready_analyze(const std::vector<Point>& base_points) const
 {
-    const auto& task_ptr = Task.get<MatchTaskInfo>("BattleDeployDirectionRectMove");
-    const Rect& roi_move = task_ptr->rect_move;
-    Rect roi = Rect(m_base_point.x, m_base_point.y, 0, 0).move(roi_move);
+    auto task_ptr = Task.get<MatchTaskInfo>("BattleSkillReady");
+    const Rect& skill_roi_move = task_ptr->rect_move;
 
-    cv::Mat image = make_roi(m_image, correct_rect(roi, m_image));
-    std::vector<float> input = image_to_tensor(image);
+    std::vector<Rect> rois;
+    std::vector<cv::Mat> images;
+    for (const Point& base_point : base_points) {
+        Rect roi = Rect(base_point.x, base_point.y, 0, 0).move(skill_roi_move);
+        images.emplace_back(make_roi(m_image, correct_rect(roi, m_image)));
+        rois.emplace_back(roi);
+    }
 
-    auto memory_info = Ort::MemoryInfo::CreateCpu(OrtDeviceAllocator, OrtMemTypeCPU);
-    constexpr int64_t batch_size = 1;
-    std::array<int64_t, 4> input_shape { batch_size, image.channels(), image.cols, image.rows };
+    auto raws = infer_batch<SkillReadyResult::Raw>("skill_ready_cls", images);
 
-    Ort::Value input_tensor = Ort::Value::CreateTensor<float>(memory_info, input.data(), input.size(),
-                                                              input_shape.data(), input_shape.size());
+    std::vector<SkillReadyResult> results;
+    results.reserve(base_points.size());
+    for (size_t i = 0; i < base_points.size(); ++i) {
+        const SkillReadyResult::Raw& raw_results = raws[i];
+        const Rect& roi = rois[i];
+        Log.info(__FUNCTION__, "raw results:", raw_results);
 
-    DeployDirectionResult::Raw raw_results;
-    std::array<int64_t, 2> output_shape { batch_size, DeployDirectionResult::ClsSize };
-    Ort::Value output_tensor = Ort::Value::CreateTensor<float>(memory_info, raw_results.data(), raw_results.size(),
-                                                               output_shape.data(), output_shape.size());
+        SkillReadyResult::Prob prob = softmax(raw_results);
+        Log.info(__FUNCTION__, "prob:", prob);
+        bool ready = prob[1] > prob[0];
+        float score = std::max(prob[0], prob[1]);
 
-    auto& session = OnnxSessions::get_instance().get("deploy_direction_cls");
-    // 这俩是hardcode在模型里的
-    constexpr const char* input_names[] = { "input" };   // session.GetInputName()
-    constexpr const char* output_names[] = { "output" }; // session.GetOutputName()
+#ifdef ASST_DEBUG
+        if (ready) {
+            cv::rectangle(m_image_draw, make_rect<cv::Rect>(roi), cv::Scalar(0, 165, 255), 2);
+            cv::putText(m_image_draw, std::to_string(score), cv::Point(roi.x, roi.y - 10), 1, 1.2,
+                        cv::Scalar(0, 165, 255), 2);
+        }
+#endif
 
-    Ort::RunOptions run_options;
-    session.Run(run_options, input_names, &input_tensor, 1, output_names, &output_tensor, 1);
-    Log.info(__FUNCTION__, "raw result:", raw_results);
+        results.emplace_back(SkillReadyResult {
+            .ready = ready,
+            .rect = roi,
+            .score = score,
+            .raw = raw_results,
+            .prob = prob,
+            .base_point = base_points[i],
+        });
+    }
+    return results;
+}
+
+std::vector<BattlefieldClassifier::DeployDirectionResult>
+    BattlefieldClassifier::deploy_direction_analyze(const std::vector<Point>& base_points) const
+{
+    const auto& task_ptr = Task.get<MatchTaskInfo>("BattleDeployDirectionRectMove");
+    const Rect& roi_move = task_ptr->rect_move;
 
-    DeployDirectionResult::Prob prob = softmax(raw_results);
-    Log.info(__FUNCTION__, "after softmax:", prob);
+    std::vector<Rect> rois;
+    std::vector<cv::Mat> images;
+    for (const Point& base_point : base_points) {
+        Rect roi = Rect(base_point.x, base_point.y, 0, 0).move(roi_move);
+        images.emplace_back(make_roi(m_image, correct_rect(roi, m_image)));
+        rois.emplace_back(roi);
+    }
 
-    size_t class_id = std::max_element(prob.begin(), prob.end()) - prob.begin();
+    auto raws = infer_batch<DeployDirectionResult::Raw>("deploy_direction_cls", images);
 
 #ifdef ASST_DEBUG
     static const std::unordered_map<size_t, std::string> ClassNames = {
@@ -130,22 +174,39 @@ BattlefieldClassifier::DeployDirectionResult BattlefieldClassifier::deploy_direc
         { 2, "Left" },
         { 3, "Up" },
     };
-    if (ClassNames.size() != prob.size()) {
-        Log.error("ClassNames.size() != prob.size()", ClassNames.size(), prob.size());
-        throw std::runtime_error("ClassNames.size() != prob.size()");
+    if (ClassNames.size() != DeployDirectionResult::ClsSize) {
+        Log.error("ClassNames.size() != ClsSize", ClassNames.size(), DeployDirectionResult::ClsSize);
+        throw std::runtime_error("ClassNames.size() != ClsSize");
     }
-    cv::putText(m_image_draw, ClassNames.at(class_id), cv::Point(roi.x, roi.y + roi.height), cv::FONT_HERSHEY_PLAIN,
-                1.2, cv::Scalar(0, 255, 0), 2);
-    cv::putText(m_image_draw, std::to_string(prob[class_id]), cv::Point(roi.x, roi.y + roi.height + 20),
-                cv::FONT_HERSHEY_PLAIN, 1.2, cv::Scalar(0, 255, 0), 2);
 #endif
 
-    return DeployDirectionResult {
-        .direction = static_cast<battle::DeployDirection>(class_id),
-        .rect = roi,
-        .score = prob[class_id],
-        .raw = raw_results,
-        .prob = prob,
-        .base_point = m_base_point,
-    };
+    std::vector<DeployDirectionResult> results;
+    results.reserve(base_points.size());
+    for (size_t i = 0; i < base_points.size(); ++i) {
+        const DeployDirectionResult::Raw& raw_results = raws[i];
+        const Rect& roi = rois[i];
+        Log.info(__FUNCTION__, "raw result:", raw_results);
+
+        DeployDirectionResult::Prob prob = softmax(raw_results);
+        Log.info(__FUNCTION__, "after softmax:", prob);
+
+        size_t class_id = std::max_element(prob.begin(), prob.end()) - prob.begin();
+
+#ifdef ASST_DEBUG
+        cv::putText(m_image_draw, ClassNames.at(class_id), cv::Point(roi.x, roi.y + roi.height),
+                    cv::FONT_HERSHEY_PLAIN, 1.2, cv::Scalar(0, 255, 0), 2);
+        cv::putText(m_image_draw, std::to_string(prob[class_id]), cv::Point(roi.x, roi.y + roi.height + 20),
+                    cv::FONT_HERSHEY_PLAIN, 1.2, cv::Scalar(0, 255, 0), 2);
+#endif
+
+        results.emplace_back(DeployDirectionResult {
+            .direction = static_cast<battle::DeployDirection>(class_id),
+            .rect = roi,
+            .score = prob[class_id],
+            .raw = raw_results,
+            .prob = prob,
+            .base_point = base_points[i],
+        });
+    }
+    return results;
 }
@@ -55,6 +55,7 @@ namespace asst
         };
 
         using ResultOpt = std::optional<Result>;
+        using ResultsVec = std::vector<Result>;
 
     public:
         using VisionHelper::VisionHelper;
@@ -62,14 +63,21 @@ namespace asst
 
         void set_object_of_interest(ObjectOfInterest obj) { m_object_of_interest = obj; }
         void set_base_point(const Point& pt) { m_base_point = pt; }
+        void set_base_points(std::vector<Point> pts) { m_base_points = std::move(pts); }
 
         ResultOpt analyze() const;
+        // 识别 set_base_points 设置的所有位置，每个模型合成一批推理。结果与 base points 一一对应
+        ResultsVec analyze_batch() const;
 
     protected:
-        SkillReadyResult skill_ready_analyze() const;
-        DeployDirectionResult deploy_direction_analyze() const;
+        std::vector<SkillReadyResult> skill_ready_analyze(const std::vector<Point>& base_points) const;
+        std::vector<DeployDirectionResult> deploy_direction_analyze(const std::vector<Point>& base_points) const;
+
+        template <typename Raw>
+        static std::vector<Raw> infer_batch(const std::string& model_name, const std::vector<cv::Mat>& images);
 
         ObjectOfInterest m_object_of_interest; // 待识别的目标
         Point m_base_point;
+        std::vector<Point> m_base_points;
     };
 } // namespace asst
@@ -38,32 +38,16 @@ std::vector<BattlefieldDetector::OperatorResult> BattlefieldDetector::operator_a
     const double x_scale = 640.0 / m_image.cols;
     const double y_scale = 640.0 / m_image.rows;
 
-    cv::Mat image;
-    cv::resize(m_image, image, cv::Size(), x_scale, y_scale, cv::INTER_AREA);
-    std::vector<float> input = image_to_tensor(image);
-
-    auto memory_info = Ort::MemoryInfo::CreateCpu(OrtDeviceAllocator, OrtMemTypeCPU);
     constexpr int64_t batch_size = 1;
-    std::array<int64_t, 4> input_shape { batch_size, image.channels(), image.cols, image.rows };
-
-    Ort::Value input_tensor = Ort::Value::CreateTensor<float>(memory_info, input.data(), input.size(),
-                                                              input_shape.data(), input_shape.size());
-
-    auto& session = OnnxSessions::get_instance().get("operators_det");
-
-    Ort::AllocatorWithDefaultOptions allocator;
-    std::string input_name = session.GetInputNameAllocated(0, allocator).get();
-    std::string output_name = session.GetOutputNameAllocated(0, allocator).get();
-    std::vector input_names = { input_name.c_str() };
-    std::vector output_names = { output_name.c_str() };
-
-    Ort::RunOptions run_options;
-    auto output_tensors = session.Run(run_options, input_names.data(), &input_tensor, input_names.size(),
-                                      output_names.data(), output_names.size());
+    auto context = OnnxSessions::get_instance().acquire("operators_det");
+    // 缩放结果每次都是 640x640，用上下文里的缓冲区
+    cv::Mat& image = context->image_buffer;
+    cv::resize(m_image, image, cv::Size(), x_scale, y_scale, cv::INTER_AREA);
+    image_to_tensor(image, context->input({ batch_size, image.channels(), image.cols, image.rows }));
 
-    const float* raw_output = output_tensors[0].GetTensorData<float>();
+    const float* raw_output = context->run().data();
     // output_shape is { 1, 5, 8400 }
-    std::vector<int64_t> output_shape = output_tensors[0].GetTensorTypeAndShapeInfo().GetShape();
+    const std::vector<int64_t>& output_shape = context->output_shape();
 
     // yolov8 的 onnx 输出和前面的 v5, v7 等似乎不太一样，目前网上 yolov8 的 demo 较少，文档也没找到
     // 这里的输出解析是我跟着数据推测的：
@@ -73,10 +57,9 @@ std::vector<BattlefieldDetector::OperatorResult> BattlefieldDetector::operator_a
     // h0, h1, ..... h8399
     // conf0, conf1, ..... conf8399
     // 如果后面要做多分类，可能得再看下怎么改（我也不知道shape会变成啥样）
-    std::vector<std::vector<float>> output(output_shape[1]);
-    for (int64_t i = 0; i < output_shape[1]; i++) {
-        output[i] = std::vector<float>(raw_output + i * output_shape[2], raw_output + (i + 1) * output_shape[2]);
-    }
+    // 直接按行读输出，不再拷贝一份
+    const size_t box_count = static_cast<size_t>(output_shape[2]);
+    auto output = [&](int64_t row) { return raw_output + static_cast<size_t>(row) * box_count; };
 
 #ifdef ASST_DEBUG
 
@@ -86,18 +69,18 @@ std::vector<BattlefieldDetector::OperatorResult> BattlefieldDetector::operator_a
 #endif
 
     std::vector<OperatorResult> all_results;
-    const auto& conf_vec = output.back();
-    for (size_t i = 0; i < conf_vec.size(); ++i) {
+    const float* conf_vec = output(output_shape[1] - 1);
+    for (size_t i = 0; i < box_count; ++i) {
         float score = conf_vec[i];
         constexpr float Threshold = 0.3f;
         if (score < Threshold) {
             continue;
         }
 
-        int center_x = static_cast<int>(output[0][i] / x_scale);
-        int center_y = static_cast<int>(output[1][i] / y_scale);
-        int w = static_cast<int>(output[2][i] / x_scale);
-        int h = static_cast<int>(output[3][i] / y_scale);
+        int center_x = static_cast<int>(output(0)[i] / x_scale);
+        int center_y = static_cast<int>(output(1)[i] / y_scale);
+        int w = static_cast<int>(output(2)[i] / x_scale);
+        int h = static_cast<int>(output(3)[i] / y_scale);
 
         int x = center_x - w / 2;
         int y = center_y - h / 2;
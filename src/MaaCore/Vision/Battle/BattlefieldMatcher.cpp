@@ -2,12 +2,16 @@
 
 #include "Utils/Ranges.hpp"
 #include <algorithm>
+#include <atomic>
+#include <future>
 
 #include "Utils/NoWarningCV.h"
 
+#include "Config/GeneralConfig.h"
 #include "Config/TaskData.h"
 #include "Config/TemplResource.h"
 #include "Utils/Logger.hpp"
+#include "Utils/WorkerPool.hpp"
 #include "Vision/BestMatcher.h"
 #include "Vision/Matcher.h"
 #include "Vision/MultiMatcher.h"
@@ -26,8 +30,17 @@ void BattlefieldMatcher::set_total_kills_prompt(int prompt)
     m_total_kills_prompt = prompt;
 }
 
+bool BattlefieldMatcher::parallel_enabled() const
+{
+    return m_parallel.value_or(Config.get_options().parallel_battle_analyze);
+}
+
 BattlefieldMatcher::ResultOpt BattlefieldMatcher::analyze() const
 {
+    if (parallel_enabled()) {
+        return analyze_parallel();
+    }
+
     Result result;
 
     if (m_object_of_interest.flag) {
@@ -68,6 +81,95 @@ BattlefieldMatcher::ResultOpt BattlefieldMatcher::analyze() const
     return result;
 }
 
+BattlefieldMatcher::ResultOpt BattlefieldMatcher::analyze_parallel() const
+{
+    // 子识别里用到的任务先在当前线程取一遍，TaskData 的惰性生成不是线程安全的
+    static const std::vector<std::string> UsedTasks = {
+        "BattleHasStarted",    "BattleHpFlag",         "BattleHpFlag2",       "BattleKillsFlag",
+        "BattleKills",         "BattleCostData",       "BattleSpeedButton",   "NumberOcrReplace",
+        "BattleOpersFlag",     "BattleOperClickRange", "BattleOperRoleRange", "BattleOperAvailable",
+        "BattleOperCooling",   "BattleOperAvatar",     "BattleOperCost",      "BattleOperRole",
+    };
+    for (const std::string& name : UsedTasks) {
+        std::ignore = Task.get(name);
+    }
+
+    auto& pool = WorkerPool::get_instance();
+    // 前面的识别失败后结果就用不上了，还没开始的任务直接返回
+    std::atomic_bool abandoned = false;
+    auto submit = [&](auto func) {
+        return pool.submit([&abandoned, func]() {
+            using ReturnT = std::invoke_result_t<decltype(func)>;
+            return abandoned ? ReturnT {} : func();
+        });
+    };
+
+    std::future<std::pair<bool, bool>> flag_future; // { pause_button, in_battle }
+    std::future<std::vector<battle::DeploymentOper>> deployment_future;
+    std::future<std::optional<std::pair<int, int>>> kills_future;
+    std::future<std::optional<int>> costs_future;
+    std::future<bool> speed_button_future;
+
+    if (m_object_of_interest.flag) {
+        flag_future = submit([this]() {
+            bool pause_button = pause_button_analyze();
+            bool in_battle = pause_button || hp_flag_analyze() || kills_flag_analyze();
+            return std::make_pair(pause_button, in_battle);
+        });
+    }
+    if (m_object_of_interest.deployment) {
+        deployment_future = submit([this]() { return deployment_analyze(); });
+    }
+    if (m_object_of_interest.kills) {
+        kills_future = submit([this]() { return kills_analyze(); });
+    }
+    if (m_object_of_interest.costs) {
+        costs_future = submit([this]() { return costs_analyze(); });
+    }
+    if (m_object_of_interest.speed_button) {
+        speed_button_future = submit([this]() { return speed_button_analyze(); });
+    }
+
+    // 按串行时的顺序汇总结果。任务都引用了 this，提前失败也要等它们全部结束再返回
+    Result result;
+    bool failed = false;
+    auto fail = [&]() {
+        failed = true;
+        abandoned = true;
+    };
+
+    if (flag_future.valid()) {
+        auto [pause_button, in_battle] = pool.wait(flag_future);
+        result.pause_button = pause_button;
+        if (!in_battle) {
+            fail();
+        }
+    }
+    if (deployment_future.valid()) {
+        result.deployment = pool.wait(deployment_future);
+    }
+    if (kills_future.valid()) {
+        result.kills = pool.wait(kills_future);
+        if (!result.kills) {
+            fail();
+        }
+    }
+    if (costs_future.valid()) {
+        result.costs = pool.wait(costs_future);
+        if (!result.costs) {
+            fail();
+        }
+    }
+    if (speed_button_future.valid()) {
+        result.speed_button = pool.wait(speed_button_future);
+    }
+
+    if (failed) {
+        return std::nullopt;
+    }
+    return result;
+}
+
 std::vector<battle::DeploymentOper> BattlefieldMatcher::deployment_analyze() const
 {
     MultiMatcher flags_analyzer(m_image);
@@ -85,6 +187,41 @@ std::vector<battle::DeploymentOper> BattlefieldMatcher::deployment_analyze() con
     auto& flags = flag_opt.value();
     sort_by_horizontal_(flags);
 
+    // 每张卡片的识别互不相关，并行时各自一个任务，结果按卡片顺序汇总
+    std::vector<std::optional<battle::DeploymentOper>> opers(flags.size());
+    if (parallel_enabled() && flags.size() > 1) {
+        auto& pool = WorkerPool::get_instance();
+        std::vector<std::future<std::optional<battle::DeploymentOper>>> futures;
+        futures.reserve(flags.size());
+        for (const auto& flag_res : flags) {
+            futures.emplace_back(
+                pool.submit([this, flag_rect = flag_res.rect]() { return deployment_oper_analyze(flag_rect); }));
+        }
+        for (size_t i = 0; i < futures.size(); ++i) {
+            opers[i] = pool.wait(futures[i]);
+        }
+    }
+    else {
+        for (size_t i = 0; i < flags.size(); ++i) {
+            opers[i] = deployment_oper_analyze(flags[i].rect);
+        }
+    }
+
+    std::vector<battle::DeploymentOper> oper_result;
+    size_t index = 0;
+    for (auto& oper : opers) {
+        if (!oper) {
+            continue;
+        }
+        oper->index = index++;
+        oper_result.emplace_back(std::move(*oper));
+    }
+
+    return oper_result;
+}
+
+std::optional<battle::DeploymentOper> BattlefieldMatcher::deployment_oper_analyze(const Rect& flag_rect) const
+{
     const Rect& click_move = Task.get("BattleOperClickRange")->rect_move;
     const Rect& role_move = Task.get("BattleOperRoleRange")->rect_move;
     const Rect& avlb_move = Task.get("BattleOperAvailable")->rect_move;
@@ -92,52 +229,44 @@ std::vector<battle::DeploymentOper> BattlefieldMatcher::deployment_analyze() con
     const Rect& avatar_move = Task.get("BattleOperAvatar")->rect_move;
     const Rect& cost_move = Task.get("BattleOperCost")->rect_move;
 
-    std::vector<battle::DeploymentOper> oper_result;
-    size_t index = 0;
-    for (const auto& flag_res : flags) {
-        battle::DeploymentOper oper;
-        oper.rect = flag_res.rect.move(click_move);
-
-        Rect role_rect = flag_res.rect.move(role_move);
-        oper.role = oper_role_analyze(role_rect);
-        if (oper.role == battle::Role::Unknown) {
-            Log.warn("Unknown role");
-            continue;
-        }
+    battle::DeploymentOper oper;
+    oper.rect = flag_rect.move(click_move);
 
-        if (oper.rect.x + oper.rect.width >= m_image.cols) {
-            oper.rect.width = m_image.cols - oper.rect.x;
-        }
-        Rect avatar_rect = oper.rect.move(avatar_move);
-        oper.avatar = m_image(make_rect<cv::Rect>(avatar_rect));
+    Rect role_rect = flag_rect.move(role_move);
+    oper.role = oper_role_analyze(role_rect);
+    if (oper.role == battle::Role::Unknown) {
+        Log.warn("Unknown role");
+        return std::nullopt;
+    }
+
+    if (oper.rect.x + oper.rect.width >= m_image.cols) {
+        oper.rect.width = m_image.cols - oper.rect.x;
+    }
+    Rect avatar_rect = oper.rect.move(avatar_move);
+    oper.avatar = m_image(make_rect<cv::Rect>(avatar_rect));
 
-        Rect available_rect = flag_res.rect.move(avlb_move);
-        oper.available = oper_available_analyze(available_rect);
+    Rect available_rect = flag_rect.move(avlb_move);
+    oper.available = oper_available_analyze(available_rect);
 
 #ifdef ASST_DEBUG
-        if (oper.available) {
-            cv::rectangle(m_image_draw, make_rect<cv::Rect>(oper.rect), cv::Scalar(0, 255, 0), 2);
-        }
-        else {
-            cv::rectangle(m_image_draw, make_rect<cv::Rect>(oper.rect), cv::Scalar(0, 0, 255), 2);
-        }
+    if (oper.available) {
+        cv::rectangle(m_image_draw, make_rect<cv::Rect>(oper.rect), cv::Scalar(0, 255, 0), 2);
+    }
+    else {
+        cv::rectangle(m_image_draw, make_rect<cv::Rect>(oper.rect), cv::Scalar(0, 0, 255), 2);
+    }
 #endif
 
-        Rect cooling_rect = correct_rect(flag_res.rect.move(cooling_move), m_image);
-        oper.cooling = oper_cooling_analyze(cooling_rect);
-        if (oper.cooling && oper.available) {
-            Log.error("oper is available, but with cooling");
-        }
-
-        Rect cost_rect = correct_rect(flag_res.rect.move(cost_move), m_image);
-        oper.cost = oper_cost_analyze(cost_rect);
-
-        oper.index = index++;
-
-        oper_result.emplace_back(std::move(oper));
+    Rect cooling_rect = correct_rect(flag_rect.move(cooling_move), m_image);
+    oper.cooling = oper_cooling_analyze(cooling_rect);
+    if (oper.cooling && oper.available) {
+        Log.error("oper is available, but with cooling");
     }
 
-    return oper_result;
+    Rect cost_rect = correct_rect(flag_rect.move(cost_move), m_image);
+    oper.cost = oper_cost_analyze(cost_rect);
+
+    return oper;
 }
 
 battle::Role BattlefieldMatcher::oper_role_analyze(const Rect& roi) const
@@ -40,15 +40,20 @@ namespace asst
 
         void set_object_of_interest(ObjectOfInterest obj);
         void set_total_kills_prompt(int prompt);
+        // 不设置时使用配置里的 parallelBattleAnalyze
+        void set_parallel(bool enable) noexcept { m_parallel = enable; }
 
         ResultOpt analyze() const;
 
     protected:
+        bool parallel_enabled() const;
+        ResultOpt analyze_parallel() const;
         bool hp_flag_analyze() const;
         bool kills_flag_analyze() const;
         bool pause_button_analyze() const;
 
         std::vector<battle::DeploymentOper> deployment_analyze() const; // 识别干员
+        std::optional<battle::DeploymentOper> deployment_oper_analyze(const Rect& flag_rect) const;
         battle::Role oper_role_analyze(const Rect& roi) const;
         bool oper_cooling_analyze(const Rect& roi) const;
         int oper_cost_analyze(const Rect& roi) const;
@@ -61,5 +66,6 @@ namespace asst
 
         ObjectOfInterest m_object_of_interest; // 待识别的目标
         int m_total_kills_prompt = 0; // 之前的击杀总数，因为击杀数经常识别不准所以依赖外部传入作为参考
+        std::optional<bool> m_parallel;
     };
 } // namespace asst
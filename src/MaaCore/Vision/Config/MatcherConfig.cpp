@@ -1,6 +1,7 @@
 #include "MatcherConfig.h"
 
 #include "Config/TaskData.h"
+#include "Vision/FrameCache.h"
 
 using namespace asst;
 
@@ -55,3 +56,22 @@ void MatcherConfig::_set_task_info(MatchTaskInfo task_info)
 
     _set_roi(task_info.roi);
 }
+
+std::optional<std::string> MatcherConfig::cache_key(std::string_view kind, const Rect& roi) const
+{
+    FrameCache::Key key(kind);
+    key << roi << m_params.templs.size();
+    for (const auto& templ : m_params.templs) {
+        if (!std::holds_alternative<std::string>(templ)) {
+            return std::nullopt;
+        }
+        key << std::get<std::string>(templ);
+    }
+    key << m_params.templ_thres.size();
+    for (double thres : m_params.templ_thres) {
+        key << thres;
+    }
+    key << m_params.mask_range.first << m_params.mask_range.second << m_params.mask_with_src
+        << m_params.mask_with_close;
+    return std::move(key).str();
+}
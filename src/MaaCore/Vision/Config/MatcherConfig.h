@@ -3,6 +3,8 @@
 #include "Common/AsstTypes.h"
 #include "Utils/NoWarningCVMat.h"
 
+#include <optional>
+#include <string_view>
 #include <variant>
 
 namespace asst
@@ -38,6 +40,8 @@ namespace asst
         virtual void _set_roi(const Rect& roi) = 0;
 
         void _set_task_info(MatchTaskInfo task_info);
+        // 帧缓存用的 key。直接给 cv::Mat 模板时无法区分不同的模板，返回 std::nullopt，不走缓存
+        std::optional<std::string> cache_key(std::string_view kind, const Rect& roi) const;
 
     protected:
         Params m_params;
@@ -0,0 +1,67 @@
+#include "FrameCache.h"
+
+using namespace asst;
+
+void FrameCache::register_frame(const void* owner, const cv::Mat& frame)
+{
+    if (frame.empty()) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    Slot& slot = m_slots[owner];
+    slot.frame = frame;
+    slot.entries.clear();
+}
+
+void FrameCache::release(const void* owner)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_slots.erase(owner);
+}
+
+std::optional<FrameCache::Value> FrameCache::find_value(const cv::Mat& image, const std::string& key)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    Slot* slot = find_slot(image);
+    if (!slot) {
+        return std::nullopt;
+    }
+    auto iter = slot->entries.find(key);
+    if (iter == slot->entries.end()) {
+        ++m_stats.misses;
+        return std::nullopt;
+    }
+    ++m_stats.hits;
+    return iter->second;
+}
+
+void FrameCache::store(const cv::Mat& image, std::string key, Value value)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (Slot* slot = find_slot(image)) {
+        slot->entries.insert_or_assign(std::move(key), std::move(value));
+    }
+}
+
+FrameCache::Stats FrameCache::get_stats() const
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+FrameCache::Slot* FrameCache::find_slot(const cv::Mat& image)
+{
+    if (image.empty()) {
+        return nullptr;
+    }
+    for (auto& [owner, slot] : m_slots) {
+        const cv::Mat& frame = slot.frame;
+        // 截取出来的子图数据指针或尺寸不同，不会被当成整帧
+        if (frame.data == image.data && frame.size == image.size && frame.type() == image.type() &&
+            frame.step[0] == image.step[0]) {
+            return &slot;
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstring>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include "Common/AsstTypes.h"
+#include "Utils/NoWarningCVMat.h"
+#include "Utils/SingletonHolder.hpp"
+
+namespace asst
+{
+    // 单帧内的识别结果缓存。同一张截图上，流程任务、插件、战斗中的各项检查经常对同样的模板 + ROI
+    // 或者同样的 OCR 模型 + ROI 重复识别，这里按 帧 + 参数 记下结果，重复的查询直接返回。
+    // 只有 Controller 登记过的截图才会缓存：登记时持有一份引用，缓冲区在缓存期间不会被帧缓冲池复用，
+    // 所以可以直接用数据指针区分不同的帧。每个 Controller 只保留最新的一帧，前一帧的结果随之丢弃。
+    // 登记过的截图不要再原地修改
+    class FrameCache final : public SingletonHolder<FrameCache>
+    {
+    public:
+        using Value = std::variant<std::optional<MatchRect>, std::vector<MatchRect>, std::vector<TextRect>>;
+
+        // 把识别参数拼成二进制的 key，数值按原始字节写入，避免浮点数转字符串丢精度
+        class Key
+        {
+        public:
+            explicit Key(std::string_view kind) { *this << kind; }
+
+            Key& operator<<(std::string_view str)
+            {
+                *this << str.size();
+                m_data.append(str);
+                return *this;
+            }
+            template <typename T>
+            requires std::is_arithmetic_v<T>
+            Key& operator<<(T value)
+            {
+                char bytes[sizeof(T)];
+                std::memcpy(bytes, &value, sizeof(T));
+                m_data.append(bytes, sizeof(T));
+                return *this;
+            }
+            Key& operator<<(const Rect& rect) { return *this << rect.x << rect.y << rect.width << rect.height; }
+
+            std::string&& str() && noexcept { return std::move(m_data); }
+
+        private:
+            std::string m_data;
+        };
+
+        struct Stats
+        {
+            size_t hits = 0;   // 直接返回缓存结果的次数
+            size_t misses = 0; // 登记过的帧上没命中、需要实际识别的次数
+        };
+
+    public:
+        virtual ~FrameCache() override = default;
+
+        // owner 用来区分不同的 Controller，新登记的帧会替换掉同一 owner 之前的帧
+        void register_frame(const void* owner, const cv::Mat& frame);
+        void release(const void* owner);
+
+        // 没登记过的图返回 std::nullopt 且不计入统计
+        template <typename T>
+        std::optional<T> find(const cv::Mat& image, const std::string& key)
+        {
+            auto value = find_value(image, key);
+            if (!value) {
+                return std::nullopt;
+            }
+            return std::get<T>(std::move(*value));
+        }
+        void store(const cv::Mat& image, std::string key, Value value);
+
+        Stats get_stats() const;
+
+    private:
+        friend class SingletonHolder<FrameCache>;
+        FrameCache() = default;
+
+        struct Slot
+        {
+            cv::Mat frame;
+            std::unordered_map<std::string, Value> entries;
+        };
+
+        std::optional<Value> find_value(const cv::Mat& image, const std::string& key);
+        // 调用方需持有 m_mutex
+        Slot* find_slot(const cv::Mat& image);
+
+        mutable std::mutex m_mutex;
+        std::unordered_map<const void*, Slot> m_slots;
+        Stats m_stats;
+    };
+}
@@ -0,0 +1,96 @@
+#include "FrameFingerprint.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+using namespace asst;
+
+namespace
+{
+    constexpr uint64_t HashPrime = 0x9E3779B97F4A7C15ULL;
+
+    inline uint64_t hash_mix(uint64_t hash, uint64_t value) noexcept
+    {
+        return std::rotl((hash ^ value) * HashPrime, 31);
+    }
+}
+
+FrameFingerprint::FrameFingerprint(const cv::Mat& image)
+{
+    if (image.empty()) {
+        return;
+    }
+    m_width = image.cols;
+    m_height = image.rows;
+    m_cols = (m_width + CellSize - 1) / CellSize;
+    m_rows = (m_height + CellSize - 1) / CellSize;
+    m_cells.assign(static_cast<size_t>(m_cols) * m_rows, 0);
+
+    const size_t pixel_size = image.elemSize();
+    for (int y = 0; y < m_height; ++y) {
+        const uchar* row = image.ptr<uchar>(y);
+        uint64_t* cells = m_cells.data() + static_cast<size_t>(y / CellSize) * m_cols;
+        for (int c = 0; c < m_cols; ++c) {
+            const int x_beg = c * CellSize;
+            const int x_end = std::min(x_beg + CellSize, m_width);
+            const uchar* seg = row + x_beg * pixel_size;
+            cells[c] = hash_bytes(seg, (x_end - x_beg) * pixel_size, cells[c]);
+        }
+    }
+}
+
+uint64_t FrameFingerprint::roi_hash(const Rect& roi) const
+{
+    if (m_cells.empty()) {
+        return 0;
+    }
+    int x_beg = 0, y_beg = 0, x_end = m_width, y_end = m_height;
+    if (!roi.empty()) {
+        x_beg = std::clamp(roi.x, 0, m_width);
+        y_beg = std::clamp(roi.y, 0, m_height);
+        x_end = std::clamp(roi.x + roi.width, x_beg, m_width);
+        y_end = std::clamp(roi.y + roi.height, y_beg, m_height);
+    }
+
+    const int c_beg = x_beg / CellSize;
+    const int c_end = (x_end + CellSize - 1) / CellSize;
+    const int r_beg = y_beg / CellSize;
+    const int r_end = (y_end + CellSize - 1) / CellSize;
+
+    uint64_t hash = hash_mix(static_cast<uint64_t>(c_beg) << 48 | static_cast<uint64_t>(r_beg) << 32,
+                             static_cast<uint64_t>(c_end) << 16 | static_cast<uint64_t>(r_end));
+    for (int r = r_beg; r < r_end; ++r) {
+        for (int c = c_beg; c < c_end; ++c) {
+            hash = hash_mix(hash, m_cells[static_cast<size_t>(r) * m_cols + c]);
+        }
+    }
+    return hash;
+}
+
+uint64_t FrameFingerprint::hash_bytes(const uchar* data, size_t size, uint64_t seed) noexcept
+{
+    // 四路相互独立的累加，方便编译器和 CPU 并行
+    uint64_t lanes[4] = { seed, seed ^ 0x243F6A8885A308D3ULL, seed ^ 0x13198A2E03707344ULL,
+                          seed ^ 0xA4093822299F31D0ULL };
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        for (size_t lane = 0; lane < 4; ++lane) {
+            uint64_t word = 0;
+            std::memcpy(&word, data + i + lane * 8, sizeof(word));
+            lanes[lane] = hash_mix(lanes[lane], word);
+        }
+    }
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word = 0;
+        std::memcpy(&word, data + i, sizeof(word));
+        lanes[0] = hash_mix(lanes[0], word);
+    }
+    if (i < size) {
+        uint64_t word = 0;
+        std::memcpy(&word, data + i, size - i);
+        lanes[1] = hash_mix(lanes[1], word);
+    }
+
+    return hash_mix(hash_mix(hash_mix(lanes[0], lanes[1]), lanes[2]), lanes[3] ^ size);
+}
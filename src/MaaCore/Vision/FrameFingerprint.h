@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Common/AsstTypes.h"
+#include "Utils/NoWarningCVMat.h"
+
+namespace asst
+{
+    // 帧指纹：把图像切成固定大小的格子，逐格对全分辨率的像素计算哈希（不做降采样，避免漏掉个别像素的变化）
+    // 用于判断某个 ROI 内的画面相比之前是否发生过变化
+    class FrameFingerprint
+    {
+    public:
+        static constexpr int CellSize = 32;
+
+    public:
+        FrameFingerprint() = default;
+        explicit FrameFingerprint(const cv::Mat& image);
+
+        bool empty() const noexcept { return m_cells.empty(); }
+        // ROI 覆盖到的所有格子的哈希再合成一个，ROI 为空则表示全图
+        uint64_t roi_hash(const Rect& roi) const;
+
+    private:
+        static uint64_t hash_bytes(const uchar* data, size_t size, uint64_t seed) noexcept;
+
+        int m_width = 0;
+        int m_height = 0;
+        int m_cols = 0;
+        int m_rows = 0;
+        std::vector<uint64_t> m_cells;
+    };
+}
@@ -1,5 +1,8 @@
 #include "Hasher.h"
 
+#include <bit>
+#include <charconv>
+
 #include "Utils/NoWarningCV.h"
 
 #include "Utils/Logger.hpp"
@@ -32,21 +35,22 @@ bool asst::Hasher::analyze()
         if (m_need_bound) {
             to_hash = bound_bin(to_hash);
         }
-        std::string hash_result = s_hash(to_hash);
-        // Log.debug(hash_result);
+        HashValue hash_result = s_hash(to_hash);
+        // Log.debug(to_string(hash_result));
 
         int min_dist = INT_MAX;
-        std::string cur_min_dist_name;
-        for (auto&& [name, templ] : m_hash_templates) {
-            int hm = hamming(hash_result, templ);
-            // Log.debug(name, "dist:", hm);
+        size_t min_dist_index = m_templ_hashes.size();
+        for (size_t i = 0; i < m_templ_hashes.size() && min_dist > 0; ++i) {
+            int hm = hamming(hash_result, m_templ_hashes[i]);
+            // Log.debug(m_templ_names[i], "dist:", hm);
             if (hm < min_dist) {
-                cur_min_dist_name = name;
+                min_dist_index = i;
                 min_dist = hm;
             }
         }
-        m_min_dist_name.emplace_back(std::move(cur_min_dist_name));
-        m_hash_result.emplace_back(std::move(hash_result));
+        m_min_dist_name.emplace_back(min_dist_index < m_templ_names.size() ? m_templ_names[min_dist_index]
+                                                                           : std::string());
+        m_hash_result.emplace_back(hash_result);
     }
 
     return true;
@@ -62,9 +66,21 @@ void asst::Hasher::set_mask_range(std::pair<int, int> mask_range) noexcept
     m_mask_range = std::move(mask_range);
 }
 
-void asst::Hasher::set_hash_templates(std::unordered_map<std::string, std::string> hash_templates) noexcept
+void asst::Hasher::set_hash_templates(const std::unordered_map<std::string, std::string>& hash_templates)
 {
-    m_hash_templates = std::move(hash_templates);
+    m_templ_names.clear();
+    m_templ_hashes.clear();
+    m_templ_names.reserve(hash_templates.size());
+    m_templ_hashes.reserve(hash_templates.size());
+    for (const auto& [name, templ] : hash_templates) {
+        auto hash_opt = from_string(templ);
+        if (!hash_opt) {
+            Log.warn(__FUNCTION__, "invalid hash", name, templ);
+            continue;
+        }
+        m_templ_names.emplace_back(name);
+        m_templ_hashes.emplace_back(*hash_opt);
+    }
 }
 
 void asst::Hasher::set_need_split(bool need_split) noexcept
@@ -82,12 +98,12 @@ const std::vector<std::string>& asst::Hasher::get_min_dist_name() const noexcept
     return m_min_dist_name;
 }
 
-const std::vector<std::string>& asst::Hasher::get_hash() const noexcept
+const std::vector<asst::Hasher::HashValue>& asst::Hasher::get_hash() const noexcept
 {
     return m_hash_result;
 }
 
-std::string asst::Hasher::s_hash(const cv::Mat& img)
+asst::Hasher::HashValue asst::Hasher::s_hash(const cv::Mat& img)
 {
     static constexpr int HashKernelSize = 16;
     cv::Mat resized;
@@ -97,19 +113,50 @@ std::string asst::Hasher::s_hash(const cv::Mat& img)
         cv::cvtColor(resized, temp, cv::COLOR_BGR2GRAY);
         resized = temp;
     }
-    std::stringstream hash_value;
-    uchar* pix = resized.data;
-    int tmp_dec = 0;
-    for (int ro = 0; ro < 256; ro++) {
-        tmp_dec = tmp_dec << 1;
-        if (*pix > 127) tmp_dec++;
-        if (ro % 4 == 3) {
-            hash_value << std::hex << tmp_dec;
-            tmp_dec = 0;
+    HashValue hash_value {};
+    const uchar* pix = resized.ptr<uchar>();
+    for (uint64_t& word : hash_value) {
+        for (int bit = 0; bit < 64; ++bit, ++pix) {
+            word = (word << 1) | (*pix > 127 ? 1 : 0);
+        }
+    }
+    return hash_value;
+}
+
+std::string asst::Hasher::to_string(const HashValue& hash)
+{
+    static constexpr char HexDigits[] = "0123456789abcdef";
+
+    std::string result(hash.size() * 16, '0');
+    auto out = result.begin();
+    for (uint64_t word : hash) {
+        for (int shift = 60; shift >= 0; shift -= 4) {
+            *out++ = HexDigits[(word >> shift) & 0xf];
         }
-        pix++;
     }
-    return hash_value.str();
+    return result;
+}
+
+std::optional<asst::Hasher::HashValue> asst::Hasher::from_string(std::string_view hash)
+{
+    static constexpr size_t HexLength = std::tuple_size_v<HashValue> * 16;
+    if (hash.size() > HexLength) {
+        return std::nullopt;
+    }
+    // 和以前的字符串比较一样，短的在前面补 0
+    std::string padded(HexLength - hash.size(), '0');
+    padded.append(hash);
+
+    HashValue result {};
+    for (size_t i = 0; i < result.size(); ++i) {
+        const char* begin = padded.data() + i * 16;
+        const char* end = begin + 16;
+        auto [ptr, ec] = std::from_chars(begin, end, result[i], 16);
+        if (ec != std::errc() || ptr != end) {
+            return std::nullopt;
+        }
+    }
+    return result;
 }
 
 std::vector<cv::Mat> asst::Hasher::split_bin(const cv::Mat& bin)
@@ -152,20 +199,11 @@ cv::Mat asst::Hasher::bound_bin(const cv::Mat& bin)
     return bin(cv::boundingRect(bin));
 }
 
-int asst::Hasher::hamming(std::string hash1, std::string hash2)
+int asst::Hasher::hamming(const HashValue& hash1, const HashValue& hash2) noexcept
 {
-    static constexpr int HammingFlags = 64;
-
-    hash1.insert(hash1.begin(), HammingFlags - hash1.size(), '0');
-    hash2.insert(hash2.begin(), HammingFlags - hash2.size(), '0');
     int dist = 0;
-    for (int i = 0; i < HammingFlags; i = i + 16) {
-        unsigned long long x =
-            strtoull(hash1.substr(i, 16).c_str(), nullptr, 16) ^ strtoull(hash2.substr(i, 16).c_str(), nullptr, 16);
-        while (x) {
-            ++dist;
-            x = x & (x - 1);
-        }
+    for (size_t i = 0; i < hash1.size(); ++i) {
+        dist += std::popcount(hash1[i] ^ hash2[i]);
     }
     return dist;
 }
@@ -1,6 +1,10 @@
 #pragma once
 #include "VisionHelper.h"
 
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string_view>
 #include <unordered_map>
 
 namespace asst
@@ -8,6 +12,10 @@ namespace asst
     // FIXME: 删掉这个类，以及对应的 task 类型
     class Hasher : public VisionHelper
     {
+    public:
+        // 16x16 的感知哈希，共 256 位。按像素行优先从高位到低位排，和字符串形式的十六进制位一一对应
+        using HashValue = std::array<uint64_t, 4>;
+
     public:
         using VisionHelper::VisionHelper;
         virtual ~Hasher() override = default;
@@ -16,25 +24,31 @@ namespace asst
 
         void set_mask_range(int lower, int upper) noexcept;
         void set_mask_range(std::pair<int, int> mask_range) noexcept;
-        void set_hash_templates(std::unordered_map<std::string, std::string> hash_templates) noexcept;
+        // 模板是配置里的十六进制字符串，设置时就转成 HashValue，解析失败的会被忽略
+        void set_hash_templates(const std::unordered_map<std::string, std::string>& hash_templates);
         void set_need_split(bool need_split) noexcept;
         void set_need_bound(bool need_bound) noexcept;
 
         const std::vector<std::string>& get_min_dist_name() const noexcept;
-        const std::vector<std::string>& get_hash() const noexcept;
+        const std::vector<HashValue>& get_hash() const noexcept;
 
-        static std::string s_hash(const cv::Mat& img);
-        static int hamming(std::string hash1, std::string hash2);
+        static HashValue s_hash(const cv::Mat& img);
+        static int hamming(const HashValue& hash1, const HashValue& hash2) noexcept;
+        // 字符串形式只用于和配置文件互转
+        static std::string to_string(const HashValue& hash);
+        static std::optional<HashValue> from_string(std::string_view hash);
         static std::vector<cv::Mat> split_bin(const cv::Mat& bin);
         static cv::Mat bound_bin(const cv::Mat& bin);
 
     protected:
         std::pair<int, int> m_mask_range;
-        std::unordered_map<std::string, std::string> m_hash_templates;
+        // 名字和哈希分开存，比较时只顺序扫连续的哈希数组
+        std::vector<std::string> m_templ_names;
+        std::vector<HashValue> m_templ_hashes;
         bool m_need_split = false;
         bool m_need_bound = false;
 
-        std::vector<std::string> m_hash_result;
+        std::vector<HashValue> m_hash_result;
         std::vector<std::string> m_min_dist_name;
     };
 }
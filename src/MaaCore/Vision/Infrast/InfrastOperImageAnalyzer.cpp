@@ -1,10 +1,13 @@
 #include "InfrastOperImageAnalyzer.h"
 
+#include <algorithm>
+
 #include "Utils/NoWarningCV.h"
 #include "Utils/Ranges.hpp"
 
 #include "Config/Miscellaneous/InfrastConfig.h"
 #include "Config/TaskData.h"
+#include "InfrastSkillClassifier.h"
 #include "InfrastSmileyImageAnalyzer.h"
 #include "Utils/Logger.hpp"
 #include "Vision/Hasher.h"
@@ -166,29 +169,20 @@ void asst::InfrastOperImageAnalyzer::mood_analyze()
         cv::Mat prg_gray;
         cv::cvtColor(prg_image, prg_gray, cv::COLOR_BGR2GRAY);
 
+        // 每行从最左边开始数连续的进度条像素：颜色需要大于最低阈值，且与左边相邻点的差值不能过大。
+        // 先整块算出每个点是否满足条件，再逐行找第一个不满足的点
+        cv::Mat gray16, left16;
+        prg_gray.convertTo(gray16, CV_16S);
+        cv::copyMakeBorder(gray16.colRange(0, gray16.cols - 1), left16, 0, 0, 1, 0, cv::BORDER_CONSTANT,
+                           cv::Scalar(prg_lower_limit));
+        cv::Mat left_diff = left16 - gray16;
+        cv::Mat is_white = (gray16 >= prg_lower_limit) & (left_diff < prg_diff_thres);
+
         int max_white_length = 0; // 最长横扫的白色长度，即作为进度条长度
-        for (int i = 0; i != prg_gray.rows; ++i) {
-            int cur_white_length = 0;
-            cv::uint8_t left_value = prg_lower_limit;
-            for (int j = 0; j != prg_gray.cols; ++j) {
-                auto value = prg_gray.at<cv::uint8_t>(i, j);
-                // 当前点的颜色，需要大于最低阈值；且与相邻点的差值不能过大，否则就认为当前点不是进度条
-                if (value >= prg_lower_limit && left_value < value + prg_diff_thres) {
-                    left_value = value;
-                    ++cur_white_length;
-                    if (max_white_length < cur_white_length) {
-                        max_white_length = cur_white_length;
-                    }
-                }
-                else {
-                    if (max_white_length < cur_white_length) {
-                        max_white_length = cur_white_length;
-                    }
-                    left_value = prg_lower_limit;
-                    cur_white_length = 0;
-                    break;
-                }
-            }
+        for (int i = 0; i != is_white.rows; ++i) {
+            const uchar* row = is_white.ptr<uchar>(i);
+            int cur_white_length = static_cast<int>(std::find(row, row + is_white.cols, 0) - row);
+            max_white_length = std::max(max_white_length, cur_white_length);
         }
 
         // TODO：这里的进度条长度算的并不是特别准，属于能跑就行。有空再优化下
@@ -225,13 +219,19 @@ void asst::InfrastOperImageAnalyzer::skill_analyze()
 
     const auto task_ptr = Task.get<MatchTaskInfo>("InfrastSkills");
     const int bright_thres = task_ptr->special_params.front();
-
-    Matcher skill_analyzer(m_image);
-
-    skill_analyzer.set_mask_range(task_ptr->mask_range.first, task_ptr->mask_range.second);
-    skill_analyzer.set_threshold(task_ptr->templ_thresholds.front());
-
-    for (auto&& oper : m_result) {
+    const double templ_thres = task_ptr->templ_thresholds.front();
+
+    // 先把所有干员的亮着的技能格子都裁出来，再一次性和该设施内所有可能的技能模板比较
+    struct SkillSlot
+    {
+        size_t oper_index = 0;
+        Rect rect;
+    };
+    std::vector<SkillSlot> slots;
+    std::vector<cv::Mat> slot_images;
+
+    for (size_t oper_index = 0; oper_index < m_result.size(); ++oper_index) {
+        const auto& oper = m_result[oper_index];
         Rect roi = task_ptr->rect_move;
         roi.x += oper.smiley.rect.x;
         roi.y += oper.smiley.rect.y;
@@ -247,7 +247,6 @@ void asst::InfrastOperImageAnalyzer::skill_analyze()
         }
 
         cv::Mat all_skills_img = m_image(make_rect<cv::Rect>(roi));
-        std::string log_str = "[ ";
         for (int i = 0; i != MaxNumOfSkills; ++i) {
             int x = i * skill_width + spacing * i;
             Rect skill_rect_in_roi(x, 0, skill_width, roi.height);
@@ -267,19 +266,38 @@ void asst::InfrastOperImageAnalyzer::skill_analyze()
 #ifdef ASST_DEBUG
             cv::rectangle(m_image_draw, make_rect<cv::Rect>(skill_rect), cv::Scalar(0, 255, 0), 2);
 #endif
+            slots.emplace_back(SkillSlot { oper_index, skill_rect });
+            slot_images.emplace_back(skill_image);
+        }
+    }
 
-            // 针对裁剪出来的每个技能进行识别
-            skill_analyzer.set_roi(skill_rect);
+    auto facility_skills = InfrastData.get_skills(m_facility) | views::values;
+    const std::vector<infrast::Skill> skills(facility_skills.begin(), facility_skills.end());
+    std::vector<std::string> templ_names;
+    templ_names.reserve(skills.size());
+    for (const auto& skill : skills) {
+        templ_names.emplace_back(skill.templ_name);
+    }
+    const auto classifier = InfrastSkillClassifier::get(m_facility, std::move(templ_names), task_ptr->mask_range);
+    const auto all_scores = classifier->classify(slot_images);
 
-            std::vector<std::pair<infrast::Skill, MatchRect>> possible_skills;
-            // 逐个该设施内所有可能的技能，取得分最高的
-            for (const auto& skill : InfrastData.get_skills(m_facility) | views::values) {
-                skill_analyzer.set_templ(skill.templ_name);
+    for (size_t oper_index = 0; oper_index < m_result.size(); ++oper_index) {
+        auto& oper = m_result[oper_index];
+        std::string log_str = "[ ";
+        for (size_t slot_index = 0; slot_index < slots.size(); ++slot_index) {
+            if (slots[slot_index].oper_index != oper_index) {
+                continue;
+            }
+            const Rect& skill_rect = slots[slot_index].rect;
+            const auto& scores = all_scores[slot_index];
 
-                if (!skill_analyzer.analyze()) {
+            std::vector<std::pair<infrast::Skill, MatchRect>> possible_skills;
+            // 该设施内所有可能的技能中，得分超过阈值的
+            for (size_t i = 0; i < skills.size(); ++i) {
+                if (scores[i] < templ_thres) {
                     continue;
                 }
-                possible_skills.emplace_back(std::make_pair(skill, skill_analyzer.get_result()));
+                possible_skills.emplace_back(skills[i], MatchRect { .rect = skill_rect, .score = scores[i] });
             }
             if (possible_skills.empty()) {
                 Log.error("skill has no recognition result");
@@ -353,23 +371,15 @@ void asst::InfrastOperImageAnalyzer::selected_analyze()
         selected_rect.y += oper.smiley.rect.y;
 
         cv::Mat roi = m_image(make_rect<cv::Rect>(selected_rect));
-        cv::Mat hsv, bin;
+        cv::Mat hsv, h_channel, bin;
         cv::cvtColor(roi, hsv, cv::COLOR_BGR2HSV);
-        std::vector<cv::Mat> channels;
-        cv::split(hsv, channels);
+        cv::extractChannel(hsv, h_channel, 0);
         int mask_lowb = selected_task_ptr->mask_range.first;
         int mask_uppb = selected_task_ptr->mask_range.second;
 
-        int count = 0;
-        auto& h_channel = channels.at(0);
-        for (int i = 0; i != h_channel.rows; ++i) {
-            for (int j = 0; j != h_channel.cols; ++j) {
-                cv::uint8_t value = h_channel.at<cv::uint8_t>(i, j);
-                if (mask_lowb < value && value < mask_uppb) {
-                    ++count;
-                }
-            }
-        }
+        // 开区间 (mask_lowb, mask_uppb)
+        cv::inRange(h_channel, mask_lowb + 1, mask_uppb - 1, bin);
+        int count = cv::countNonZero(bin);
         Log.trace("selected_analyze |", count);
         oper.selected = count >= selected_task_ptr->templ_thresholds.front();
         oper.rect = selected_rect; // 先凑合用（
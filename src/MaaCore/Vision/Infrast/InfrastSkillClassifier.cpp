@@ -0,0 +1,213 @@
+#include "InfrastSkillClassifier.h"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <unordered_map>
+
+#include "Config/TemplResource.h"
+#include "Utils/Logger.hpp"
+#include "Utils/NoWarningCV.h"
+
+using namespace asst;
+
+namespace
+{
+    constexpr int Channels = 3;
+    // 像素先减去 128 再参与运算，CCOEFF 对整体平移不敏感，但平方和的量级小了很多，float 的精度就够用了
+    constexpr double PixelOffset = -128.0;
+}
+
+std::shared_ptr<const InfrastSkillClassifier> InfrastSkillClassifier::get(const std::string& facility,
+                                                                          std::vector<std::string> templ_names,
+                                                                          const std::pair<int, int>& mask_range)
+{
+    static std::mutex s_mutex;
+    static std::unordered_map<std::string, std::shared_ptr<const InfrastSkillClassifier>> s_classifiers;
+
+    std::unique_lock<std::mutex> lock(s_mutex);
+    auto& classifier = s_classifiers[facility];
+    if (!classifier || !classifier->is_valid_for(templ_names, mask_range)) {
+        Log.info(__FUNCTION__, "build skill classifier", facility, "size:", templ_names.size());
+        classifier = std::shared_ptr<const InfrastSkillClassifier>(
+            new InfrastSkillClassifier(std::move(templ_names), mask_range));
+    }
+    return classifier;
+}
+
+InfrastSkillClassifier::InfrastSkillClassifier(std::vector<std::string> templ_names,
+                                               const std::pair<int, int>& mask_range)
+    : m_templ_names(std::move(templ_names)), m_mask_range(mask_range)
+{
+    auto& templ_res = TemplResource::get_instance();
+
+    std::map<std::tuple<int, int>, std::vector<size_t>> groups;
+    m_templ_data.reserve(m_templ_names.size());
+    for (size_t i = 0; i < m_templ_names.size(); ++i) {
+        const cv::Mat& templ = templ_res.get_templ(m_templ_names[i]);
+        m_templ_data.emplace_back(templ.data);
+        if (templ.empty() || templ.channels() != Channels) {
+            Log.error("templ is empty!", m_templ_names[i]);
+            continue;
+        }
+        groups[{ templ.cols, templ.rows }].emplace_back(i);
+    }
+
+    for (auto& [size, indices] : groups) {
+        const auto [width, height] = size;
+        const int area = width * height;
+        const int rows = static_cast<int>(indices.size());
+
+        Pack pack;
+        pack.size = cv::Size(width, height);
+        pack.templs = cv::Mat::zeros(rows, area * Channels, CV_32F);
+        pack.masks = cv::Mat::zeros(rows, area, CV_32F);
+        pack.templ_norm2 = cv::Mat::zeros(1, rows, CV_32F);
+        pack.mask_sum = cv::Mat::zeros(1, rows, CV_32F);
+
+        for (int row = 0; row < rows; ++row) {
+            const std::string& templ_name = m_templ_names[indices[row]];
+            const cv::Mat& templ = templ_res.get_templ(templ_name);
+            cv::Mat mask = templ_res.get_templ_mask(templ_name, mask_range, false);
+            cv::Mat unmasked = mask == 0;
+
+            cv::Mat mask_f;
+            mask.convertTo(mask_f, CV_32F, 1.0 / 255);
+            mask_f.reshape(1, 1).copyTo(pack.masks.row(row));
+            // 掩码全空时模板也全为 0，得分会是 0，这里只是避免除以 0
+            pack.mask_sum.at<float>(row) = static_cast<float>(std::max(cv::countNonZero(mask), 1));
+
+            std::vector<cv::Mat> planes;
+            cv::split(templ, planes);
+            for (int c = 0; c < Channels; ++c) {
+                cv::Mat plane;
+                planes[c].convertTo(plane, CV_32F);
+                // 与 cv::matchTemplate 带掩码的 TM_CCOEFF 一样：掩码内减去掩码内的均值，掩码外置 0
+                plane -= cv::mean(plane, mask)[0];
+                plane.setTo(0, unmasked);
+                plane.reshape(1, 1).copyTo(pack.templs.row(row).colRange(c * area, (c + 1) * area));
+            }
+            pack.templ_norm2.at<float>(row) = static_cast<float>(pack.templs.row(row).dot(pack.templs.row(row)));
+        }
+        pack.skill_indices = std::move(indices);
+        m_packs.emplace_back(std::move(pack));
+    }
+}
+
+bool InfrastSkillClassifier::is_valid_for(const std::vector<std::string>& templ_names,
+                                          const std::pair<int, int>& mask_range) const
+{
+    if (mask_range != m_mask_range || templ_names != m_templ_names) {
+        return false;
+    }
+    for (size_t i = 0; i < m_templ_names.size(); ++i) {
+        if (TemplResource::get_instance().get_templ(m_templ_names[i]).data != m_templ_data[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::vector<std::vector<double>> InfrastSkillClassifier::classify(const std::vector<cv::Mat>& slots) const
+{
+    std::vector<std::vector<double>> scores(slots.size(), std::vector<double>(m_templ_names.size(), -1.0));
+    if (slots.empty()) {
+        return scores;
+    }
+
+    std::vector<std::vector<cv::Mat>> slot_planes;
+    slot_planes.reserve(slots.size());
+    for (const cv::Mat& slot : slots) {
+        cv::Mat slot_f;
+        slot.convertTo(slot_f, CV_32F, 1.0, PixelOffset);
+        std::vector<cv::Mat> planes;
+        cv::split(slot_f, planes);
+        slot_planes.emplace_back(std::move(planes));
+    }
+
+    for (const Pack& pack : m_packs) {
+        score_pack(pack, slot_planes, scores);
+    }
+    return scores;
+}
+
+void InfrastSkillClassifier::score_pack(const Pack& pack, const std::vector<std::vector<cv::Mat>>& slot_planes,
+                                        std::vector<std::vector<double>>& scores) const
+{
+    const int area = pack.size.area();
+
+    // 把每个格子里模板所有可能的位置展开成一行，第 i 个格子占 [offsets[i], offsets[i + 1]) 这些行
+    std::vector<int> offsets = { 0 };
+    for (const auto& planes : slot_planes) {
+        const cv::Size slot_size = planes.front().size();
+        int positions = 0;
+        if (slot_size.width >= pack.size.width && slot_size.height >= pack.size.height) {
+            positions = (slot_size.width - pack.size.width + 1) * (slot_size.height - pack.size.height + 1);
+        }
+        offsets.emplace_back(offsets.back() + positions);
+    }
+    if (offsets.back() == 0) {
+        return;
+    }
+
+    cv::Mat windows(offsets.back(), area * Channels, CV_32F);
+    for (size_t i = 0; i < slot_planes.size(); ++i) {
+        const auto& planes = slot_planes[i];
+        const cv::Size slot_size = planes.front().size();
+        int row = offsets[i];
+        for (int y = 0; y + pack.size.height <= slot_size.height; ++y) {
+            for (int x = 0; x + pack.size.width <= slot_size.width; ++x, ++row) {
+                cv::Rect window_rect(x, y, pack.size.width, pack.size.height);
+                for (int c = 0; c < Channels; ++c) {
+                    cv::Mat dst = windows.row(row).colRange(c * area, (c + 1) * area).reshape(1, pack.size.height);
+                    planes[c](window_rect).copyTo(dst);
+                }
+            }
+        }
+    }
+
+    // 分子：Σ T'·I，T' 在掩码内是零均值的，所以不用再减图像的均值
+    cv::Mat numerator;
+    cv::gemm(windows, pack.templs, 1.0, cv::noArray(), 0.0, numerator, cv::GEMM_2_T);
+
+    // 图像在掩码内的方差：Σ M·I² - Σ_c (Σ M·I_c)² / Σ M，三个通道的平方先加起来再和掩码相乘
+    cv::Mat windows_sq = windows.mul(windows);
+    cv::Mat sq_sum = windows_sq.colRange(0, area) + windows_sq.colRange(area, 2 * area) +
+                     windows_sq.colRange(2 * area, 3 * area);
+    cv::Mat variance;
+    cv::gemm(sq_sum, pack.masks, 1.0, cv::noArray(), 0.0, variance, cv::GEMM_2_T);
+    cv::Mat mask_sum_rows;
+    cv::repeat(pack.mask_sum, windows.rows, 1, mask_sum_rows);
+    for (int c = 0; c < Channels; ++c) {
+        cv::Mat channel_sum;
+        cv::gemm(windows.colRange(c * area, (c + 1) * area), pack.masks, 1.0, cv::noArray(), 0.0, channel_sum,
+                 cv::GEMM_2_T);
+        cv::Mat channel_sum_sq = channel_sum.mul(channel_sum);
+        cv::divide(channel_sum_sq, mask_sum_rows, channel_sum_sq);
+        variance -= channel_sum_sq;
+    }
+
+    cv::Mat denominator;
+    cv::repeat(pack.templ_norm2, windows.rows, 1, denominator);
+    denominator = denominator.mul(variance);
+    cv::sqrt(cv::max(denominator, 0), denominator);
+
+    cv::Mat result;
+    cv::divide(numerator, denominator, result);
+    // 平坦的图像块分母为 0，Matcher 里这种 NaN、inf 的得分会被当成 0
+    result.setTo(0, denominator == 0);
+    // 分母接近 0 时浮点误差会把得分放大到 [-1, 1] 之外
+    result = cv::min(cv::max(result, -1.0), 1.0);
+
+    for (size_t i = 0; i < slot_planes.size(); ++i) {
+        if (offsets[i] == offsets[i + 1]) {
+            continue;
+        }
+        cv::Mat slot_max;
+        cv::reduce(result.rowRange(offsets[i], offsets[i + 1]), slot_max, 0, cv::REDUCE_MAX);
+        for (int j = 0; j < slot_max.cols; ++j) {
+            scores[i][pack.skill_indices[j]] = slot_max.at<float>(j);
+        }
+    }
+}
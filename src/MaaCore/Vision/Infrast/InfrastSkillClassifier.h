@@ -0,0 +1,54 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Common/AsstTypes.h"
+#include "Utils/NoWarningCVMat.h"
+
+namespace asst
+{
+    // 基建技能图标的批量分类器。
+    // 把一个设施的所有技能模板预先打包成矩阵（按尺寸分组），所有技能格子的所有匹配位置也展开成矩阵，
+    // 用几次矩阵乘法一次算出 格子 × 模板 的带掩码 TM_CCOEFF_NORMED 得分，取代逐个格子、逐个模板的 Matcher。
+    // 得分与 Matcher 的结果一致（只有浮点误差）
+    class InfrastSkillClassifier
+    {
+    public:
+        // 获取一个设施的分类器，按设施缓存，模板列表、掩码范围变了或模板被重新加载过时会重新构建
+        static std::shared_ptr<const InfrastSkillClassifier> get(const std::string& facility,
+                                                                 std::vector<std::string> templ_names,
+                                                                 const std::pair<int, int>& mask_range);
+
+        // scores[i][j]：第 i 个格子与 templ_names[j] 在格子内所有位置上的最高得分。
+        // 模板不存在或比格子大时为 -1
+        std::vector<std::vector<double>> classify(const std::vector<cv::Mat>& slots) const;
+
+    private:
+        InfrastSkillClassifier(std::vector<std::string> templ_names, const std::pair<int, int>& mask_range);
+
+        bool is_valid_for(const std::vector<std::string>& templ_names, const std::pair<int, int>& mask_range) const;
+
+        // 同一尺寸的模板打包在一起，每行一个模板，三个通道分开依次排列
+        struct Pack
+        {
+            cv::Size size;
+            std::vector<size_t> skill_indices;
+            cv::Mat templs;      // 掩码内减去均值、掩码外为 0 的模板，n × 3L
+            cv::Mat masks;       // 0/1 掩码，n × L
+            cv::Mat templ_norm2; // 1 × n
+            cv::Mat mask_sum;    // 1 × n
+        };
+
+        // slot_planes 是每个格子减去偏移后拆开的三个 float 通道
+        void score_pack(const Pack& pack, const std::vector<std::vector<cv::Mat>>& slot_planes,
+                        std::vector<std::vector<double>>& scores) const;
+
+        std::vector<std::string> m_templ_names;
+        std::pair<int, int> m_mask_range;
+        std::vector<const uchar*> m_templ_data; // 用来判断 TemplResource 里的模板是否被重新加载过
+        std::vector<Pack> m_packs;
+    };
+} // namespace asst
@@ -1,29 +1,194 @@
 #include "Matcher.h"
 
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+
 #include "Utils/NoWarningCV.h"
 
 #include "Config/TaskData.h"
 #include "Config/TemplResource.h"
 #include "Utils/Logger.hpp"
+#include "Utils/Ranges.hpp"
 #include "Utils/StringMisc.hpp"
+#include "Vision/FrameCache.h"
 
 using namespace asst;
 
+namespace
+{
+    // 搜索位置太少时粗匹配省不了多少
+    constexpr int MinCoarsePositions = 64 * 64;
+    // 需要逐个精算的位置超过这么多时，不如直接完整匹配
+    constexpr size_t MaxCoarseCandidates = 1024;
+    constexpr size_t MaxRefinePositions = 64;
+    // 粗匹配是 float 运算，上界留一点余量
+    constexpr double BoundEps = 1e-3;
+
+    struct CoarseMatch
+    {
+        double score = 0;
+        cv::Point loc;
+    };
+
+    // 金字塔粗到细匹配，结果与完整的 TM_CCOEFF_NORMED 一致（只有浮点误差）。
+    // 模板 T 和图像窗口 I 都按 2×2 块拆成 块平均 + 块内残差 两个正交分量，设 r 为半尺寸上的得分，则
+    //   score ≤ sqrt(max(r, 0)² · |T_low|² + |T_high|²) / |T|
+    // 位置的奇偶决定了 2×2 块怎么对齐，所以图像按四种偏移各缩小一次。
+    // 按上界从高到低精算，直到上界低于已经算出的最高分；上界达不到阈值的位置不会被精算。
+    // 返回 std::nullopt 表示不适用，需要完整匹配；返回的得分低于阈值时说明没有位置能达到阈值，此时得分不是真实的最大值
+    std::optional<CoarseMatch> coarse_to_fine_match(const cv::Mat& image, const std::string& templ_name,
+                                                    const cv::Mat& templ, double threshold)
+    {
+        const int positions = (image.cols - templ.cols + 1) * (image.rows - templ.rows + 1);
+        if (positions < MinCoarsePositions || threshold <= BoundEps) {
+            return std::nullopt;
+        }
+        const auto coarse = TemplResource::get_instance().get_templ_coarse(templ_name);
+        if (coarse.templ.empty() || coarse.templ.channels() != image.channels() || coarse.low_energy <= 0) {
+            return std::nullopt;
+        }
+        const double total_energy = coarse.low_energy + coarse.high_energy;
+        const double min_bound = threshold - BoundEps;
+        // 上界 ≥ min_bound 所需的最低半尺寸得分。残差占比太大时上界总是够高，剪不掉任何位置
+        const double min_coarse_sq = (min_bound * min_bound * total_energy - coarse.high_energy) / coarse.low_energy;
+        if (min_coarse_sq <= 0) {
+            return std::nullopt;
+        }
+        const double min_coarse = std::sqrt(min_coarse_sq);
+        auto upper_bound = [&](double r) {
+            r = std::isnan(r) ? 1.0 : std::max(r, 0.0);
+            return std::sqrt((r * r * coarse.low_energy + coarse.high_energy) / total_energy);
+        };
+
+        cv::Mat image_f;
+        image.convertTo(image_f, CV_32F);
+
+        // (上界, 位置)
+        std::vector<std::pair<double, cv::Point>> candidates;
+        for (int py = 0; py < 2; ++py) {
+            for (int px = 0; px < 2; ++px) {
+                const int width = (image.cols - px) / 2;
+                const int height = (image.rows - py) / 2;
+                if (width < coarse.templ.cols || height < coarse.templ.rows) {
+                    continue;
+                }
+                cv::Mat half;
+                cv::resize(image_f(cv::Rect(px, py, width * 2, height * 2)), half, cv::Size(width, height), 0, 0,
+                           cv::INTER_AREA);
+                cv::Mat coarse_matched;
+                cv::matchTemplate(half, coarse.templ, coarse_matched, cv::TM_CCOEFF_NORMED);
+                for (int y = 0; y < coarse_matched.rows; ++y) {
+                    const auto* row = coarse_matched.ptr<float>(y);
+                    for (int x = 0; x < coarse_matched.cols; ++x) {
+                        if (row[x] < min_coarse - BoundEps) {
+                            continue;
+                        }
+                        if (candidates.size() >= MaxCoarseCandidates) {
+                            return std::nullopt;
+                        }
+                        candidates.emplace_back(upper_bound(row[x]) + BoundEps, cv::Point(x * 2 + px, y * 2 + py));
+                    }
+                }
+            }
+        }
+
+        // 上界相同时按行优先，和 cv::minMaxLoc 取第一个最大值的顺序一致
+        auto row_major = [](const cv::Point& lhs, const cv::Point& rhs) {
+            return std::tie(lhs.y, lhs.x) < std::tie(rhs.y, rhs.x);
+        };
+        ranges::sort(candidates, [&](const auto& lhs, const auto& rhs) {
+            return lhs.first != rhs.first ? lhs.first > rhs.first : row_major(lhs.second, rhs.second);
+        });
+
+        CoarseMatch best { .score = -1.0 };
+        size_t refined = 0;
+        for (const auto& [bound, loc] : candidates) {
+            if (bound < best.score) {
+                break;
+            }
+            if (++refined > MaxRefinePositions) {
+                return std::nullopt;
+            }
+            cv::Mat matched;
+            cv::matchTemplate(image(cv::Rect(loc, templ.size())), templ, matched, cv::TM_CCOEFF_NORMED);
+            double score = matched.at<float>(0, 0);
+            if (std::isnan(score) || std::isinf(score)) {
+                score = 0;
+            }
+            if (score > best.score || (score == best.score && row_major(loc, best.loc))) {
+                best = CoarseMatch { .score = score, .loc = loc };
+            }
+        }
+        best.score = std::max(best.score, 0.0);
+        return best;
+    }
+}
+
 Matcher::ResultOpt Matcher::analyze() const
 {
-    const auto match_results = preproc_and_match(make_roi(m_image, m_roi), m_params);
+    auto& frame_cache = FrameCache::get_instance();
+    auto key = cache_key("Matcher", m_roi);
+    if (key) {
+        if (auto cached = frame_cache.find<ResultOpt>(m_image, *key)) {
+            if (*cached) {
+                m_result = **cached;
+            }
+            return *cached;
+        }
+    }
 
-    for (size_t i = 0; i < match_results.size(); ++i) {
-        const auto& [matched, templ, templ_name] = match_results[i];
-        if (matched.empty()) {
-            continue;
+    ResultOpt result = match();
+    if (key) {
+        frame_cache.store(m_image, std::move(*key), result);
+    }
+    return result;
+}
+
+Matcher::ResultOpt Matcher::match() const
+{
+    const cv::Mat image = make_roi(m_image, m_roi);
+    const bool unmasked = m_params.mask_range.first == 0 && m_params.mask_range.second == 0;
+
+    for (size_t i = 0; i < m_params.templs.size(); ++i) {
+        double threshold = m_params.templ_thres[i];
+        double max_val = 0.0;
+        cv::Point max_loc;
+        cv::Size templ_size;
+        std::string templ_name;
+
+        // 有名字的模板才有缓存的半尺寸模板，可以先在半尺寸上排除掉大部分位置
+        std::optional<CoarseMatch> coarse;
+        if (const auto* name = std::get_if<std::string>(&m_params.templs[i]); unmasked && name) {
+            const cv::Mat& templ = TemplResource::get_instance().get_templ(*name);
+            if (!templ.empty() && templ.cols <= image.cols && templ.rows <= image.rows) {
+                coarse = coarse_to_fine_match(image, *name, templ, threshold);
+                templ_size = templ.size();
+                templ_name = *name;
+            }
         }
 
-        double min_val = 0.0, max_val = 0.0;
-        cv::Point min_loc, max_loc;
-        cv::minMaxLoc(matched, &min_val, &max_val, &min_loc, &max_loc);
+        if (coarse) {
+            max_val = coarse->score;
+            max_loc = coarse->loc;
+        }
+        else {
+            auto match_result = preproc_and_match(image, m_params, i);
+            if (!match_result) {
+                return std::nullopt;
+            }
+            const auto& [matched, templ, name] = *match_result;
+            if (matched.empty()) {
+                continue;
+            }
+            double min_val = 0.0;
+            cv::Point min_loc;
+            cv::minMaxLoc(matched, &min_val, &max_val, &min_loc, &max_loc);
+            templ_size = templ.size();
+            templ_name = name;
+        }
 
-        Rect rect(max_loc.x + m_roi.x, max_loc.y + m_roi.y, templ.cols, templ.rows);
+        Rect rect(max_loc.x + m_roi.x, max_loc.y + m_roi.y, templ_size.width, templ_size.height);
         if (std::isnan(max_val) || std::isinf(max_val)) {
             max_val = 0;
         }
@@ -31,7 +196,6 @@ Matcher::ResultOpt Matcher::analyze() const
             Log.trace("match_templ |", templ_name, "score:", max_val, "rect:", rect, "roi:", m_roi);
         }
 
-        double threshold = m_params.templ_thres[i];
         if (max_val < threshold) {
             continue;
         }
@@ -48,52 +212,70 @@ Matcher::ResultOpt Matcher::analyze() const
 std::vector<Matcher::RawResult> Matcher::preproc_and_match(const cv::Mat& image, const MatcherConfig::Params& params)
 {
     std::vector<Matcher::RawResult> results;
-    for (auto& ptempl : params.templs) {
-        cv::Mat templ;
-        std::string templ_name;
-
-        if (std::holds_alternative<std::string>(ptempl)) {
-            templ_name = std::get<std::string>(ptempl);
-            templ = TemplResource::get_instance().get_templ(templ_name);
-        }
-        else if (std::holds_alternative<cv::Mat>(ptempl)) {
-            templ = std::get<cv::Mat>(ptempl);
-        }
-        else {
-            Log.error("templ is none");
+    for (size_t i = 0; i < params.templs.size(); ++i) {
+        auto result = preproc_and_match(image, params, i);
+        if (!result) {
+            return {};
         }
+        results.emplace_back(std::move(*result));
+    }
+    return results;
+}
 
-        if (templ.empty()) {
-            Log.error("templ is empty!", templ_name);
+std::optional<Matcher::RawResult> Matcher::preproc_and_match(const cv::Mat& image, const MatcherConfig::Params& params,
+                                                            size_t index)
+{
+    const auto& ptempl = params.templs[index];
+    cv::Mat templ;
+    std::string templ_name;
+
+    if (std::holds_alternative<std::string>(ptempl)) {
+        templ_name = std::get<std::string>(ptempl);
+        templ = TemplResource::get_instance().get_templ(templ_name);
+    }
+    else if (std::holds_alternative<cv::Mat>(ptempl)) {
+        templ = std::get<cv::Mat>(ptempl);
+    }
+    else {
+        Log.error("templ is none");
+    }
+
+    if (templ.empty()) {
+        Log.error("templ is empty!", templ_name);
 #ifdef ASST_DEBUG
-            throw std::runtime_error("templ is empty: " + templ_name);
+        throw std::runtime_error("templ is empty: " + templ_name);
 #else
-            return {};
+        return std::nullopt;
 #endif
-        }
+    }
 
-        if (templ.cols > image.cols || templ.rows > image.rows) {
-            Log.error("templ size is too large", templ_name, "image size:", image.cols, image.rows,
-                      "templ size:", templ.cols, templ.rows);
-            return {};
-        }
+    if (templ.cols > image.cols || templ.rows > image.rows) {
+        Log.error("templ size is too large", templ_name, "image size:", image.cols, image.rows,
+                  "templ size:", templ.cols, templ.rows);
+        return std::nullopt;
+    }
 
-        cv::Mat matched;
-        if (params.mask_range.first == 0 && params.mask_range.second == 0) {
-            cv::matchTemplate(image, templ, matched, cv::TM_CCOEFF_NORMED);
+    cv::Mat matched;
+    if (params.mask_range.first == 0 && params.mask_range.second == 0) {
+        cv::matchTemplate(image, templ, matched, cv::TM_CCOEFF_NORMED);
+    }
+    else {
+        cv::Mat mask;
+        if (!params.mask_with_src && !templ_name.empty()) {
+            // 模板自身的掩码不会变，直接用缓存的
+            mask = TemplResource::get_instance().get_templ_mask(templ_name, params.mask_range,
+                                                                params.mask_with_close);
         }
         else {
-            cv::Mat mask;
             cv::cvtColor(params.mask_with_src ? image : templ, mask, cv::COLOR_BGR2GRAY);
             cv::inRange(mask, params.mask_range.first, params.mask_range.second, mask);
             if (params.mask_with_close) {
                 cv::Mat kernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(3, 3));
                 cv::morphologyEx(mask, mask, cv::MORPH_CLOSE, kernel);
             }
-            cv::matchTemplate(image, templ, matched, cv::TM_CCOEFF_NORMED, mask);
         }
-
-        results.emplace_back(RawResult { .matched = matched, .templ = templ, .templ_name = templ_name });
+        cv::matchTemplate(image, templ, matched, cv::TM_CCOEFF_NORMED, mask);
     }
-    return results;
+
+    return RawResult { .matched = matched, .templ = templ, .templ_name = templ_name };
 }
@@ -27,11 +27,16 @@ namespace asst
             std::string templ_name;
         };
         static std::vector<RawResult> preproc_and_match(const cv::Mat& image, const MatcherConfig::Params& params);
+        // 只匹配 params.templs[index]，出错时返回 std::nullopt
+        static std::optional<RawResult> preproc_and_match(const cv::Mat& image, const MatcherConfig::Params& params,
+                                                          size_t index);
 
     protected:
         virtual void _set_roi(const Rect& roi) override { set_roi(roi); }
 
     private:
+        ResultOpt match() const;
+
         // FIXME: 老接口太难重构了，先弄个这玩意兼容下，后续慢慢全删掉
         mutable Result m_result;
     };
@@ -6,8 +6,8 @@
 #include "Config/TaskData.h"
 #include "Config/TemplResource.h"
 #include "Utils/Logger.hpp"
-#include "Vision/Matcher.h"
-#include "Vision/RegionOCRer.h"
+#include "Utils/WorkerPool.hpp"
+#include "Vision/BatchRegionOCRer.h"
 
 #include <numbers>
 
@@ -123,19 +123,61 @@ bool asst::DepotImageAnalyzer::analyze_all_items()
 {
     LogTraceFunction;
 
+    // 先把所有材料都匹配出来，数量最后一起批量 OCR
+    auto quantity_task_ptr = Task.get<MatchTaskInfo>("DepotQuantity");
+    BatchRegionOCRer quantity_analyzer(m_image_resized, Rect(), m_inst);
+    quantity_analyzer.set_task_info("NumberOcrReplace");
+    quantity_analyzer.set_bin_threshold(quantity_task_ptr->mask_range.first, quantity_task_ptr->mask_range.second);
+
+    std::vector<Rect> item_rois;
     for (const Rect& roi : m_all_items_roi) {
         if (check_roi_empty(roi)) { // roi 是竖着有序的
             break;
         }
+        item_rois.emplace_back(roi);
+    }
+
+    // 后一个格子从前一个格子匹配到的材料往后找，有先后依赖。
+    // 所以先并行地让每个格子都从本页的起点推测性地扫一遍，再按顺序重放，大部分得分都已经算好了
+    auto match_task_ptr = Task.get<MatchTaskInfo>("DepotMatchData");
+    auto index = DepotItemIndex::get(ItemData.get_ordered_material_item_id(), match_task_ptr->mask_range);
+    const double threshold = match_task_ptr->templ_thresholds.empty() ? 0.0 : match_task_ptr->templ_thresholds.front();
+
+    std::vector<DepotItemIndex::CellMatcher> cell_matchers;
+    cell_matchers.reserve(item_rois.size());
+    for (const Rect& roi : item_rois) {
+        cell_matchers.emplace_back(index, m_image_resized, roi, enlarged_roi(roi), threshold);
+    }
+
+    auto& pool = WorkerPool::get_instance();
+    std::vector<std::future<void>> futures;
+    futures.reserve(cell_matchers.size());
+    const size_t page_begin = m_match_begin_pos;
+    for (auto& cell_matcher : cell_matchers) {
+        futures.emplace_back(pool.submit([&cell_matcher, page_begin]() { cell_matcher.prefetch(page_begin); }));
+    }
+    for (auto& future : futures) {
+        pool.wait(future);
+    }
+
+    std::vector<std::pair<Rect, ItemInfo>> matched_items;
+    for (size_t i = 0; i < item_rois.size(); ++i) {
         ItemInfo info;
-        size_t cur_pos = match_item(roi, info, m_match_begin_pos);
+        size_t cur_pos = match_item(cell_matchers[i], info, m_match_begin_pos);
         if (cur_pos == NPos) {
             break;
         }
+        m_match_begin_pos = cur_pos + 1;
+        quantity_analyzer.add_region(quantity_roi(info));
+        matched_items.emplace_back(item_rois[i], std::move(info));
+    }
+
+    const auto& quantity_results = quantity_analyzer.analyze();
+    for (size_t i = 0; i < matched_items.size(); ++i) {
+        auto& [roi, info] = matched_items.at(i);
         std::string item_id = info.item_id;
 
-        m_match_begin_pos = cur_pos + 1;
-        info.quantity = match_quantity(info);
+        info.quantity = quantity_results.at(i) ? parse_quantity(*quantity_results.at(i)) : 0;
         info.item_name = ItemData.get_item_name(item_id);
 #ifdef ASST_DEBUG
         cv::putText(m_image_draw_resized, item_id, cv::Point(roi.x, roi.y - 10), cv::FONT_HERSHEY_SIMPLEX, 0.5,
@@ -165,59 +207,32 @@ bool asst::DepotImageAnalyzer::check_roi_empty(const Rect& roi)
     return false;
 }
 
-size_t asst::DepotImageAnalyzer::match_item(const Rect& roi, /* out */ ItemInfo& item_info, size_t begin_index,
-                                            bool with_enlarge)
+asst::Rect asst::DepotImageAnalyzer::enlarged_roi(const Rect& roi)
 {
-    LogTraceFunction;
-
-    const auto& all_items = ItemData.get_ordered_material_item_id();
-
-    Matcher analyzer(m_image_resized);
-    analyzer.set_task_info("DepotMatchData");
     // spacing 有时候算的差一个像素，干脆把 roi 扩大一点好了
-    Rect enlarged_roi = roi;
-    if (with_enlarge) {
-        enlarged_roi = Rect(roi.x - 20, roi.y - 5, roi.width + 40, roi.height + 10);
-    }
-    analyzer.set_roi(enlarged_roi);
+    return correct_rect(Rect(roi.x - 20, roi.y - 5, roi.width + 40, roi.height + 10), m_image_resized);
+}
+
+size_t asst::DepotImageAnalyzer::match_item(DepotItemIndex::CellMatcher& cell_matcher, /* out */ ItemInfo& item_info,
+                                            size_t begin_index)
+{
+    LogTraceFunction;
 
     MatchRect matched;
-    std::string matched_item_id;
-    size_t matched_index = NPos;
-    for (size_t index = begin_index, extra_count = 0; index < all_items.size(); ++index) {
-        const std::string& item_id = all_items.at(index);
-        // analyzer.set_templ(item_id);
-        // TODO: too slow? find a way to set mask directly
-        cv::Mat templ = TemplResource::get_instance().get_templ(item_id).clone();
-        templ(cv::Rect { templ.cols - 80, templ.rows - 50, 80, 50 }) = cv::Scalar { 0, 0, 0 };
-        analyzer.set_templ(templ);
-        if (!analyzer.analyze()) {
-            continue;
-        }
-        if (double score = analyzer.get_result().score; score >= matched.score) {
-            matched = analyzer.get_result();
-            matched_item_id = item_id;
-            matched_index = index;
-        }
-        // 匹配到了任一结果后，再往后匹配几个。
-        // 因为有些相邻的材料长得很像（同一种类的）
-        constexpr size_t MaxExtraMatch = 8;
-        if (matched_index != NPos && ++extra_count >= MaxExtraMatch) {
-            break;
-        }
-    }
+    size_t matched_index = cell_matcher.match(begin_index, matched);
+    std::string matched_item_id =
+        matched_index == NPos ? std::string() : ItemData.get_ordered_material_item_id().at(matched_index);
     Log.info("Item id:", matched_item_id);
     if (matched_item_id.empty()) {
         return NPos;
     }
-    item_info.item_id = matched_item_id;
+    item_info.item_id = std::move(matched_item_id);
     item_info.rect = matched.rect;
     return matched_index;
 }
 
-int asst::DepotImageAnalyzer::match_quantity(const ItemInfo& item)
+asst::Rect asst::DepotImageAnalyzer::quantity_roi(const ItemInfo& item)
 {
-    auto task_ptr = Task.get<MatchTaskInfo>("DepotQuantity");
     auto item_templ = TemplResource::get_instance().get_templ(item.item_id);
     auto item_image = m_image_resized(make_rect<cv::Rect>(item.rect));
     cv::Mat quotient;
@@ -247,23 +262,11 @@ int asst::DepotImageAnalyzer::match_quantity(const ItemInfo& item)
     if (mask_rect.br().x - mid_x < 30) mask_rect.width = mid_x + 30 - mask_rect.x;
 
     // minus 2 to trim white pixels
-    Rect ocr_roi { item.rect.x + mask_rect.x, item.rect.y + mask_rect.y, mask_rect.width - 2, mask_rect.height - 2 };
-
-    cv::Mat ocr_img = m_image_resized.clone();
-    cv::subtract(m_image_resized(make_rect<cv::Rect>(item.rect)), item_templ * 0.41,
-                 ocr_img(make_rect<cv::Rect>(item.rect)));
-
-    RegionOCRer analyzer(m_image_resized);
-    analyzer.set_task_info("NumberOcrReplace");
-    analyzer.set_roi(ocr_roi);
-    analyzer.set_bin_threshold(task_ptr->mask_range.first, task_ptr->mask_range.second);
-
-    if (!analyzer.analyze()) {
-        return 0;
-    }
-
-    const auto& result = analyzer.get_result();
+    return Rect { item.rect.x + mask_rect.x, item.rect.y + mask_rect.y, mask_rect.width - 2, mask_rect.height - 2 };
+}
 
+int asst::DepotImageAnalyzer::parse_quantity(const TextRect& result)
+{
 #ifdef ASST_DEBUG
     cv::rectangle(m_image_draw_resized, make_rect<cv::Rect>(result.rect), cv::Scalar(0, 0, 255));
     cv::putText(m_image_draw_resized, result.text, cv::Point(result.rect.x, result.rect.y - 5),
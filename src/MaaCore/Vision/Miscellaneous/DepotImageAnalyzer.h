@@ -1,6 +1,8 @@
 #pragma once
 #include "Vision/VisionHelper.h"
 
+#include "DepotItemIndex.h"
+
 namespace asst
 {
     struct ItemInfo
@@ -31,9 +33,12 @@ namespace asst
         bool analyze_all_items();
 
         bool check_roi_empty(const Rect& roi);
-        size_t match_item(const Rect& roi, /* out */ ItemInfo& item_info, size_t begin_index = 0ULL,
-                          bool with_enlarge = true);
-        int match_quantity(const ItemInfo& item);
+        Rect enlarged_roi(const Rect& roi);
+        size_t match_item(DepotItemIndex::CellMatcher& cell_matcher, /* out */ ItemInfo& item_info,
+                          size_t begin_index = 0ULL);
+        // 数量所在的区域，之后统一批量 OCR
+        Rect quantity_roi(const ItemInfo& item);
+        int parse_quantity(const TextRect& result);
         Rect resize_rect_to_raw_size(const Rect& rect);
 
         template <typename F>
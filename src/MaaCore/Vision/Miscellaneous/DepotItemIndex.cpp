@@ -0,0 +1,199 @@
+#include "DepotItemIndex.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <mutex>
+#include <tuple>
+
+#include "Utils/NoWarningCV.h"
+
+#include "Config/TemplResource.h"
+#include "Utils/Logger.hpp"
+
+using namespace asst;
+
+std::shared_ptr<const DepotItemIndex> DepotItemIndex::get(const std::vector<std::string>& ordered_item_ids,
+                                                          std::pair<int, int> mask_range)
+{
+    static std::mutex s_mutex;
+    static std::shared_ptr<const DepotItemIndex> s_index;
+
+    std::unique_lock<std::mutex> lock(s_mutex);
+    if (!s_index || !s_index->is_valid_for(ordered_item_ids, mask_range)) {
+        Log.info(__FUNCTION__, "build depot item index, size:", ordered_item_ids.size());
+        s_index = std::shared_ptr<const DepotItemIndex>(new DepotItemIndex(ordered_item_ids, mask_range));
+    }
+    return s_index;
+}
+
+DepotItemIndex::DepotItemIndex(const std::vector<std::string>& ordered_item_ids, std::pair<int, int> mask_range)
+    : m_mask_range(std::move(mask_range)), m_item_ids(ordered_item_ids)
+{
+    constexpr int HistSize = HistBins * HistBins * HistBins;
+
+    m_templ_data.reserve(m_item_ids.size());
+    m_templs.reserve(m_item_ids.size());
+    m_hists = cv::Mat(static_cast<int>(m_item_ids.size()), HistSize, CV_32FC1, cv::Scalar(0));
+
+    for (size_t i = 0; i < m_item_ids.size(); ++i) {
+        const cv::Mat& raw = TemplResource::get_instance().get_templ(m_item_ids[i]);
+        m_templ_data.emplace_back(raw.data);
+        if (raw.empty() || raw.cols < QuantityWidth || raw.rows < QuantityHeight) {
+            Log.error(__FUNCTION__, "invalid templ", m_item_ids[i]);
+            m_templs.emplace_back();
+            continue;
+        }
+
+        Templ item;
+        item.templ = raw.clone();
+        item.templ(cv::Rect { raw.cols - QuantityWidth, raw.rows - QuantityHeight, QuantityWidth, QuantityHeight }) =
+            cv::Scalar { 0, 0, 0 };
+        // 与 Matcher 用模板自身生成掩码的方式一致
+        cv::cvtColor(item.templ, item.mask, cv::COLOR_BGR2GRAY);
+        cv::inRange(item.mask, m_mask_range.first, m_mask_range.second, item.mask);
+
+        histogram(item.templ, item.mask).copyTo(m_hists.row(static_cast<int>(i)));
+        const int side = std::min(raw.cols, raw.rows);
+        m_hist_side = m_hist_side == 0 ? side : std::min(m_hist_side, side);
+        m_templs.emplace_back(std::move(item));
+    }
+}
+
+bool DepotItemIndex::is_valid_for(const std::vector<std::string>& ordered_item_ids,
+                                  std::pair<int, int> mask_range) const
+{
+    if (mask_range != m_mask_range || ordered_item_ids != m_item_ids) {
+        return false;
+    }
+    for (size_t i = 0; i < m_item_ids.size(); ++i) {
+        if (TemplResource::get_instance().get_templ(m_item_ids[i]).data != m_templ_data[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+cv::Mat DepotItemIndex::histogram(const cv::Mat& image, const cv::Mat& mask)
+{
+    constexpr int Shift = 8 - std::bit_width(static_cast<unsigned>(HistBins - 1));
+
+    cv::Mat hist(1, HistBins * HistBins * HistBins, CV_32FC1, cv::Scalar(0));
+    auto* bins = hist.ptr<float>(0);
+    int count = 0;
+    for (int y = 0; y < image.rows; ++y) {
+        const auto* pixels = image.ptr<cv::Vec3b>(y);
+        const auto* masks = mask.ptr<uchar>(y);
+        for (int x = 0; x < image.cols; ++x) {
+            if (!masks[x]) {
+                continue;
+            }
+            const auto& p = pixels[x];
+            bins[((p[0] >> Shift) * HistBins + (p[1] >> Shift)) * HistBins + (p[2] >> Shift)] += 1.f;
+            ++count;
+        }
+    }
+    if (count != 0) {
+        hist /= count;
+    }
+    return hist;
+}
+
+double DepotItemIndex::similarity(size_t index, const cv::Mat& hist) const
+{
+    // 直方图交集，两个都是 L1 归一化的，结果在 [0, 1]
+    const auto* lhs = m_hists.ptr<float>(static_cast<int>(index));
+    const auto* rhs = hist.ptr<float>(0);
+    double sum = 0.0;
+    for (int i = 0; i < m_hists.cols; ++i) {
+        sum += std::min(lhs[i], rhs[i]);
+    }
+    return sum;
+}
+
+DepotItemIndex::CellMatcher::CellMatcher(std::shared_ptr<const DepotItemIndex> index, const cv::Mat& image,
+                                         const Rect& cell_roi, const Rect& search_roi, double threshold)
+    : m_index(std::move(index)), m_image(image(make_rect<cv::Rect>(search_roi))), m_roi(search_roi),
+      m_threshold(threshold), m_entries(m_index->size())
+{
+    // 格子中间取一个和最小模板一样大的正方形，右下角的数量区域同样不算
+    const int side = std::min({ m_index->m_hist_side, cell_roi.width, cell_roi.height });
+    if (side < QuantityWidth || side < QuantityHeight) {
+        return;
+    }
+    cv::Rect hist_rect(cell_roi.x + (cell_roi.width - side) / 2, cell_roi.y + (cell_roi.height - side) / 2, side,
+                       side);
+    hist_rect &= cv::Rect(0, 0, image.cols, image.rows);
+    if (hist_rect.width != side || hist_rect.height != side) {
+        return;
+    }
+    cv::Mat mask(side, side, CV_8UC1, cv::Scalar(255));
+    mask(cv::Rect { side - QuantityWidth, side - QuantityHeight, QuantityWidth, QuantityHeight }) = cv::Scalar(0);
+    m_hist = histogram(image(hist_rect), mask);
+}
+
+void DepotItemIndex::CellMatcher::prefetch(size_t begin_index)
+{
+    MatchRect ignored;
+    std::ignore = scan(begin_index, true, ignored);
+}
+
+size_t DepotItemIndex::CellMatcher::match(size_t begin_index, /* out */ MatchRect& matched)
+{
+    // 不带筛选地重放，prefetch 算过的直接复用，被筛掉的只在扫到时才补算
+    return scan(begin_index, false, matched);
+}
+
+size_t DepotItemIndex::CellMatcher::scan(size_t begin_index, bool with_prefilter, MatchRect& matched)
+{
+    matched = MatchRect {};
+    size_t matched_index = NPos;
+    for (size_t index = begin_index, extra_count = 0; index < m_entries.size(); ++index) {
+        const Entry& entry = evaluate(index, with_prefilter);
+        if (entry.state != State::Matched) {
+            continue;
+        }
+        if (entry.result.score >= matched.score) {
+            matched = entry.result;
+            matched_index = index;
+        }
+        if (++extra_count >= MaxExtraMatch) {
+            break;
+        }
+    }
+    return matched_index;
+}
+
+const DepotItemIndex::CellMatcher::Entry& DepotItemIndex::CellMatcher::evaluate(size_t index, bool with_prefilter)
+{
+    Entry& entry = m_entries[index];
+    if (entry.state == State::Unknown && with_prefilter && !m_hist.empty() &&
+        m_index->similarity(index, m_hist) < MinHistSimilarity) {
+        entry.state = State::Pruned;
+    }
+    if (entry.state == State::Matched || entry.state == State::Below ||
+        (entry.state == State::Pruned && with_prefilter)) {
+        return entry;
+    }
+
+    entry.state = State::Below;
+    const auto& [templ, mask] = m_index->m_templs[index];
+    if (templ.empty() || templ.cols > m_image.cols || templ.rows > m_image.rows) {
+        return entry;
+    }
+
+    cv::Mat matched;
+    cv::matchTemplate(m_image, templ, matched, cv::TM_CCOEFF_NORMED, mask);
+    double max_val = 0.0;
+    cv::Point max_loc;
+    cv::minMaxLoc(matched, nullptr, &max_val, nullptr, &max_loc);
+    if (std::isnan(max_val) || std::isinf(max_val)) {
+        max_val = 0;
+    }
+    if (max_val >= m_threshold) {
+        entry.state = State::Matched;
+        entry.result.score = max_val;
+        entry.result.rect = Rect(max_loc.x + m_roi.x, max_loc.y + m_roi.y, templ.cols, templ.rows);
+    }
+    return entry;
+}
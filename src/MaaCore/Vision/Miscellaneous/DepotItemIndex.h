@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Common/AsstTypes.h"
+#include "Utils/NoWarningCVMat.h"
+
+namespace asst
+{
+    // 仓库材料的识别索引
+    // 建索引时把所有材料模板的数量区域涂黑、算好掩码和颜色直方图，识别时不用再逐个 clone 模板；
+    // 直方图放在一个连续的矩阵里（每行一个材料），推测性地扫描时先用它筛掉颜色明显不像的，省掉大部分 matchTemplate
+    class DepotItemIndex
+    {
+    public:
+        static constexpr size_t NPos = ~0ULL;
+
+        // 获取当前材料列表对应的索引，材料列表或模板变了会重新构建
+        static std::shared_ptr<const DepotItemIndex> get(const std::vector<std::string>& ordered_item_ids,
+                                                         std::pair<int, int> mask_range);
+
+        size_t size() const noexcept { return m_item_ids.size(); }
+        const std::string& item_id(size_t index) const { return m_item_ids.at(index); }
+
+        // 单个格子的匹配器，缓存算过的得分。
+        // 先并行地对每个格子推测性地扫一遍，再按顺序重放原来的扫描逻辑时，大部分得分都能直接复用
+        class CellMatcher
+        {
+        public:
+            // cell_roi 是格子本身，用来算直方图；search_roi 是扩大过的匹配范围，需已在图像内
+            CellMatcher(std::shared_ptr<const DepotItemIndex> index, const cv::Mat& image, const Rect& cell_roi,
+                        const Rect& search_roi, double threshold);
+
+            // 推测性地扫一遍，跳过被直方图筛掉的材料，只是为了提前把可能用到的得分算好，可以并行调用
+            void prefetch(size_t begin_index);
+
+            // 与原来的线性扫描一致：从 begin_index 开始，取得分最高的（同分取靠后的），
+            // 第一次匹配上之后累计 MaxExtraMatch 个过阈值的就停下。
+            // 窗口内被直方图筛掉的材料也会补算，结果与不做筛选完全相同
+            size_t match(size_t begin_index, /* out */ MatchRect& matched);
+
+        private:
+            enum class State : uint8_t
+            {
+                Unknown,
+                Pruned,
+                Below,
+                Matched,
+            };
+            struct Entry
+            {
+                State state = State::Unknown;
+                MatchRect result;
+            };
+
+            size_t scan(size_t begin_index, bool with_prefilter, MatchRect& matched);
+            const Entry& evaluate(size_t index, bool with_prefilter);
+
+            std::shared_ptr<const DepotItemIndex> m_index;
+            cv::Mat m_image; // search_roi 对应的子图
+            Rect m_roi;
+            double m_threshold = 0.0;
+            cv::Mat m_hist;
+            std::vector<Entry> m_entries;
+        };
+
+    private:
+        // 匹配上之后再往后看几个，因为有些相邻的材料长得很像（同一种类的）
+        static constexpr size_t MaxExtraMatch = 8;
+        // 右下角的数量区域，不参与匹配
+        static constexpr int QuantityWidth = 80;
+        static constexpr int QuantityHeight = 50;
+        static constexpr int HistBins = 4; // 每个通道的分桶数
+        // 直方图交集低于这个值的直接跳过。格子和模板没有严格对齐，阈值放得很宽，只筛掉颜色完全不同的
+        static constexpr double MinHistSimilarity = 0.25;
+
+        struct Templ
+        {
+            cv::Mat templ; // 数量区域已涂黑
+            cv::Mat mask;
+        };
+
+        DepotItemIndex(const std::vector<std::string>& ordered_item_ids, std::pair<int, int> mask_range);
+
+        bool is_valid_for(const std::vector<std::string>& ordered_item_ids, std::pair<int, int> mask_range) const;
+        // 去掉右下角数量区域后的颜色直方图，L1 归一化后展平成一行
+        static cv::Mat histogram(const cv::Mat& image, const cv::Mat& mask);
+        double similarity(size_t index, const cv::Mat& hist) const;
+
+        std::pair<int, int> m_mask_range;
+        std::vector<std::string> m_item_ids;
+        std::vector<const uchar*> m_templ_data; // 用来判断 TemplResource 里的模板是否被重新加载过
+        std::vector<Templ> m_templs;
+        cv::Mat m_hists;     // m_item_ids.size() x HistBins^3, CV_32FC1
+        int m_hist_side = 0; // 格子里只取中间这么大的正方形算直方图，尽量不带上背景
+    };
+}
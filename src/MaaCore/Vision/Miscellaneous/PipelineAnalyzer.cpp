@@ -1,11 +1,15 @@
 #include "PipelineAnalyzer.h"
 
+#include <atomic>
+#include <cstdint>
+#include <future>
 #include <regex>
 #include <utility>
 
 #include "Config/TaskData.h"
 #include "Status.h"
 #include "Utils/Logger.hpp"
+#include "Utils/WorkerPool.hpp"
 #include "Vision/Matcher.h"
 #include "Vision/OCRer.h"
 #include "Vision/RegionOCRer.h"
@@ -14,6 +18,18 @@ using namespace asst;
 
 PipelineAnalyzer::ResultOpt PipelineAnalyzer::analyze() const
 {
+    struct Candidate
+    {
+        std::shared_ptr<TaskInfo> task_ptr;
+        std::optional<Memo::Entry> memo_entry;
+        bool skipped = false;
+        std::optional<Rect> cache_roi;
+        std::future<Matcher::ResultOpt> match_future;
+    };
+
+    size_t memo_hit = 0;
+    std::vector<Candidate> candidates;
+    candidates.reserve(m_tasks_name.size());
     for (const std::string& task_name : m_tasks_name) {
         const auto& task_ptr = Task.get(task_name);
         // 可能有配置错误，导致不存在对应的任务
@@ -25,30 +41,148 @@ PipelineAnalyzer::ResultOpt PipelineAnalyzer::analyze() const
             continue;
         }
 
+        Candidate& candidate = candidates.emplace_back(Candidate { .task_ptr = task_ptr });
+        if (task_ptr->algorithm == AlgorithmType::JustReturn) {
+            // 后面的任务不可能再轮到了
+            break;
+        }
+        if (!m_memo || (task_ptr->algorithm != AlgorithmType::MatchTemplate &&
+                        task_ptr->algorithm != AlgorithmType::OcrDetect)) {
+            continue;
+        }
+
+        if (m_fingerprint.empty()) {
+            m_fingerprint = FrameFingerprint(m_image);
+        }
+        Rect roi = memo_roi(task_ptr);
+        candidate.memo_entry = Memo::Entry { .roi = roi, .hash = m_fingerprint.roi_hash(roi) };
+
+        if (auto iter = m_memo->unmatched.find(task_ptr->name); iter != m_memo->unmatched.cend() &&
+                                                            iter->second.roi == candidate.memo_entry->roi &&
+                                                            iter->second.hash == candidate.memo_entry->hash) {
+            Log.trace(task_ptr->name, "roi unchanged since last unmatched, skip");
+            candidate.skipped = true;
+            ++m_memo->hit;
+            ++memo_hit;
+            continue;
+        }
+        ++m_memo->miss;
+    }
+
+    // 已经命中的候选下标，排在它后面的任务就不用再算了
+    std::atomic<size_t> hit_index = SIZE_MAX;
+    const bool parallel =
+        m_parallel && ranges::count_if(candidates, [](const Candidate& c) {
+                          return !c.skipped && c.task_ptr->algorithm == AlgorithmType::MatchTemplate;
+                      }) > 1;
+    if (parallel) {
+        for (size_t i = 0; i < candidates.size(); ++i) {
+            Candidate& candidate = candidates[i];
+            if (candidate.skipped || candidate.task_ptr->algorithm != AlgorithmType::MatchTemplate) {
+                continue;
+            }
+            // status 不是线程安全的，在这里先取好缓存区域
+            candidate.cache_roi = get_cache_rect(candidate.task_ptr);
+            candidate.match_future =
+                WorkerPool::get_instance().submit([this, &candidate, &hit_index, i]() -> Matcher::ResultOpt {
+                    if (hit_index.load() < i) {
+                        return std::nullopt;
+                    }
+                    return match(candidate.task_ptr, candidate.cache_roi);
+                });
+        }
+    }
+
+    ResultOpt result;
+    for (size_t i = 0; i < candidates.size() && !result; ++i) {
+        Candidate& candidate = candidates[i];
+        const auto& task_ptr = candidate.task_ptr;
+        if (candidate.skipped) {
+            continue;
+        }
+
         Log.trace(__FUNCTION__, task_ptr->name);
         switch (task_ptr->algorithm) {
         case AlgorithmType::JustReturn: {
-            return Result { .task_ptr = task_ptr };
+            result = Result { .task_ptr = task_ptr };
         } break;
 
-        case AlgorithmType::MatchTemplate:
-            if (auto match_opt = match(task_ptr)) {
-                return Result { .task_ptr = task_ptr, .result = *match_opt, .rect = match_opt->rect };
+        case AlgorithmType::MatchTemplate: {
+            Matcher::ResultOpt match_opt;
+            if (candidate.match_future.valid()) {
+                match_opt = WorkerPool::get_instance().wait(candidate.match_future);
+                if (match_opt && m_inst && task_ptr->cache) {
+                    status()->set_rect(task_ptr->name, match_opt->rect);
+                }
             }
-            break;
+            else {
+                match_opt = match(task_ptr);
+            }
+            if (match_opt) {
+                result = Result { .task_ptr = task_ptr, .result = *match_opt, .rect = match_opt->rect };
+            }
+        } break;
         case AlgorithmType::OcrDetect:
             if (auto ocr_opt = ocr(task_ptr)) {
-                return Result { .task_ptr = task_ptr, .result = ocr_opt->front(), .rect = ocr_opt->front().rect };
+                result = Result { .task_ptr = task_ptr, .result = ocr_opt->front(), .rect = ocr_opt->front().rect };
             }
             break;
         default:
             break;
         }
+
+        if (result) {
+            hit_index = i;
+        }
+        else if (candidate.memo_entry) {
+            m_memo->unmatched.insert_or_assign(task_ptr->name, *candidate.memo_entry);
+        }
     }
-    return std::nullopt;
+
+    // 后台任务引用着本对象和 candidates，必须全部结束才能返回。已命中时排在后面的任务会直接跳过
+    for (Candidate& candidate : candidates) {
+        if (candidate.match_future.valid()) {
+            WorkerPool::get_instance().wait(candidate.match_future);
+        }
+    }
+
+    if (m_memo && memo_hit) {
+        Log.info("skipped", memo_hit, "of", m_tasks_name.size(), "tasks whose roi is unchanged, memo hit rate",
+                 m_memo->hit, "/", m_memo->hit + m_memo->miss);
+    }
+    return result;
+}
+
+Rect PipelineAnalyzer::memo_roi(const std::shared_ptr<TaskInfo>& task_ptr) const
+{
+    Rect roi = get_cache_rect(task_ptr).value_or(task_ptr->roi);
+    if (roi.empty()) {
+        return m_roi;
+    }
+    if (task_ptr->algorithm == AlgorithmType::OcrDetect) {
+        // RegionOCRer 会把二值化得到的区域向外扩展几个像素
+        const int exp = OCRerConfig::Params {}.bin_expansion;
+        roi = Rect(roi.x - exp, roi.y - exp, roi.width + 2 * exp, roi.height + 2 * exp);
+    }
+    return roi;
 }
 
 Matcher::ResultOpt PipelineAnalyzer::match(const std::shared_ptr<TaskInfo>& task_ptr) const
+{
+    const auto& result_opt = match(task_ptr, get_cache_rect(task_ptr));
+
+    if (!result_opt) {
+        return std::nullopt;
+    }
+    if (m_inst && task_ptr->cache) {
+        status()->set_rect(task_ptr->name, result_opt->rect);
+    }
+
+    return result_opt;
+}
+
+Matcher::ResultOpt PipelineAnalyzer::match(const std::shared_ptr<TaskInfo>& task_ptr,
+                                           const std::optional<Rect>& cache_roi) const
 {
     Matcher match_analyzer(m_image, m_roi);
 
@@ -59,24 +193,19 @@ Matcher::ResultOpt PipelineAnalyzer::match(const std::shared_ptr<TaskInfo>& task
     }
     match_analyzer.set_task_info(match_task_ptr);
 
-    bool use_cache = m_inst && match_task_ptr->cache;
-    if (use_cache) {
-        auto cache_opt = status()->get_rect(match_task_ptr->name);
-        if (cache_opt) {
-            match_analyzer.set_roi(*cache_opt);
-        }
+    if (cache_roi) {
+        match_analyzer.set_roi(*cache_roi);
     }
 
-    const auto& result_opt = match_analyzer.analyze();
+    return match_analyzer.analyze();
+}
 
-    if (!result_opt) {
+std::optional<Rect> PipelineAnalyzer::get_cache_rect(const std::shared_ptr<TaskInfo>& task_ptr) const
+{
+    if (!m_inst || !task_ptr->cache) {
         return std::nullopt;
     }
-    if (use_cache) {
-        status()->set_rect(match_task_ptr->name, result_opt->rect);
-    }
-
-    return result_opt;
+    return status()->get_rect(task_ptr->name);
 }
 
 OCRer::ResultsVecOpt PipelineAnalyzer::ocr(const std::shared_ptr<TaskInfo>& task_ptr) const
@@ -3,10 +3,12 @@
 
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "Common/AsstTypes.h"
 
+#include "Vision/FrameFingerprint.h"
 #include "Vision/Matcher.h"
 #include "Vision/OCRer.h"
 
@@ -23,18 +25,46 @@ namespace asst
         };
         using ResultOpt = std::optional<Result>;
 
+        // 记录各任务上次识别失败时 ROI 内的画面指纹，画面没变就直接跳过，不再重复识别
+        // 由调用方持有，跨多次截图复用；任务参数可能变化时（例如执行了动作、触发了插件）需要 clear
+        struct Memo
+        {
+            struct Entry
+            {
+                Rect roi;
+                uint64_t hash = 0;
+            };
+            std::unordered_map<std::string, Entry> unmatched;
+            size_t hit = 0;
+            size_t miss = 0;
+
+            void clear() noexcept { unmatched.clear(); }
+        };
+
     public:
         using VisionHelper::VisionHelper;
         virtual ~PipelineAnalyzer() override = default;
 
         void set_tasks(std::vector<std::string> tasks_name) { m_tasks_name = std::move(tasks_name); }
+        void set_memo(Memo& memo) { m_memo = &memo; }
+        // 并行模式：同一帧上的模板匹配任务同时提交到线程池，结果仍按声明顺序选取，与串行时一致
+        // OCR 不是线程安全的，仍在调用方线程上按顺序执行
+        void set_parallel(bool enable) noexcept { m_parallel = enable; }
 
         ResultOpt analyze() const;
 
     private:
         Matcher::ResultOpt match(const std::shared_ptr<TaskInfo>& task_ptr) const;
+        // 不读写 status，可以在工作线程中调用
+        Matcher::ResultOpt match(const std::shared_ptr<TaskInfo>& task_ptr, const std::optional<Rect>& cache_roi) const;
+        std::optional<Rect> get_cache_rect(const std::shared_ptr<TaskInfo>& task_ptr) const;
         OCRer::ResultsVecOpt ocr(const std::shared_ptr<TaskInfo>& task_ptr) const;
+        // 实际参与识别的区域，用于查询 memo
+        Rect memo_roi(const std::shared_ptr<TaskInfo>& task_ptr) const;
 
         std::vector<std::string> m_tasks_name;
+        Memo* m_memo = nullptr;
+        bool m_parallel = false;
+        mutable FrameFingerprint m_fingerprint;
     };
 }
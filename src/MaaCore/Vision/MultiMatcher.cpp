@@ -8,11 +8,33 @@
 #include "Config/TaskData.h"
 #include "Config/TemplResource.h"
 #include "Utils/Logger.hpp"
+#include "Vision/FrameCache.h"
 #include "Vision/Matcher.h"
 
 using namespace asst;
 
 MultiMatcher::ResultsVecOpt MultiMatcher::analyze() const
+{
+    auto& frame_cache = FrameCache::get_instance();
+    auto key = cache_key("MultiMatcher", m_roi);
+    if (key) {
+        if (auto cached = frame_cache.find<ResultsVec>(m_image, *key)) {
+            if (cached->empty()) {
+                return std::nullopt;
+            }
+            m_result = std::move(*cached);
+            return m_result;
+        }
+    }
+
+    ResultsVecOpt result = match();
+    if (key) {
+        frame_cache.store(m_image, std::move(*key), result.value_or(ResultsVec {}));
+    }
+    return result;
+}
+
+MultiMatcher::ResultsVecOpt MultiMatcher::match() const
 {
     auto match_results = Matcher::preproc_and_match(make_roi(m_image, m_roi), m_params);
     if (match_results.empty()) {
@@ -1,12 +1,14 @@
 #include "OCRer.h"
 
-#include <regex>
+#include <chrono>
 #include <unordered_map>
 
 #include "Config/Miscellaneous/OcrConfig.h"
 #include "Config/Miscellaneous/OcrPack.h"
 #include "Config/TaskData.h"
 #include "Utils/Logger.hpp"
+#include "Utils/RegexCache.hpp"
+#include "Vision/FrameCache.h"
 
 using namespace asst;
 
@@ -19,10 +21,29 @@ OCRer::ResultsVecOpt OCRer::analyze() const
     else {
         ocr_ptr = &WordOcr::get_instance();
     }
-    ResultsVec raw_results = ocr_ptr->recognize(make_roi(m_image, m_roi), m_params.without_det);
+
+    // 缓存的是后处理之前的原始结果，required、replace 等参数不同的查询也能共用
+    auto& frame_cache = FrameCache::get_instance();
+    FrameCache::Key key("OCRer");
+    key << m_roi << m_params.use_char_model << m_params.without_det;
+    std::string key_str = std::move(key).str();
+
+    ResultsVec raw_results;
+    if (auto cached = frame_cache.find<ResultsVec>(m_image, key_str)) {
+        raw_results = std::move(*cached);
+    }
+    else {
+        raw_results = ocr_ptr->recognize(make_roi(m_image, m_roi), m_params.without_det, m_inst);
+        frame_cache.store(m_image, std::move(key_str), raw_results);
+    }
     ocr_ptr = nullptr;
 
-    /* post process */
+    return postprocess(std::move(raw_results));
+}
+
+OCRer::ResultsVecOpt OCRer::postprocess(ResultsVec raw_results) const
+{
+    auto postproc_start = std::chrono::steady_clock::now();
     ResultsVec results_vec;
     for (Result& res : raw_results) {
         if (res.text.empty() || std::isnan(res.score) || std::isinf(res.score)) {
@@ -40,7 +61,10 @@ OCRer::ResultsVecOpt OCRer::analyze() const
         results_vec.emplace_back(std::move(res));
     }
 
-    Log.trace("Proced", results_vec);
+    auto postproc_costs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() -
+                                                                                postproc_start)
+                              .count();
+    Log.trace("Proced", results_vec, ", cost", postproc_costs, "us");
 
     if (results_vec.empty()) {
         return std::nullopt;
@@ -72,14 +96,16 @@ void OCRer::postproc_replace_(Result& res) const
         return;
     }
 
+    auto& regex_cache = RegexCache::get_instance();
     for (const auto& [regex, new_str] : m_params.replace) {
+        auto pattern = regex_cache.get(regex);
         if (m_params.replace_full) {
-            if (std::regex_search(res.text, std::regex(regex))) {
+            if (pattern->search(res.text)) {
                 res.text = new_str;
             }
         }
         else {
-            res.text = std::regex_replace(res.text, std::regex(regex), new_str);
+            res.text = pattern->replace(res.text, new_str);
         }
     }
 }
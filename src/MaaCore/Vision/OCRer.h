@@ -19,6 +19,8 @@ namespace asst
         virtual ~OCRer() override = default;
 
         ResultsVecOpt analyze() const;
+        // 对已经识别出的原始结果做后处理（坐标、替换、过滤），供批量识别复用
+        ResultsVecOpt postprocess(ResultsVec raw_results) const;
         // FIXME: 老接口太难重构了，先弄个这玩意兼容下，后续慢慢全删掉
         const auto& get_result() const noexcept { return m_result; }
 
@@ -4,36 +4,30 @@
 
 using namespace asst;
 
-std::vector<float> OnnxHelper::image_to_tensor(const cv::Mat& image)
+void OnnxHelper::image_to_tensor(const cv::Mat& image, float* tensor)
 {
-    cv::Mat src = image.clone();
-    cv::cvtColor(src, src, cv::COLOR_BGR2RGB);
-
-    cv::Mat chw = hwc_to_chw(src);
-    cv::Mat chw_32f;
-    chw.convertTo(chw_32f, CV_32F, 1.0 / 255.0);
-
-    size_t tensor_size = 1ULL * src.cols * src.rows * src.channels();
-    std::vector<float> tensor(tensor_size);
-    std::memcpy(tensor.data(), chw_32f.data, tensor_size * sizeof(float));
-    return tensor;
-}
-
-cv::Mat OnnxHelper::hwc_to_chw(const cv::Mat& src)
-{
-    std::vector<cv::Mat> rgb_images;
-    cv::split(src, rgb_images);
-
-    // Stretch one-channel images to vector
-    cv::Mat m_flat_r = rgb_images[0].reshape(1, 1);
-    cv::Mat m_flat_g = rgb_images[1].reshape(1, 1);
-    cv::Mat m_flat_b = rgb_images[2].reshape(1, 1);
-
-    // Now we can rearrange channels if need
-    cv::Mat matArray[] = { m_flat_r, m_flat_g, m_flat_b };
-
-    cv::Mat flat_image;
-    // Concatenate three vectors to one
-    cv::hconcat(matArray, 3, flat_image);
-    return flat_image;
+    // 颜色转换、HWC -> CHW 和归一化合在一趟里做，不产生中间图像。
+    // 每行的三个通道分别写到三个平面的连续位置，循环体足够简单，编译器可以自动向量化
+    CV_Assert(image.type() == CV_8UC3);
+
+    constexpr float Scale = 1.0f / 255.0f;
+    const int rows = image.rows;
+    const int cols = image.cols;
+    const size_t plane_size = static_cast<size_t>(rows) * cols;
+    float* r_plane = tensor;
+    float* g_plane = tensor + plane_size;
+    float* b_plane = tensor + plane_size * 2;
+
+    for (int y = 0; y < rows; ++y) {
+        const uchar* src = image.ptr<uchar>(y);
+        const size_t offset = static_cast<size_t>(y) * cols;
+        float* __restrict r = r_plane + offset;
+        float* __restrict g = g_plane + offset;
+        float* __restrict b = b_plane + offset;
+        for (int x = 0; x < cols; ++x) {
+            b[x] = src[x * 3] * Scale;
+            g[x] = src[x * 3 + 1] * Scale;
+            r[x] = src[x * 3 + 2] * Scale;
+        }
+    }
 }
@@ -26,9 +26,7 @@ namespace asst
             return output;
         }
 
-        static std::vector<float> image_to_tensor(const cv::Mat& image);
-
-    private:
-        static cv::Mat hwc_to_chw(const cv::Mat& src);
+        // BGR uint8 图像 -> RGB float CHW，归一化到 [0, 1]，直接写入 tensor（至少 rows * cols * 3 个）
+        static void image_to_tensor(const cv::Mat& image, float* tensor);
     };
 }
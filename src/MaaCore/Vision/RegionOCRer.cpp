@@ -5,6 +5,26 @@
 using namespace asst;
 
 RegionOCRer::ResultOpt RegionOCRer::analyze() const
+{
+    auto new_roi_opt = preproc_roi();
+    if (!new_roi_opt) {
+        return std::nullopt;
+    }
+
+    OCRer ocr_analyzer(m_image, *new_roi_opt);
+    auto config = m_params;
+    config.without_det = true;
+    ocr_analyzer.set_params(std::move(config));
+
+    auto result = ocr_analyzer.analyze();
+    if (!result) {
+        return std::nullopt;
+    }
+    m_result = result->front();
+    return m_result;
+}
+
+std::optional<Rect> RegionOCRer::preproc_roi() const
 {
     cv::Mat img_roi = make_roi(m_image, m_roi);
     cv::Mat img_roi_gray;
@@ -36,17 +56,7 @@ RegionOCRer::ResultOpt RegionOCRer::analyze() const
     cv::rectangle(m_image_draw, make_rect<cv::Rect>(new_roi), cv::Scalar(0, 0, 255), 1);
 #endif // ASST_DEBUG
 
-    OCRer ocr_analyzer(m_image, new_roi);
-    auto config = m_params;
-    config.without_det = true;
-    ocr_analyzer.set_params(std::move(config));
-
-    auto result = ocr_analyzer.analyze();
-    if (!result) {
-        return std::nullopt;
-    }
-    m_result = result->front();
-    return m_result;
+    return new_roi;
 }
 
 void asst::RegionOCRer::bin_left_trim(cv::Mat& bin) const
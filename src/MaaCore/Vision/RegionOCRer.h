@@ -18,9 +18,14 @@ namespace asst
         const auto& get_result() const noexcept { return m_result; }
 
     protected:
+        friend class BatchRegionOCRer;
+
         using OCRerConfig::set_without_det;
         virtual void _set_roi(const Rect& roi) override { set_roi(roi); }
 
+        // 二值化裁掉文字周围的空白，得到实际送去识别的区域
+        std::optional<Rect> preproc_roi() const;
+
         void bin_left_trim(cv::Mat& bin) const;
         void bin_right_trim(cv::Mat& bin) const;
 